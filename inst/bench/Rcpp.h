@@ -0,0 +1,21 @@
+/***************************************************************************
+ *  Project:    bikedata
+ *  File:       Rcpp.h
+ *  Language:   C++
+ *
+ *  Author:     Mark Padgham
+ *  E-Mail:     mark.padgham@email.com
+ *
+ *  Description:    Minimal replacement for the Rcpp header, so that those
+ *                  source files of the package which do not otherwise use R
+ *                  can be compiled into the stand-alone benchmarks.
+ *
+ *  Compiler Options:   -std=c++17
+ ***************************************************************************/
+#pragma once
+
+#include <iostream>
+
+namespace Rcpp {
+static std::ostream &Rcout = std::cout;
+}
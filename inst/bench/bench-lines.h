@@ -0,0 +1,286 @@
+/***************************************************************************
+ *  Project:    bikedata
+ *  File:       bench-lines.h
+ *  Language:   C++
+ *
+ *  Author:     Mark Padgham
+ *  E-Mail:     mark.padgham@email.com
+ *
+ *  Description:    Representative lines of each layout of data file, taken
+ *                  from the first lines of each file written by
+ *                  R/write-test-data.R (which are in turn those of the
+ *                  "bike_test_data" of the package). Lines of "ny17" are
+ *                  those of "ny" with all fields quoted, as in files from
+ *                  2017, and lines of "sf" and "sf18" follow the layout of
+ *                  San Francisco files from 2018, with "member_birth_year"
+ *                  quoted in all lines of "sf" and in none of "sf18".
+ *                  Positions map fields of files on to the fields of the
+ *                  database, as for the "field_names" table of
+ *                  R/sysdata.rda.
+ *
+ *  Compiler Options:   -std=c++17
+ ***************************************************************************/
+#pragma once
+
+#include <vector>
+
+enum class parser { generic, london, nabsa };
+
+struct Layout {
+    const char * name;
+    const char * city;
+    parser type;
+    std::vector <int> position_file2db;
+    std::vector <const char *> lines;
+};
+
+const std::vector <Layout> layouts = {
+    {"ny", "ny", parser::generic,
+        // Trip.Duration,Start.Time,Stop.Time,Start.Station.ID,Start.Station.Name
+        {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14},
+        {
+            "528,2016-12-01 00:00:04,2016-12-01 00:08:52,499,Broadway & W 60 St,40.76915505,-73.98191841,228,E 48 St & 3 Ave,40.7546011026,-73.971878855,26931,Subscriber,1964,1",
+            "218,2016-12-01 00:00:28,2016-12-01 00:04:06,3418,Plaza St West & Flatbush Ave,40.6750207,-73.97111473,3358,Garfield Pl & 8 Ave,40.6711978,-73.97484126,27122,Subscriber,1955,1",
+            "399,2016-12-01 00:00:39,2016-12-01 00:07:19,297,E 15 St & 3 Ave,40.734232,-73.986923,345,W 13 St & 6 Ave,40.73649403,-73.99704374,19352,Subscriber,1985,1",
+            "254,2016-12-01 00:00:44,2016-12-01 00:04:59,405,Washington St & Gansevoort St,40.739323,-74.008119,358,Christopher St & Greenwich St,40.73291553,-74.00711384,20015,Subscriber,1982,1",
+            "1805,2016-12-01 00:00:54,2016-12-01 00:31:00,279,Peck Slip & Front St,40.707873,-74.00167,279,Peck Slip & Front St,40.707873,-74.00167,23148,Subscriber,1989,1",
+            "483,2016-12-01 00:01:13,2016-12-01 00:09:17,245,Myrtle Ave & St Edwards St,40.69327018,-73.97703874,372,Franklin Ave & Myrtle Ave,40.694528,-73.958089,16140,Subscriber,1986,1",
+            "1114,2016-12-01 00:01:37,2016-12-01 00:20:12,470,W 20 St & 8 Ave,40.74345335,-74.00004031,453,W 22 St & 8 Ave,40.74475148,-73.99915362,19997,Subscriber,1964,1",
+            "2680,2016-12-01 00:01:50,2016-12-01 00:46:30,3312,1 Ave & E 94 St,40.7817212,-73.94594,3325,E 95 St & 3 Ave,40.7849032,-73.950503,26105,Subscriber,,0",
+            "1967,2016-12-01 00:01:52,2016-12-01 00:34:40,387,Centre St & Chambers St,40.71273266,-74.0046073,387,Centre St & Chambers St,40.71273266,-74.0046073,21348,Customer,,0",
+            "356,2016-12-01 00:01:54,2016-12-01 00:07:50,496,E 16 St & 5 Ave,40.73726186,-73.99238967,212,W 16 St & The High Line,40.74334935,-74.00681753,22517,Subscriber,1954,1",
+            "298,2016-12-01 00:01:54,2016-12-01 00:06:53,297,E 15 St & 3 Ave,40.734232,-73.986923,476,E 31 St & 3 Ave,40.74394314,-73.97966069,26676,Subscriber,1986,1",
+            "315,2016-12-01 00:02:05,2016-12-01 00:07:20,2004,6 Ave & Broome St,40.724399,-74.004704,426,West St & Chambers St,40.71754834,-74.01322069,22515,Subscriber,1976,1",
+            "735,2016-12-01 00:02:10,2016-12-01 00:14:26,390,Duffield St & Willoughby St,40.69221589,-73.9842844,3060,Willoughby Ave & Tompkins Ave,40.69425403,-73.94626915,26945,Subscriber,1987,1",
+            "361,2016-12-01 00:02:10,2016-12-01 00:08:12,3164,Columbus Ave & W 72 St,40.7770575,-73.97898475,3170,W 84 St & Columbus Ave,40.78499979,-73.97283406,22340,Subscriber,1962,1",
+            "1633,2016-12-01 00:02:18,2016-12-01 00:29:31,387,Centre St & Chambers St,40.71273266,-74.0046073,387,Centre St & Chambers St,40.71273266,-74.0046073,26482,Customer,,0",
+            "128,2016-12-01 00:02:18,2016-12-01 00:04:26,79,Franklin St & W Broadway,40.71911552,-74.00666661,146,Hudson St & Reade St,40.71625008,-74.0091059,23578,Subscriber,1983,1"
+        }
+    },
+    {"ch", "ch", parser::generic,
+        // "trip_id","starttime","stoptime","bikeid","tripduration","from_station
+        {-1, 1, 2, 11, 0, 3, 4, 7, 8, 12, 14, 13},
+        {
+            "\"12979228\",\"12/31/2016 23:57:52\",\"1/1/2017 00:06:44\",\"5076\",\"532\",\"502\",\"California Ave & Altgeld St\",\"258\",\"Logan Blvd & Elston Ave\",\"Customer\",\"\",\"\"",
+            "\"12979227\",\"12/31/2016 23:53:18\",\"1/1/2017 00:08:13\",\"5114\",\"895\",\"195\",\"Columbus Dr & Randolph St\",\"25\",\"Michigan Ave & Pearson St\",\"Customer\",\"\",\"\"",
+            "\"12979226\",\"12/31/2016 23:53:07\",\"1/1/2017 00:08:38\",\"1026\",\"931\",\"195\",\"Columbus Dr & Randolph St\",\"25\",\"Michigan Ave & Pearson St\",\"Customer\",\"\",\"\"",
+            "\"12979225\",\"12/31/2016 23:51:31\",\"1/1/2017 00:07:41\",\"504\",\"970\",\"199\",\"Wabash Ave & Grand Ave\",\"35\",\"Streeter Dr & Grand Ave\",\"Subscriber\",\"Male\",\"1985\"",
+            "\"12979224\",\"12/31/2016 23:51:31\",\"1/1/2017 00:07:51\",\"4451\",\"980\",\"199\",\"Wabash Ave & Grand Ave\",\"35\",\"Streeter Dr & Grand Ave\",\"Subscriber\",\"Female\",\"1985\"",
+            "\"12979223\",\"12/31/2016 23:47:40\",\"12/31/2016 23:50:39\",\"5643\",\"179\",\"47\",\"State St & Kinzie St\",\"125\",\"Rush St & Hubbard St\",\"Subscriber\",\"Male\",\"1970\"",
+            "\"12979222\",\"12/31/2016 23:47:33\",\"1/1/2017 00:18:36\",\"48\",\"1863\",\"177\",\"Theater on the Lake\",\"140\",\"Dearborn Pkwy & Delaware Pl\",\"Customer\",\"\",\"\"",
+            "\"12979221\",\"12/31/2016 23:47:03\",\"1/1/2017 00:18:10\",\"2865\",\"1867\",\"177\",\"Theater on the Lake\",\"140\",\"Dearborn Pkwy & Delaware Pl\",\"Customer\",\"\",\"\"",
+            "\"12979220\",\"12/31/2016 23:45:41\",\"1/1/2017 00:13:17\",\"1779\",\"1656\",\"195\",\"Columbus Dr & Randolph St\",\"195\",\"Columbus Dr & Randolph St\",\"Customer\",\"\",\"\"",
+            "\"12979219\",\"12/31/2016 23:44:54\",\"12/31/2016 23:46:42\",\"518\",\"108\",\"264\",\"Stetson Ave & South Water St\",\"52\",\"Michigan Ave & Lake St\",\"Subscriber\",\"Male\",\"1986\"",
+            "\"12979218\",\"12/31/2016 23:43:41\",\"12/31/2016 23:53:18\",\"658\",\"577\",\"15\",\"Racine Ave & 18th St\",\"42\",\"Wabash Ave & Cermak Rd\",\"Subscriber\",\"Male\",\"1991\"",
+            "\"12979217\",\"12/31/2016 23:43:27\",\"1/1/2017 00:42:04\",\"5253\",\"3517\",\"77\",\"Clinton St & Madison St\",\"77\",\"Clinton St & Madison St\",\"Customer\",\"\",\"\"",
+            "\"12979216\",\"12/31/2016 23:43:27\",\"12/31/2016 23:54:37\",\"3237\",\"670\",\"427\",\"Cottage Grove Ave & 63rd St\",\"418\",\"Ellis Ave & 53rd St\",\"Subscriber\",\"Male\",\"1991\"",
+            "\"12979215\",\"12/31/2016 23:43:25\",\"12/31/2016 23:53:59\",\"4615\",\"634\",\"405\",\"Wentworth Ave & 35th St\",\"367\",\"Racine Ave & 35th St\",\"Subscriber\",\"Male\",\"1986\"",
+            "\"12979214\",\"12/31/2016 23:43:11\",\"1/1/2017 00:42:04\",\"2748\",\"3533\",\"77\",\"Clinton St & Madison St\",\"77\",\"Clinton St & Madison St\",\"Customer\",\"\",\"\"",
+            "\"12979213\",\"12/31/2016 23:37:47\",\"12/31/2016 23:49:31\",\"4664\",\"704\",\"256\",\"Broadway & Sheridan Rd\",\"349\",\"Halsted St & Wrightwood Ave\",\"Subscriber\",\"Male\",\"1965\""
+        }
+    },
+    {"dc", "dc", parser::generic,
+        // "Duration","Start.date","End.date","Start.station.number","Start.stati
+        {0, 1, 2, 3, -1, 7, -1, 11, 12},
+        {
+            "\"221\",\"2017-01-01 00:00:41\",\"2017-01-01 00:04:23\",\"31634\",\"3rd & Tingey St SE\",\"31208\",\"M St & New Jersey Ave SE\",\"W00869\",\"Member\"",
+            "\"1676\",\"2017-01-01 00:06:53\",\"2017-01-01 00:34:49\",\"31258\",\"Lincoln Memorial\",\"31270\",\"8th & D St NW\",\"W00894\",\"Casual\"",
+            "\"1356\",\"2017-01-01 00:07:10\",\"2017-01-01 00:29:47\",\"31289\",\"Henry Bacon Dr & Lincoln Memorial Circle NW\",\"31222\",\"New York Ave & 15th St NW\",\"W21945\",\"Casual\"",
+            "\"1327\",\"2017-01-01 00:07:22\",\"2017-01-01 00:29:30\",\"31289\",\"Henry Bacon Dr & Lincoln Memorial Circle NW\",\"31222\",\"New York Ave & 15th St NW\",\"W20012\",\"Casual\"",
+            "\"1636\",\"2017-01-01 00:07:36\",\"2017-01-01 00:34:52\",\"31258\",\"Lincoln Memorial\",\"31270\",\"8th & D St NW\",\"W22786\",\"Casual\"",
+            "\"1603\",\"2017-01-01 00:08:11\",\"2017-01-01 00:34:55\",\"31258\",\"Lincoln Memorial\",\"31270\",\"8th & D St NW\",\"W20890\",\"Casual\"",
+            "\"473\",\"2017-01-01 00:08:36\",\"2017-01-01 00:16:29\",\"31611\",\"13th & H St NE\",\"31616\",\"3rd & H St NE\",\"W20340\",\"Member\"",
+            "\"200\",\"2017-01-01 00:11:07\",\"2017-01-01 00:14:27\",\"31104\",\"Adams Mill & Columbia Rd NW\",\"31121\",\"Calvert St & Woodley Pl NW\",\"W20398\",\"Member\"",
+            "\"748\",\"2017-01-01 00:13:20\",\"2017-01-01 00:25:49\",\"31041\",\"Prince St & Union St\",\"31097\",\"Saint Asaph & Madison St\",\"W00365\",\"Member\"",
+            "\"912\",\"2017-01-01 00:14:35\",\"2017-01-01 00:29:48\",\"31202\",\"14th & R St NW\",\"31505\",\"Eckington Pl & Q St NE\",\"W20771\",\"Member\"",
+            "\"383\",\"2017-01-01 00:16:08\",\"2017-01-01 00:22:32\",\"31042\",\"Market Square / King St & Royal St\",\"31048\",\"King St Metro South\",\"W00232\",\"Member\"",
+            "\"600\",\"2017-01-01 00:16:08\",\"2017-01-01 00:26:08\",\"31041\",\"Prince St & Union St\",\"31048\",\"King St Metro South\",\"W22493\",\"Member\"",
+            "\"2062\",\"2017-01-01 00:16:15\",\"2017-01-01 00:50:38\",\"31041\",\"Prince St & Union St\",\"31043\",\"Saint Asaph St & Pendleton  St\",\"W20659\",\"Casual\"",
+            "\"2017\",\"2017-01-01 00:16:58\",\"2017-01-01 00:50:36\",\"31041\",\"Prince St & Union St\",\"31043\",\"Saint Asaph St & Pendleton  St\",\"W01371\",\"Casual\"",
+            "\"404\",\"2017-01-01 00:17:04\",\"2017-01-01 00:23:49\",\"31616\",\"3rd & H St NE\",\"31265\",\"5th St & Massachusetts Ave NW\",\"W21959\",\"Member\"",
+            "\"981\",\"2017-01-01 00:18:13\",\"2017-01-01 00:34:35\",\"31107\",\"Lamont & Mt Pleasant NW\",\"31110\",\"20th St & Florida Ave NW\",\"W01127\",\"Member\""
+        }
+    },
+    {"bo12", "bo", parser::generic,
+        // Duration,Start.date,End.date,Start.station.number,Start.station.name,E
+        {0, 1, 2, 3, 4, 7, 8, 11, 12, -1, 14},
+        {
+            "1633357,11/28/2012 23:58,11/29/2012 0:25,B32005,Christian Science Plaza,D32011,Stuart St. at Charles St.,T01350,Member,2116,Male",
+            "336668,11/28/2012 23:55,11/29/2012 0:00,C32010,Congress / Sleeper,C32010,Congress / Sleeper,T01281,Member,2210,Male",
+            "629081,11/28/2012 23:55,11/29/2012 0:05,M32006,MIT at Mass Ave / Amherst St,D32005,Boston Public Library - 700 Boylston St.,T01056,Member,2115,Male",
+            "886796,11/28/2012 23:53,11/29/2012 0:08,B32002,Ruggles Station / Columbus Ave.,C32000,Tremont St. at Berkeley St.,T01101,Member,2118,Male",
+            "669088,11/28/2012 23:41,11/28/2012 23:52,A32012,Packard's Corner - Comm. Ave. at Brighton Ave.,B32015,Landmark Centre,B00163,Member,2215,Female",
+            "327269,11/28/2012 23:38,11/28/2012 23:43,M32037,Ames St at Main St,D32000,Cambridge St. at Joy St.,B00041,Member,2114,Male",
+            "432875,11/28/2012 23:34,11/28/2012 23:41,C32007,Prudential Center / Belvidere,C32000,Tremont St. at Berkeley St.,B00459,Member,2215,Male",
+            "264228,11/28/2012 23:25,11/28/2012 23:29,M32002,One Kendall Square at Hampshire St / Portland St,M32010,Inman Square at Vellucci Plaza / Hampshire St,T01414,Member,2116,Male",
+            "2290088,11/28/2012 23:24,11/29/2012 0:02,M32020,Harvard Law School at Mass Ave / Jarvis St,K32001,Coolidge Corner - Beacon St @ Centre St,B00337,Member,2446,Male",
+            "1739348,11/28/2012 23:23,11/28/2012 23:52,A32012,Packard's Corner - Comm. Ave. at Brighton Ave.,B32005,Christian Science Plaza,T01082,Member,2116,Male",
+            "281065,11/28/2012 23:22,11/28/2012 23:26,M32020,Harvard Law School at Mass Ave / Jarvis St,M32038,Harvard University River Houses - DeWolfe St at Grant St,T01084,Member,2138,Male",
+            "78232,11/28/2012 23:19,11/28/2012 23:20,M32002,One Kendall Square at Hampshire St / Portland St,M32002,One Kendall Square at Hampshire St / Portland St,T01414,Member,2116,Male",
+            "265307,11/28/2012 23:10,11/28/2012 23:15,M32017,Harvard Square at Brattle St / Eliot St,A32006,Harvard University Housing - 111 Western Ave. at Soldiers Field Park ,B00279,Member,2115,Male",
+            "323396,11/28/2012 22:56,11/28/2012 23:02,D32005,Boston Public Library - 700 Boylston St.,C32000,Tremont St. at Berkeley St.,B00249,Member,2118,Male",
+            "931048,11/28/2012 22:53,11/28/2012 23:09,M32016,Harvard Kennedy School at Bennett St / Eliot St,M32010,Inman Square at Vellucci Plaza / Hampshire St,T01382,Member,2139,Male",
+            "1186036,11/28/2012 22:53,11/28/2012 23:12,A32006,Harvard University Housing - 111 Western Ave. at Soldiers Field Park ,M32011,Central Square at Mass Ave / Essex St,T01173,Casual,,"
+        }
+    },
+    {"bo17", "bo", parser::generic,
+        // tripduration,starttime,stoptime,start.station.id,start.station.name,st
+        {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14},
+        {
+            "350,2017-01-01 00:06:58,2017-01-01 00:12:49,67,MIT at Mass Ave / Amherst St,42.3581,-71.093198,139,Dana Park,42.361780439606,-71.1080995202065,644,Subscriber,1988,1",
+            "891,2017-01-01 00:13:16,2017-01-01 00:28:07,36,Boston Public Library - 700 Boylston St.,42.349673,-71.077303,10,B.U. Central - 725 Comm. Ave.,42.350406,-71.108279,230,Subscriber,1983,1",
+            "1672,2017-01-01 00:16:17,2017-01-01 00:44:10,36,Boston Public Library - 700 Boylston St.,42.349673,-71.077303,9,Agganis Arena - 925 Comm Ave.,42.351246,-71.115639,980,Customer,\\N,0",
+            "747,2017-01-01 00:21:22,2017-01-01 00:33:50,46,Christian Science Plaza,42.343864,-71.085918,19,Buswell St. at Park Dr.,42.347241,-71.105301,1834,Subscriber,1968,1",
+            "621,2017-01-01 00:30:06,2017-01-01 00:40:28,10,B.U. Central - 725 Comm. Ave.,42.350406,-71.108279,8,Union Square - Brighton Ave. at Cambridge St.,42.353334,-71.137313,230,Subscriber,1983,1",
+            "664,2017-01-01 00:30:40,2017-01-01 00:41:45,47,Cross St. at Hanover St.,42.362811,-71.056067,195,Brian P. Murphy Staircase at Child Street,42.3720597013741,-71.0720264911652,1918,Subscriber,1972,2",
+            "260,2017-01-01 00:42:04,2017-01-01 00:46:25,67,MIT at Mass Ave / Amherst St,42.3581,-71.093198,179,MIT Vassar St,42.3556012132793,-71.1039447784424,1102,Subscriber,1994,1",
+            "403,2017-01-01 00:43:59,2017-01-01 00:50:42,107,Ames St at Main St,42.3625,-71.08822,179,MIT Vassar St,42.3556012132793,-71.1039447784424,1060,Subscriber,1993,1",
+            "642,2017-01-01 00:47:49,2017-01-01 00:58:32,58,The Esplanade - Beacon St. at Arlington St.,42.355596,-71.07278,33,Kenmore Sq / Comm Ave,42.348706,-71.097009,1613,Subscriber,1990,1",
+            "953,2017-01-01 00:48:37,2017-01-01 01:04:31,9,Agganis Arena - 925 Comm Ave.,42.351246,-71.115639,15,Harvard Real Estate - Brighton Mills - 370 Western Ave,42.361667,-71.13802,980,Customer,\\N,0",
+            "237,2017-01-01 00:49:59,2017-01-01 00:53:56,88,Inman Square at Vellucci Plaza / Hampshire St,42.374035,-71.101427,76,Central Sq Post Office / Cambridge City Hall at Mass Ave / Pleasant St,42.366426,-71.105495,1550,Subscriber,1980,1",
+            "1017,2017-01-01 00:51:47,2017-01-01 01:08:44,89,Harvard Law School at Mass Ave / Jarvis St,42.379011,-71.119945,102,Powder House Circle - Nathan Tufts Park,42.400877,-71.116772,379,Customer,\\N,0",
+            "1636,2017-01-01 00:52:42,2017-01-01 01:19:58,133,Green St T,42.310579,-71.107341,124,Curtis Hall at South Street,42.309054,-71.11543,52,Subscriber,1983,1",
+            "196,2017-01-01 01:03:11,2017-01-01 01:06:27,27,Roxbury Crossing Station,42.331184,-71.095171,56,Dudley Square,42.328654,-71.084198,375,Subscriber,1985,1",
+            "259,2017-01-01 01:05:20,2017-01-01 01:09:39,80,MIT Stata Center at Vassar St / Main St,42.3619622,-71.0920526,178,MIT Pacific St at Purrington St,42.3595732010904,-71.1012947559357,1094,Subscriber,1992,1",
+            "194,2017-01-01 01:07:09,2017-01-01 01:10:23,22,South Station - 700 Atlantic Ave.,42.352175,-71.055547,43,Rowes Wharf - Atlantic Ave,42.357143,-71.050699,740,Subscriber,1988,1"
+        }
+    },
+    {"bo18", "bo", parser::generic,
+        // "tripduration","starttime","stoptime","start.station.id","start.statio
+        {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14},
+        {
+            "388,\"2018-01-01 00:16:33\",\"2018-01-01 00:23:01\",178,\"MIT Pacific St at Purrington St\",42.3595732010904,-71.1012947559357,107,\"Ames St at Main St\",42.3625,-71.08822,643,\"Subscriber\",\"1992\",2",
+            "265,\"2018-01-01 00:42:00\",\"2018-01-01 00:46:25\",78,\"Union Square - Somerville\",42.3798071751243,-71.0938704013824,225,\"Cambridge Dept. of Public Works -147 Hampshire St.\",42.3711972775941,-71.0975986719131,1581,\"Subscriber\",\"1990\",1",
+            "1167,\"2018-01-01 00:42:44\",\"2018-01-01 01:02:11\",16,\"Back Bay T Stop - Dartmouth St at Stuart St\",42.3480741231744,-71.0765701532364,76,\"Central Sq Post Office / Cambridge City Hall at Mass Ave / Pleasant St\",42.366426,-71.105495,173,\"Subscriber\",\"1990\",1",
+            "855,\"2018-01-01 00:56:50\",\"2018-01-01 01:11:06\",69,\"Coolidge Corner - Beacon St @ Centre St\",42.341598,-71.123338,177,\"University Park\",42.3626477911859,-71.1000609397888,1772,\"Subscriber\",\"1992\",1",
+            "487,\"2018-01-01 01:07:54\",\"2018-01-01 01:16:02\",4,\"Tremont St at E Berkeley St\",42.345392,-71.069616,46,\"Christian Science Plaza - Massachusetts Ave at Westland Ave\",42.3436658245146,-71.0858237743378,1183,\"Subscriber\",\"1993\",1",
+            "81,\"2018-01-01 01:15:59\",\"2018-01-01 01:17:21\",31,\"Seaport Hotel - Congress St at Seaport Ln\",42.3488102618827,-71.041677440553,186,\"Congress St at Northern Ave\",42.3481,-71.03764,1793,\"Subscriber\",\"1990\",1",
+            "417,\"2018-01-01 01:35:37\",\"2018-01-01 01:42:35\",51,\"Washington St at Lenox St\",42.3350989929096,-71.0790377855301,222,\"Troy Boston\",42.343749,-71.062256,60,\"Subscriber\",\"1986\",1",
+            "564,\"2018-01-01 01:35:46\",\"2018-01-01 01:45:11\",189,\"Kendall T\",42.3624278429124,-71.0849547386169,178,\"MIT Pacific St at Purrington St\",42.3595732010904,-71.1012947559357,371,\"Subscriber\",\"1980\",1",
+            "515,\"2018-01-01 01:45:04\",\"2018-01-01 01:53:40\",108,\"Harvard University / SEAS Cruft-Pierce Halls at 29 Oxford St\",42.377945,-71.116865,176,\"Lesley University\",42.3867480204506,-71.1190187931061,961,\"Subscriber\",\"1989\",1",
+            "555,\"2018-01-01 01:56:58\",\"2018-01-01 02:06:13\",185,\"Third at Binney\",42.365444861374,-71.0827714204788,178,\"MIT Pacific St at Purrington St\",42.3595732010904,-71.1012947559357,1286,\"Subscriber\",\"1989\",1",
+            "400,\"2018-01-01 02:01:28\",\"2018-01-01 02:08:09\",95,\"Cambridge St - at Columbia St / Webster Ave\",42.372969,-71.094445,90,\"Lechmere Station at Cambridge St / First St\",42.370677,-71.076529,1142,\"Subscriber\",\"1994\",1",
+            "293,\"2018-01-01 02:06:06\",\"2018-01-01 02:10:59\",218,\"Watermark Seaport - Boston Wharf Rd at Seaport Blvd\",42.3515860011985,-71.0456925630569,150,\"State Street at Channel Center\",42.344137,-71.052608,34,\"Subscriber\",\"1984\",1",
+            "565,\"2018-01-01 02:13:16\",\"2018-01-01 02:22:41\",49,\"Stuart St at Charles St\",42.351146,-71.066289,25,\"South End Library - Tremont St at W Newton St\",42.341332,-71.076847,1790,\"Subscriber\",\"1957\",1",
+            "403,\"2018-01-01 02:13:20\",\"2018-01-01 02:20:04\",90,\"Lechmere Station at Cambridge St / First St\",42.370677,-71.076529,95,\"Cambridge St - at Columbia St / Webster Ave\",42.372969,-71.094445,1243,\"Subscriber\",\"1984\",1",
+            "681,\"2018-01-01 02:15:04\",\"2018-01-01 02:26:25\",150,\"State Street at Channel Center\",42.344137,-71.052608,93,\"JFK/UMass T Stop\",42.3203397351572,-71.0511803627014,284,\"Subscriber\",\"1984\",1",
+            "532,\"2018-01-01 02:43:18\",\"2018-01-01 02:52:10\",23,\"Boston City Hall - 28 State St\",42.35892,-71.057629,72,\"One Broadway / Kendall Sq at Main St / 3rd St\",42.362613,-71.084105,1901,\"Subscriber\",\"1992\",2"
+        }
+    },
+    {"mn", "mn", parser::generic,
+        // Start.date,Start.station,Start.terminal,End.date,End.station,End.termi
+        {1, 4, 3, 2, 8, 7, -1, 12},
+        {
+            "4/2/2012 13:07,Midtown Exchange,30008,4/2/2012 13:42,Midtown Exchange,30008,2075271,Casual",
+            "4/2/2012 14:03,Midtown Exchange,30008,4/2/2012 14:09,Carter Ave. & Como Ave.,30108,303065,Casual",
+            "4/2/2012 15:08,Chicago & 27th Street,30023,4/2/2012 15:08,Chicago & 27th Street,30023,3048,Member",
+            "4/2/2012 15:26,5th Ave. S & East 27th Street,30054,4/2/2012 15:26,5th Ave. S & East 27th Street,30054,3565,Member",
+            "4/2/2012 15:57,5th Ave. S & East 27th Street,30054,4/2/2012 16:17,Downtown Library,30036,1197084,Member",
+            "4/2/2012 16:55,Midtown Exchange,30008,4/2/2012 17:30,North 2nd Street & 4th Ave N,30011,2075457,Casual",
+            "4/2/2012 17:00,Hague Ave & Dale Street,30103,4/2/2012 17:04,Dale Street & Grand Ave.,30106,241185,Casual",
+            "4/2/2012 17:11,Social Sciences,30019,4/2/2012 17:11,Social Sciences,30019,4909,Member",
+            "4/2/2012 17:17,Midtown YWCA,30080,4/2/2012 17:37,Currie Park,30037,1230760,Member",
+            "4/2/2012 17:37,Currie Park,30037,4/2/2012 17:55,Downtown Library,30036,1046501,Member",
+            "4/2/2012 17:49,Franklin & 28th Ave,30045,4/2/2012 17:54,19th Ave. S & Franklin ,30038,279007,Member",
+            "4/2/2012 17:53,Social Sciences,30019,4/2/2012 17:57,Currie Park,30037,262820,Member",
+            "4/2/2012 17:54,Franklin & 28th Ave,30045,4/2/2012 17:54,Franklin & 28th Ave,30045,2892,Member",
+            "4/2/2012 17:54,19th Ave. S & Franklin ,30038,4/2/2012 18:05,25th Ave. S & Franklin,30014,648032,Member",
+            "4/2/2012 17:55,Downtown Library,30036,4/2/2012 17:58,,,146675,Member",
+            "4/2/2012 17:56,Downtown Library,30036,4/2/2012 18:03,North 2nd Street & 4th Ave N,30011,383459,Member"
+        }
+    },
+    {"ny17", "ny", parser::generic,
+        // "Trip Duration","Start Time","Stop Time","Start Station ID","Start Sta
+        {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14},
+        {
+            "\"528\",\"2016-12-01 00:00:04\",\"2016-12-01 00:08:52\",\"499\",\"Broadway & W 60 St\",\"40.76915505\",\"-73.98191841\",\"228\",\"E 48 St & 3 Ave\",\"40.7546011026\",\"-73.971878855\",\"26931\",\"Subscriber\",\"1964\",\"1\"",
+            "\"218\",\"2016-12-01 00:00:28\",\"2016-12-01 00:04:06\",\"3418\",\"Plaza St West & Flatbush Ave\",\"40.6750207\",\"-73.97111473\",\"3358\",\"Garfield Pl & 8 Ave\",\"40.6711978\",\"-73.97484126\",\"27122\",\"Subscriber\",\"1955\",\"1\"",
+            "\"399\",\"2016-12-01 00:00:39\",\"2016-12-01 00:07:19\",\"297\",\"E 15 St & 3 Ave\",\"40.734232\",\"-73.986923\",\"345\",\"W 13 St & 6 Ave\",\"40.73649403\",\"-73.99704374\",\"19352\",\"Subscriber\",\"1985\",\"1\"",
+            "\"254\",\"2016-12-01 00:00:44\",\"2016-12-01 00:04:59\",\"405\",\"Washington St & Gansevoort St\",\"40.739323\",\"-74.008119\",\"358\",\"Christopher St & Greenwich St\",\"40.73291553\",\"-74.00711384\",\"20015\",\"Subscriber\",\"1982\",\"1\"",
+            "\"1805\",\"2016-12-01 00:00:54\",\"2016-12-01 00:31:00\",\"279\",\"Peck Slip & Front St\",\"40.707873\",\"-74.00167\",\"279\",\"Peck Slip & Front St\",\"40.707873\",\"-74.00167\",\"23148\",\"Subscriber\",\"1989\",\"1\"",
+            "\"483\",\"2016-12-01 00:01:13\",\"2016-12-01 00:09:17\",\"245\",\"Myrtle Ave & St Edwards St\",\"40.69327018\",\"-73.97703874\",\"372\",\"Franklin Ave & Myrtle Ave\",\"40.694528\",\"-73.958089\",\"16140\",\"Subscriber\",\"1986\",\"1\"",
+            "\"1114\",\"2016-12-01 00:01:37\",\"2016-12-01 00:20:12\",\"470\",\"W 20 St & 8 Ave\",\"40.74345335\",\"-74.00004031\",\"453\",\"W 22 St & 8 Ave\",\"40.74475148\",\"-73.99915362\",\"19997\",\"Subscriber\",\"1964\",\"1\"",
+            "\"2680\",\"2016-12-01 00:01:50\",\"2016-12-01 00:46:30\",\"3312\",\"1 Ave & E 94 St\",\"40.7817212\",\"-73.94594\",\"3325\",\"E 95 St & 3 Ave\",\"40.7849032\",\"-73.950503\",\"26105\",\"Subscriber\",\"\",\"0\"",
+            "\"1967\",\"2016-12-01 00:01:52\",\"2016-12-01 00:34:40\",\"387\",\"Centre St & Chambers St\",\"40.71273266\",\"-74.0046073\",\"387\",\"Centre St & Chambers St\",\"40.71273266\",\"-74.0046073\",\"21348\",\"Customer\",\"\",\"0\"",
+            "\"356\",\"2016-12-01 00:01:54\",\"2016-12-01 00:07:50\",\"496\",\"E 16 St & 5 Ave\",\"40.73726186\",\"-73.99238967\",\"212\",\"W 16 St & The High Line\",\"40.74334935\",\"-74.00681753\",\"22517\",\"Subscriber\",\"1954\",\"1\"",
+            "\"298\",\"2016-12-01 00:01:54\",\"2016-12-01 00:06:53\",\"297\",\"E 15 St & 3 Ave\",\"40.734232\",\"-73.986923\",\"476\",\"E 31 St & 3 Ave\",\"40.74394314\",\"-73.97966069\",\"26676\",\"Subscriber\",\"1986\",\"1\"",
+            "\"315\",\"2016-12-01 00:02:05\",\"2016-12-01 00:07:20\",\"2004\",\"6 Ave & Broome St\",\"40.724399\",\"-74.004704\",\"426\",\"West St & Chambers St\",\"40.71754834\",\"-74.01322069\",\"22515\",\"Subscriber\",\"1976\",\"1\"",
+            "\"735\",\"2016-12-01 00:02:10\",\"2016-12-01 00:14:26\",\"390\",\"Duffield St & Willoughby St\",\"40.69221589\",\"-73.9842844\",\"3060\",\"Willoughby Ave & Tompkins Ave\",\"40.69425403\",\"-73.94626915\",\"26945\",\"Subscriber\",\"1987\",\"1\"",
+            "\"361\",\"2016-12-01 00:02:10\",\"2016-12-01 00:08:12\",\"3164\",\"Columbus Ave & W 72 St\",\"40.7770575\",\"-73.97898475\",\"3170\",\"W 84 St & Columbus Ave\",\"40.78499979\",\"-73.97283406\",\"22340\",\"Subscriber\",\"1962\",\"1\"",
+            "\"1633\",\"2016-12-01 00:02:18\",\"2016-12-01 00:29:31\",\"387\",\"Centre St & Chambers St\",\"40.71273266\",\"-74.0046073\",\"387\",\"Centre St & Chambers St\",\"40.71273266\",\"-74.0046073\",\"26482\",\"Customer\",\"\",\"0\"",
+            "\"128\",\"2016-12-01 00:02:18\",\"2016-12-01 00:04:26\",\"79\",\"Franklin St & W Broadway\",\"40.71911552\",\"-74.00666661\",\"146\",\"Hudson St & Reade St\",\"40.71625008\",\"-74.0091059\",\"23578\",\"Subscriber\",\"1983\",\"1\""
+        }
+    },
+    {"sf", "sf", parser::generic,
+        // "duration_sec","start_time","end_time","start_station_id","start_st
+        {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, -1},
+        {
+            "\"598\",\"2018-04-01 00:01:46.1990\",\"2018-04-01 00:11:44.3750\",\"43\",\"San Francisco Public Library (Grove St at Hyde St)\",\"37.7787677\",\"-122.4159292\",\"79\",\"7th St at Brannan St\",\"37.7734486\",\"-122.4033765\",\"3625\",\"Subscriber\",\"1986\",\"Male\",\"No\"",
+            "\"943\",\"2018-04-01 00:03:09.0970\",\"2018-04-01 00:18:52.7430\",\"58\",\"Market St at 10th St\",\"37.776619\",\"-122.417385\",\"70\",\"Central Ave at Fell St\",\"37.7733108\",\"-122.4442789\",\"1244\",\"Subscriber\",\"1991\",\"Female\",\"No\"",
+            "\"18\",\"2018-04-01 00:05:05.2470\",\"2018-04-01 00:05:23.5220\",\"180\",\"Telegraph Ave at 23rd St\",\"37.8126783\",\"-122.2687726\",\"180\",\"Telegraph Ave at 23rd St\",\"37.8126783\",\"-122.2687726\",\"2219\",\"Subscriber\",\"1988\",\"Male\",\"Yes\"",
+            "\"1166\",\"2018-04-01 00:06:12.9380\",\"2018-04-01 00:25:39.5530\",\"15\",\"San Francisco Ferry Building (Harry Bridges Plaza)\",\"37.795392\",\"-122.394203\",\"6\",\"The Embarcadero at Sansome St\",\"37.80477\",\"-122.403234\",\"3398\",\"Subscriber\",\"1974\",\"Male\",\"No\"",
+            "\"417\",\"2018-04-01 00:07:56.0620\",\"2018-04-01 00:14:53.5160\",\"114\",\"Rhode Island St at 17th St\",\"37.764478\",\"-122.40257\",\"105\",\"16th St at Prosper St\",\"37.7642737\",\"-122.4368608\",\"1806\",\"Subscriber\",\"1994\",\"Female\",\"No\"",
+            "\"764\",\"2018-04-01 00:10:09.7280\",\"2018-04-01 00:22:54.1000\",\"239\",\"Bancroft Way at Telegraph Ave\",\"37.8688126\",\"-122.2588529\",\"245\",\"Downtown Berkeley BART\",\"37.870348\",\"-122.267764\",\"2542\",\"Subscriber\",\"1997\",\"Male\",\"Yes\"",
+            "\"1506\",\"2018-04-01 00:12:29.3150\",\"2018-04-01 00:37:35.8830\",\"30\",\"San Francisco Caltrain (Townsend St at 4th St)\",\"37.776598\",\"-122.395282\",\"81\",\"Berry St at 4th St\",\"37.77588\",\"-122.39317\",\"3466\",\"Subscriber\",\"1983\",\"Female\",\"No\"",
+            "\"325\",\"2018-04-01 00:14:02.7730\",\"2018-04-01 00:19:28.5060\",\"310\",\"San Fernando St at 4th St\",\"37.335885\",\"-121.88566\",\"296\",\"5th St at Virginia St\",\"37.325998\",\"-121.87712\",\"1405\",\"Subscriber\",\"1999\",\"Male\",\"No\""
+        }
+    },
+    {"sf18", "sf", parser::generic,
+        // "duration_sec","start_time","end_time","start_station_id","start_st
+        {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, -1},
+        {
+            "\"598\",\"2018-04-01 00:01:46.1990\",\"2018-04-01 00:11:44.3750\",\"43\",\"San Francisco Public Library (Grove St at Hyde St)\",\"37.7787677\",\"-122.4159292\",\"79\",\"7th St at Brannan St\",\"37.7734486\",\"-122.4033765\",\"3625\",\"Subscriber\",1986,\"Male\",\"No\"",
+            "\"943\",\"2018-04-01 00:03:09.0970\",\"2018-04-01 00:18:52.7430\",\"58\",\"Market St at 10th St\",\"37.776619\",\"-122.417385\",\"70\",\"Central Ave at Fell St\",\"37.7733108\",\"-122.4442789\",\"1244\",\"Subscriber\",1991,\"Female\",\"No\"",
+            "\"18\",\"2018-04-01 00:05:05.2470\",\"2018-04-01 00:05:23.5220\",\"180\",\"Telegraph Ave at 23rd St\",\"37.8126783\",\"-122.2687726\",\"180\",\"Telegraph Ave at 23rd St\",\"37.8126783\",\"-122.2687726\",\"2219\",\"Subscriber\",1988,\"Male\",\"Yes\"",
+            "\"1166\",\"2018-04-01 00:06:12.9380\",\"2018-04-01 00:25:39.5530\",\"15\",\"San Francisco Ferry Building (Harry Bridges Plaza)\",\"37.795392\",\"-122.394203\",\"6\",\"The Embarcadero at Sansome St\",\"37.80477\",\"-122.403234\",\"3398\",\"Subscriber\",1974,\"Male\",\"No\"",
+            "\"417\",\"2018-04-01 00:07:56.0620\",\"2018-04-01 00:14:53.5160\",\"114\",\"Rhode Island St at 17th St\",\"37.764478\",\"-122.40257\",\"105\",\"16th St at Prosper St\",\"37.7642737\",\"-122.4368608\",\"1806\",\"Subscriber\",1994,\"Female\",\"No\"",
+            "\"764\",\"2018-04-01 00:10:09.7280\",\"2018-04-01 00:22:54.1000\",\"239\",\"Bancroft Way at Telegraph Ave\",\"37.8688126\",\"-122.2588529\",\"245\",\"Downtown Berkeley BART\",\"37.870348\",\"-122.267764\",\"2542\",\"Subscriber\",1997,\"Male\",\"Yes\"",
+            "\"1506\",\"2018-04-01 00:12:29.3150\",\"2018-04-01 00:37:35.8830\",\"30\",\"San Francisco Caltrain (Townsend St at 4th St)\",\"37.776598\",\"-122.395282\",\"81\",\"Berry St at 4th St\",\"37.77588\",\"-122.39317\",\"3466\",\"Subscriber\",1983,\"Female\",\"No\"",
+            "\"325\",\"2018-04-01 00:14:02.7730\",\"2018-04-01 00:19:28.5060\",\"310\",\"San Fernando St at 4th St\",\"37.335885\",\"-121.88566\",\"296\",\"5th St at Virginia St\",\"37.325998\",\"-121.87712\",\"1405\",\"Subscriber\",1999,\"Male\",\"No\""
+        }
+    },
+    {"lo", "lo", parser::london,
+        // Rental.Id,Duration,Bike.Id,End.Date,EndStation.Id,EndStation.Name,Star
+        {},
+        {
+            "50754225,240,11834,10/01/2016 00:04,383,\"Frith Street, Soho\",10/01/2016 00:00,18,\"Drury Lane, Covent Garden\"",
+            "50754226,300,9648,10/01/2016 00:05,719,\"Victoria Park Road, Hackney Central\",10/01/2016 00:00,479,\"Pott Street, Bethnal Green\"",
+            "50754227,1200,10689,10/01/2016 00:20,272,\"Baylis Road, Waterloo\",10/01/2016 00:00,425,\"Harrington Square 2, Camden Town\"",
+            "50754228,780,8593,10/01/2016 00:14,471,\"Hewison Street, Old Ford\",10/01/2016 00:01,487,\"Canton Street, Poplar\"",
+            "50754229,600,8619,10/01/2016 00:11,399,\"Brick Lane Market, Shoreditch\",10/01/2016 00:01,501,\"Cephas Street, Bethnal Green\"",
+            "50754230,420,309,10/01/2016 00:09,671,\"Parsons Green Station, Parsons Green\",10/01/2016 00:02,769,\"Sandilands Road, Walham Green\"",
+            "50754231,960,11914,10/01/2016 00:18,450,\"Jubilee Street, Stepney\",10/01/2016 00:02,516,\"Chrisp Street Market, Poplar\"",
+            "50754232,480,3314,10/01/2016 00:11,780,\"Imperial Wharf Station\",10/01/2016 00:03,755,\"The Vale, West Chelsea\"",
+            "50754233,240,2825,10/01/2016 00:08,638,\"Falcon Road, Clapham Junction\",10/01/2016 00:04,701,\"Vicarage Crescent, Battersea\"",
+            "50754234,1320,3102,10/01/2016 00:27,647,\"Richmond Way, Shepherd's Bush\",10/01/2016 00:05,633,\"Vereker Road North, West Kensington\"",
+            "50754235,480,4261,10/01/2016 00:13,86,\"Sancroft Street, Vauxhall\",10/01/2016 00:05,420,\"Southwark Station 1, Southwark\"",
+            "50754236,1020,8051,10/01/2016 00:22,600,\"South Lambeth Road, Vauxhall\",10/01/2016 00:05,386,\"Moor Street, Soho\"",
+            "50754237,780,4184,10/01/2016 00:19,552,\"Watney Street, Shadwell\",10/01/2016 00:06,534,\"Goldsmith's Row, Haggerston\"",
+            "50754238,720,2855,10/01/2016 00:18,518,\"Antill Road, Mile End\",10/01/2016 00:06,717,\"Dunston Road , Haggerston\"",
+            "50754239,420,12698,10/01/2016 00:14,522,\"Clinton Road, Mile End\",10/01/2016 00:07,521,\"Driffield Road, Old Ford\"",
+            "50754241,180,12003,10/01/2016 00:11,78,\"Sadlers Sports Centre, Finsbury\",10/01/2016 00:08,264,\"Tysoe Street, Clerkenwell\""
+        }
+    },
+    {"la", "la", parser::nabsa,
+        // trip_id,duration,start_time,end_time,start_station_id,start_lat,start_
+        {},
+        {
+            "17059131,480,1/1/2017 0:15,1/1/2017 0:23,3030,34.051941,-118.24353,3029,34.048851,-118.246422,6220,30,One Way,Monthly Pass",
+            "17059130,720,1/1/2017 0:24,1/1/2017 0:36,3028,34.058319,-118.246094,3028,34.058319,-118.246094,6351,0,Round Trip,Walk-up",
+            "17059129,1020,1/1/2017 0:28,1/1/2017 0:45,3027,34.04998,-118.247162,3018,34.043732,-118.260139,5836,0,One Way,Walk-up",
+            "17059128,300,1/1/2017 0:38,1/1/2017 0:43,3007,34.05048,-118.254593,3031,34.044701,-118.252441,6142,30,One Way,Monthly Pass",
+            "17059127,300,1/1/2017 0:38,1/1/2017 0:43,3007,34.05048,-118.254593,3031,34.044701,-118.252441,6135,30,One Way,Monthly Pass",
+            "17059126,1200,1/1/2017 0:39,1/1/2017 0:59,3066,34.063389,-118.23616,3055,34.044159,-118.251579,6529,0,One Way,Walk-up",
+            "17059125,720,1/1/2017 0:43,1/1/2017 0:55,3029,34.048851,-118.246422,3079,34.05014,-118.233238,6029,0,One Way,Walk-up",
+            "17061379,2880,1/1/2017 0:56,1/1/2017 1:44,3063,34.049198,-118.252831,3063,34.049198,-118.252831,6680,0,Round Trip,Walk-up",
+            "17061378,2820,1/1/2017 0:57,1/1/2017 1:44,3063,34.049198,-118.252831,3063,34.049198,-118.252831,6573,0,Round Trip,Walk-up",
+            "17063646,1500,1/1/2017 1:54,1/1/2017 2:19,3078,34.064281,-118.238937,3023,34.050911,-118.240967,6174,0,One Way,Walk-up",
+            "17063645,1440,1/1/2017 1:55,1/1/2017 2:19,3078,34.064281,-118.238937,3023,34.050911,-118.240967,5820,0,One Way,Walk-up",
+            "17063644,1200,1/1/2017 1:56,1/1/2017 2:16,3082,34.04652,-118.237411,3008,34.046612,-118.262733,6046,30,One Way,Monthly Pass",
+            "17063643,1320,1/1/2017 1:58,1/1/2017 2:20,3078,34.064281,-118.238937,3023,34.050911,-118.240967,5741,0,One Way,Walk-up",
+            "17063642,1200,1/1/2017 1:59,1/1/2017 2:19,3078,34.064281,-118.238937,3023,34.050911,-118.240967,6463,0,One Way,Walk-up",
+            "17063640,960,1/1/2017 2:00,1/1/2017 2:16,3082,34.04652,-118.237411,3008,34.046612,-118.262733,5931,0,One Way,Walk-up",
+            "17063641,1140,1/1/2017 2:00,1/1/2017 2:19,3078,34.064281,-118.238937,3023,34.050911,-118.240967,6447,0,One Way,Walk-up"
+        }
+    }
+};
@@ -0,0 +1,375 @@
+/***************************************************************************
+ *  Project:    bikedata
+ *  File:       bench.cpp
+ *  Language:   C++
+ *
+ *  Author:     Mark Padgham
+ *  E-Mail:     mark.padgham@email.com
+ *
+ *  Description:    Stand-alone benchmarks of the routines which parse single
+ *                  lines of data files, run over the representative lines of
+ *                  each layout in bench-lines.h. Reports numbers of lines
+ *                  parsed per second, nanoseconds per field, and heap
+ *                  allocations per line, where "lines" of the "datetime"
+ *                  benchmarks are single date-time values. Layouts read with
+ *                  the generic routine are parsed both with the routine
+ *                  selected for that layout ("parse"), which is specialised
+ *                  for all but DC, Minneapolis, and Boston to 2016 ("bo12"),
+ *                  and with the fallback routine for unknown layouts
+ *                  ("fallback"). Boston
+ *                  and DC lines are parsed without the station maps otherwise
+ *                  read from the database. Lookups of stations made for each
+ *                  trip (by ID, and by name for Boston and DC) are timed for
+ *                  std::map and for the StringMap used by the package, with
+ *                  each "line" being one trip of two lookups. Built without R
+ *                  with "make" in this directory; see the Makefile.
+ *
+ *  Usage:          ./bench [iterations]
+ *
+ *  Compiler Options:   -std=c++17
+ ***************************************************************************/
+
+#include "bench-lines.h"
+
+#include "common.h"
+#include "utils.h"
+#include "read-city-files.h"
+#include "read-headers.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <map>
+#include <new>
+#include <string>
+#include <type_traits>
+
+// Count all heap allocations, which is only done from the single thread of
+// the benchmarks.
+static size_t num_allocs = 0;
+
+void * operator new (size_t n)
+{
+    num_allocs++;
+    if (void * p = std::malloc (n > 0 ? n : 1))
+        return p;
+    throw std::bad_alloc ();
+}
+void * operator new [] (size_t n) { return operator new (n); }
+void operator delete (void * p) noexcept { std::free (p); }
+void operator delete [] (void * p) noexcept { std::free (p); }
+void operator delete (void * p, size_t) noexcept { std::free (p); }
+void operator delete [] (void * p, size_t) noexcept { std::free (p); }
+
+namespace {
+
+using bench_clock = std::chrono::steady_clock;
+
+struct Result {
+    double secs = 0.0;
+    size_t nlines = 0, nfields = 0, nallocs = 0;
+};
+
+void print_header ()
+{
+    std::printf ("%-18s %-8s %14s %10s %12s\n", "layout", "routine",
+            "lines/s", "ns/field", "allocs/line");
+}
+
+void print_result (const std::string &name, const char * routine,
+        const Result &r)
+{
+    std::printf ("%-18s %-8s %14.0f %10.1f %12.2f\n", name.c_str (), routine,
+            static_cast <double> (r.nlines) / r.secs,
+            1e9 * r.secs / static_cast <double> (r.nfields),
+            static_cast <double> (r.nallocs) /
+            static_cast <double> (r.nlines));
+}
+
+// Number of comma-separated fields in a line, ignoring commas within quotes
+unsigned int count_fields (const char * line)
+{
+    unsigned int n = 1;
+    bool in_quote = false;
+    for (const char * c = line; *c; c++)
+    {
+        if (*c == '"')
+            in_quote = !in_quote;
+        else if (*c == ',' && !in_quote)
+            n++;
+    }
+    return n;
+}
+
+HeaderStruct make_headers (const Layout &l)
+{
+    HeaderStruct headers;
+    headers.nvalues = count_fields (l.lines [0]);
+    headers.position_file2db = l.position_file2db;
+    const std::string city = l.city;
+    headers.data_has_stations = (city == "ny" || city == "la" ||
+            city == "ph" || city == "sf");
+    headers.terminal_quote = false;
+    // The London and NABSA routines do not use header structures
+    if (l.type == parser::generic)
+        db_add::get_field_quotes (l.lines [0], headers);
+    return headers;
+}
+
+// Parse one line in the same way as db_add::read_trip_chunk, with lines of
+// generic layouts read by "read_one_line"
+unsigned int parse_line (const Layout &l, const std::string &city,
+        std::string_view line, const HeaderStruct &headers,
+        city::GenericParser read_one_line,
+        const StringMap <std::string> &stn_map,
+        StringMap <StationRow> &stations, TripRow &row,
+        std::string &line_buf, LineScratch &scratch)
+{
+    row.clear ();
+    if (l.type == parser::generic)
+        return read_one_line (row, line, &stations, city, headers, stn_map,
+                scratch);
+
+    line_buf.assign (line.data (), line.size ());
+    if (l.type == parser::london)
+        return city::read_one_line_london (row, &line_buf [0], scratch);
+    return city::read_one_line_nabsa (row, &line_buf [0], &stations, city,
+            scratch);
+}
+
+// Parse all lines of one layout "niters" times, after one untimed pass so
+// that working storage, which is re-used for every line, reaches its full
+// size. Generic layouts are parsed with the routine selected for the layout,
+// or with the fallback routine if "fallback" is true.
+Result bench_parser (const Layout &l, size_t niters, bool fallback)
+{
+    const std::string city = l.city;
+    const HeaderStruct headers = make_headers (l);
+    const city::GenericParser read_one_line = fallback ?
+        &city::read_one_line_generic : city::select_generic_parser (headers);
+    const StringMap <std::string> stn_map;
+    StringMap <StationRow> stations;
+    LineScratch scratch;
+    scratch.datetime_format.day_first = (l.type == parser::london);
+    std::string line_buf;
+    TripRow row;
+
+    Result r;
+    size_t nfields = 0;
+    for (auto line: l.lines)
+    {
+        parse_line (l, city, line, headers, read_one_line, stn_map,
+                stations, row, line_buf, scratch);
+        nfields += count_fields (line);
+    }
+
+    num_allocs = 0;
+    size_t nrejected = 0;
+    const auto t0 = bench_clock::now ();
+    for (size_t iter = 0; iter < niters; iter++)
+        for (auto line: l.lines)
+            nrejected += parse_line (l, city, line, headers, read_one_line,
+                    stn_map, stations, row, line_buf, scratch) != 0;
+    r.secs = std::chrono::duration <double> (bench_clock::now () -
+            t0).count ();
+    r.nallocs = num_allocs;
+    r.nlines = niters * l.lines.size ();
+    r.nfields = niters * nfields;
+
+    if (nrejected > 0)
+        std::fprintf (stderr, "%s: %zu lines rejected\n", l.name,
+                nrejected / niters);
+
+    return r;
+}
+
+// Parse and re-format all date-time fields of the lines of one layout, as
+// done by the line-reading routines for start and stop times. Only fields
+// containing ':' are tried, to avoid numeric fields.
+Result bench_datetime (const Layout &l, size_t niters)
+{
+    std::vector <std::string> times;
+    for (auto line: l.lines)
+    {
+        std::string_view l0 = line;
+        std::vector <std::string_view> fields;
+        bool in_quote = false;
+        size_t start = 0;
+        for (size_t i = 0; i <= l0.size (); i++)
+        {
+            if (i < l0.size () && l0 [i] == '"')
+                in_quote = !in_quote;
+            else if (i == l0.size () || (l0 [i] == ',' && !in_quote))
+            {
+                std::string_view f = l0.substr (start, i - start);
+                if (f.size () > 1 && f.front () == '"')
+                    f = f.substr (1, f.size () - 2);
+                fields.push_back (f);
+                start = i + 1;
+            }
+        }
+        for (auto f: fields)
+        {
+            int64_t epoch;
+            DateTimeFormat fmt;
+            fmt.day_first = (l.type == parser::london);
+            if (f.find (':') != std::string_view::npos &&
+                    utils::parse_datetime (f, fmt, epoch))
+                times.emplace_back (f);
+        }
+    }
+
+    DateTimeFormat fmt;
+    fmt.day_first = (l.type == parser::london);
+    std::string out;
+    int64_t epoch;
+    for (auto &t: times)
+        if (utils::parse_datetime (t, fmt, epoch))
+            utils::format_datetime (epoch, out);
+
+    num_allocs = 0;
+    size_t nfailed = 0;
+    const auto t0 = bench_clock::now ();
+    for (size_t iter = 0; iter < niters; iter++)
+        for (auto &t: times)
+        {
+            if (utils::parse_datetime (t, fmt, epoch))
+                utils::format_datetime (epoch, out);
+            else
+                nfailed++;
+        }
+    Result r;
+    r.secs = std::chrono::duration <double> (bench_clock::now () -
+            t0).count ();
+    r.nallocs = num_allocs;
+    r.nlines = r.nfields = niters * times.size ();
+
+    if (nfailed > 0)
+        std::fprintf (stderr, "%s: %zu date-times not parsed\n", l.name,
+                nfailed / niters);
+
+    return r;
+}
+
+// Determine the quoting of fields from the first line of one layout
+Result bench_quotes (const Layout &l, size_t niters)
+{
+    HeaderStruct headers = make_headers (l);
+    const std::string_view line = l.lines [0];
+
+    num_allocs = 0;
+    const auto t0 = bench_clock::now ();
+    for (size_t iter = 0; iter < niters; iter++)
+        db_add::get_field_quotes (line, headers);
+    Result r;
+    r.secs = std::chrono::duration <double> (bench_clock::now () -
+            t0).count ();
+    r.nallocs = num_allocs;
+    r.nlines = niters;
+    r.nfields = niters * headers.nvalues;
+
+    return r;
+}
+
+// Number of stations of the maps of bench_lookups, similar to numbers in the
+// largest systems
+const size_t num_stations = 1000;
+
+// IDs or names of num_stations stations
+std::vector <std::string> station_keys (bool names)
+{
+    std::vector <std::string> keys;
+    char buf [64];
+    for (size_t i = 0; i < num_stations; i++)
+    {
+        if (names)
+            snprintf (buf, sizeof (buf), "Station %zu & W %zu St", i,
+                    (i * 37) % 200);
+        else
+            snprintf (buf, sizeof (buf), "ny%zu", 72 + i * 7);
+        keys.push_back (buf);
+    }
+    return keys;
+}
+
+// Look up the start and end stations of 100 * "niters" trips (because lookups
+// are much faster than parsing lines), with stations taken in
+// a fixed pseudo-random order, in either a std::map or a StringMap. Keys are
+// looked up from std::string_view values, as they are read from lines.
+template <class Map>
+Result bench_lookups (bool names, size_t niters)
+{
+    const std::vector <std::string> keys = station_keys (names);
+    Map stations;
+    for (auto &k: keys)
+        stations [std::string (k)] = k;
+
+    uint32_t state = 1;
+    auto next_key = [&] () -> std::string_view {
+        state = state * 1664525u + 1013904223u;
+        return keys [(state >> 8) % keys.size ()];
+    };
+
+    size_t nfound = 0;
+    num_allocs = 0;
+    const auto t0 = bench_clock::now ();
+    for (size_t iter = 0; iter < niters * 100; iter++)
+        for (size_t j = 0; j < 2; j++)
+        {
+            std::string_view k = next_key ();
+            if constexpr (std::is_same <Map, StringMap <std::string> >::value)
+                nfound += stations.find (k) != nullptr;
+            else
+                nfound += stations.find (std::string (k)) != stations.end ();
+        }
+    Result r;
+    r.secs = std::chrono::duration <double> (bench_clock::now () -
+            t0).count ();
+    r.nallocs = num_allocs;
+    r.nlines = niters * 100;
+    r.nfields = 2 * r.nlines;
+
+    if (nfound != r.nfields)
+        std::fprintf (stderr, "%zu stations not found\n", r.nfields - nfound);
+
+    return r;
+}
+
+} // end anonymous namespace
+
+int main (int argc, char * argv [])
+{
+    size_t niters = 20000;
+    if (argc > 1)
+        niters = std::strtoul (argv [1], nullptr, 10);
+    if (niters == 0)
+    {
+        std::fprintf (stderr, "usage: %s [iterations]\n", argv [0]);
+        return 1;
+    }
+
+    const char * routines [] = {"parse", "fallback", "datetime", "quotes"};
+    print_header ();
+    for (auto &l: layouts)
+    {
+        print_result (l.name, routines [0], bench_parser (l, niters, false));
+        if (l.type == parser::generic)
+            print_result (l.name, routines [1],
+                    bench_parser (l, niters, true));
+        print_result (l.name, routines [2], bench_datetime (l, niters));
+        if (l.type == parser::generic)
+            print_result (l.name, routines [3], bench_quotes (l, niters));
+    }
+
+    typedef std::map <std::string, std::string> StdMap;
+    for (bool names: {false, true})
+    {
+        const char * name = names ? "station names" : "station ids";
+        print_result (name, "std::map",
+                bench_lookups <StdMap> (names, niters));
+        print_result (name, "flat",
+                bench_lookups <StringMap <std::string> > (names, niters));
+    }
+
+    return 0;
+}
@@ -24,69 +24,77 @@ BEGIN_RCPP
 END_RCPP
 }
 // rcpp_import_to_trip_table
-int rcpp_import_to_trip_table(const char* bikedb, Rcpp::CharacterVector datafiles, std::string city, std::string header_file_name, bool data_has_stations, bool quiet);
-RcppExport SEXP _bikedata_rcpp_import_to_trip_table(SEXP bikedbSEXP, SEXP datafilesSEXP, SEXP citySEXP, SEXP header_file_nameSEXP, SEXP data_has_stationsSEXP, SEXP quietSEXP) {
+Rcpp::IntegerVector rcpp_import_to_trip_table(const char* bikedb, Rcpp::CharacterVector datafiles, Rcpp::CharacterVector datafile_names, std::string city, std::string header_file_name, bool data_has_stations, bool quiet, int nthreads, bool bulk, bool profile, double chunk_size);
+RcppExport SEXP _bikedata_rcpp_import_to_trip_table(SEXP bikedbSEXP, SEXP datafilesSEXP, SEXP datafile_namesSEXP, SEXP citySEXP, SEXP header_file_nameSEXP, SEXP data_has_stationsSEXP, SEXP quietSEXP, SEXP nthreadsSEXP, SEXP bulkSEXP, SEXP profileSEXP, SEXP chunk_sizeSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< const char* >::type bikedb(bikedbSEXP);
     Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type datafiles(datafilesSEXP);
+    Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type datafile_names(datafile_namesSEXP);
     Rcpp::traits::input_parameter< std::string >::type city(citySEXP);
     Rcpp::traits::input_parameter< std::string >::type header_file_name(header_file_nameSEXP);
     Rcpp::traits::input_parameter< bool >::type data_has_stations(data_has_stationsSEXP);
     Rcpp::traits::input_parameter< bool >::type quiet(quietSEXP);
-    rcpp_result_gen = Rcpp::wrap(rcpp_import_to_trip_table(bikedb, datafiles, city, header_file_name, data_has_stations, quiet));
+    Rcpp::traits::input_parameter< int >::type nthreads(nthreadsSEXP);
+    Rcpp::traits::input_parameter< bool >::type bulk(bulkSEXP);
+    Rcpp::traits::input_parameter< bool >::type profile(profileSEXP);
+    Rcpp::traits::input_parameter< double >::type chunk_size(chunk_sizeSEXP);
+    rcpp_result_gen = Rcpp::wrap(rcpp_import_to_trip_table(bikedb, datafiles, datafile_names, city, header_file_name, data_has_stations, quiet, nthreads, bulk, profile, chunk_size));
     return rcpp_result_gen;
 END_RCPP
 }
-// rcpp_import_to_file_table
-int rcpp_import_to_file_table(const char * bikedb, Rcpp::CharacterVector datafiles, std::string city, int nfiles);
-RcppExport SEXP _bikedata_rcpp_import_to_file_table(SEXP bikedbSEXP, SEXP datafilesSEXP, SEXP citySEXP, SEXP nfilesSEXP) {
+// rcpp_daily_trips
+Rcpp::List rcpp_daily_trips(const char * bikedb, Rcpp::List filters, bool per_station, bool standardise);
+RcppExport SEXP _bikedata_rcpp_daily_trips(SEXP bikedbSEXP, SEXP filtersSEXP, SEXP per_stationSEXP, SEXP standardiseSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< const char * >::type bikedb(bikedbSEXP);
-    Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type datafiles(datafilesSEXP);
-    Rcpp::traits::input_parameter< std::string >::type city(citySEXP);
-    Rcpp::traits::input_parameter< int >::type nfiles(nfilesSEXP);
-    rcpp_result_gen = Rcpp::wrap(rcpp_import_to_file_table(bikedb, datafiles, city, nfiles));
+    Rcpp::traits::input_parameter< Rcpp::List >::type filters(filtersSEXP);
+    Rcpp::traits::input_parameter< bool >::type per_station(per_stationSEXP);
+    Rcpp::traits::input_parameter< bool >::type standardise(standardiseSEXP);
+    rcpp_result_gen = Rcpp::wrap(rcpp_daily_trips(bikedb, filters, per_station, standardise));
     return rcpp_result_gen;
 END_RCPP
 }
 // rcpp_create_sqlite3_db
-int rcpp_create_sqlite3_db(const char * bikedb);
-RcppExport SEXP _bikedata_rcpp_create_sqlite3_db(SEXP bikedbSEXP) {
+int rcpp_create_sqlite3_db(const char * bikedb, bool compact, bool columnar, bool partitioned, bool wal);
+RcppExport SEXP _bikedata_rcpp_create_sqlite3_db(SEXP bikedbSEXP, SEXP compactSEXP, SEXP columnarSEXP, SEXP partitionedSEXP, SEXP walSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< const char * >::type bikedb(bikedbSEXP);
-    rcpp_result_gen = Rcpp::wrap(rcpp_create_sqlite3_db(bikedb));
+    Rcpp::traits::input_parameter< bool >::type compact(compactSEXP);
+    Rcpp::traits::input_parameter< bool >::type columnar(columnarSEXP);
+    Rcpp::traits::input_parameter< bool >::type partitioned(partitionedSEXP);
+    Rcpp::traits::input_parameter< bool >::type wal(walSEXP);
+    rcpp_result_gen = Rcpp::wrap(rcpp_create_sqlite3_db(bikedb, compact, columnar, partitioned, wal));
     return rcpp_result_gen;
 END_RCPP
 }
 // rcpp_create_db_indexes
-int rcpp_create_db_indexes(const char* bikedb, Rcpp::CharacterVector tables, Rcpp::CharacterVector cols, bool reindex);
-RcppExport SEXP _bikedata_rcpp_create_db_indexes(SEXP bikedbSEXP, SEXP tablesSEXP, SEXP colsSEXP, SEXP reindexSEXP) {
+Rcpp::NumericVector rcpp_create_db_indexes(const char* bikedb, Rcpp::CharacterVector tables, Rcpp::CharacterVector cols);
+RcppExport SEXP _bikedata_rcpp_create_db_indexes(SEXP bikedbSEXP, SEXP tablesSEXP, SEXP colsSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
     Rcpp::traits::input_parameter< const char* >::type bikedb(bikedbSEXP);
     Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type tables(tablesSEXP);
     Rcpp::traits::input_parameter< Rcpp::CharacterVector >::type cols(colsSEXP);
-    Rcpp::traits::input_parameter< bool >::type reindex(reindexSEXP);
-    rcpp_result_gen = Rcpp::wrap(rcpp_create_db_indexes(bikedb, tables, cols, reindex));
+    rcpp_result_gen = Rcpp::wrap(rcpp_create_db_indexes(bikedb, tables, cols));
     return rcpp_result_gen;
 END_RCPP
 }
-// rcpp_create_city_index
-int rcpp_create_city_index(const char* bikedb, bool reindex);
-RcppExport SEXP _bikedata_rcpp_create_city_index(SEXP bikedbSEXP, SEXP reindexSEXP) {
+// rcpp_tripmat
+Rcpp::NumericMatrix rcpp_tripmat(const char * bikedb, Rcpp::List filters);
+RcppExport SEXP _bikedata_rcpp_tripmat(SEXP bikedbSEXP, SEXP filtersSEXP) {
 BEGIN_RCPP
     Rcpp::RObject rcpp_result_gen;
     Rcpp::RNGScope rcpp_rngScope_gen;
-    Rcpp::traits::input_parameter< const char* >::type bikedb(bikedbSEXP);
-    Rcpp::traits::input_parameter< bool >::type reindex(reindexSEXP);
-    rcpp_result_gen = Rcpp::wrap(rcpp_create_city_index(bikedb, reindex));
+    Rcpp::traits::input_parameter< const char * >::type bikedb(bikedbSEXP);
+    Rcpp::traits::input_parameter< Rcpp::List >::type filters(filtersSEXP);
+    rcpp_result_gen = Rcpp::wrap(rcpp_tripmat(bikedb, filters));
     return rcpp_result_gen;
 END_RCPP
 }
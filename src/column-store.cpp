@@ -0,0 +1,498 @@
+/***************************************************************************
+ *  Project:    bikedata
+ *  File:       column-store.cpp
+ *  Language:   C++
+ *
+ *  Author:     Mark Padgham
+ *  E-Mail:     mark.padgham@email.com
+ *
+ *  Description:    Columnar store of trips held alongside the SQLite3
+ *                  database, in binary files of fixed-width values for each
+ *                  city and month, which are memory-mapped for scanning.
+ *
+ *  Compiler Options:   -std=c++17
+ ***************************************************************************/
+
+#include "column-store.h"
+
+#include <charconv>
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#endif
+
+/***************************************************************************
+ * The store is a directory named by appending "_columns" to the name of the
+ * database, holding one file for each column of each partition, named
+ * "<city>_<part>_<column>.bin". Files are arrays of values in native byte
+ * order, so stores can not be shared between machines of different
+ * endianness. The "column_parts" table of the database records the number of
+ * rows of each partition, along with ranges of start and stop times used to
+ * skip partitions when scanning, and "column_stations" holds the station IDs
+ * of each integer station key. Both are updated in the same transactions as
+ * the trips table, so they only ever record rows of committed data files.
+ *
+ * Stores are created with the database (see rcpp_create_sqlite3_db), and can
+ * not be added to existing databases.
+ ***************************************************************************/
+
+const char * column_names [colstore::num_columns] = {"start_time",
+    "stop_time", "start_station", "end_station", "duration", "user_type"};
+const size_t column_widths [colstore::num_columns] = {sizeof (int64_t),
+    sizeof (int64_t), sizeof (int32_t), sizeof (int32_t), sizeof (double),
+    sizeof (int32_t)};
+
+std::string colstore::dir_name (sqlite3 * dbcon)
+{
+    return std::string (sqlite3_db_filename (dbcon, "main")) + "_columns";
+}
+
+std::string colstore::file_name (const std::string &dir,
+        const std::string &city, const std::string &part, Column col)
+{
+    return dir + "/" + city + "_" + part + "_" + column_names [col] + ".bin";
+}
+
+bool colstore::has_store (sqlite3 * dbcon)
+{
+    return db_utils::has_table (dbcon, "column_parts");
+}
+
+//' get_parts
+//'
+//' @return All partitions of the store for one city, in order of name
+//'
+//' @noRd
+std::vector <colstore::Part> colstore::get_parts (sqlite3 * dbcon,
+        const std::string &city)
+{
+    sqlite3_stmt * stmt;
+    sqlite3_prepare_v2 (dbcon, "SELECT part, nrows, min_start, max_start, "
+            "min_stop, max_stop FROM column_parts WHERE city = ? "
+            "ORDER BY part", -1, &stmt, nullptr);
+    sqlite3_bind_text (stmt, 1, city.c_str (), -1, SQLITE_TRANSIENT);
+
+    auto get_time = [&stmt] (int col) {
+        if (sqlite3_column_type (stmt, col) == SQLITE_NULL)
+            return colstore::null_time;
+        return static_cast <int64_t> (sqlite3_column_int64 (stmt, col));
+    };
+
+    std::vector <Part> parts;
+    while (sqlite3_step (stmt) == SQLITE_ROW)
+    {
+        Part p;
+        p.name = reinterpret_cast <const char *> (
+                sqlite3_column_text (stmt, 0));
+        p.nrows = sqlite3_column_int64 (stmt, 1);
+        p.min_start = get_time (2);
+        p.max_start = get_time (3);
+        p.min_stop = get_time (4);
+        p.max_stop = get_time (5);
+        parts.push_back (p);
+    }
+    sqlite3_finalize (stmt);
+
+    return parts;
+}
+
+//' get_stations
+//'
+//' @return Station IDs of all keys of the store for one city, indexed by key
+//'
+//' @noRd
+std::vector <std::string> colstore::get_stations (sqlite3 * dbcon,
+        const std::string &city)
+{
+    sqlite3_stmt * stmt;
+    sqlite3_prepare_v2 (dbcon, "SELECT key, stn_id FROM column_stations "
+            "WHERE city = ?", -1, &stmt, nullptr);
+    sqlite3_bind_text (stmt, 1, city.c_str (), -1, SQLITE_TRANSIENT);
+
+    std::vector <std::string> stations;
+    while (sqlite3_step (stmt) == SQLITE_ROW)
+    {
+        const sqlite3_int64 key = sqlite3_column_int64 (stmt, 0);
+        if (key < 0)
+            continue;
+        if (static_cast <size_t> (key) >= stations.size ())
+            stations.resize (static_cast <size_t> (key) + 1);
+        stations [static_cast <size_t> (key)] =
+            reinterpret_cast <const char *> (sqlite3_column_text (stmt, 1));
+    }
+    sqlite3_finalize (stmt);
+
+    return stations;
+}
+
+//' has_files
+//'
+//' @return True if the files of all columns of all partitions exist and hold
+//'         all rows recorded in the database. Stores may otherwise be missing
+//'         if, for example, only the database file has been copied elsewhere.
+//'
+//' @noRd
+bool colstore::has_files (const std::string &dir, const std::string &city,
+        const std::vector <Part> &parts)
+{
+    for (auto p: parts)
+    {
+        for (size_t c = 0; c < num_columns; c++)
+        {
+            FILE * f = fopen (colstore::file_name (dir, city, p.name,
+                        static_cast <Column> (c)).c_str (), "rb");
+            if (f == nullptr)
+                return false;
+            fseek (f, 0, SEEK_END);
+            const int64_t size = utils::file_tell (f);
+            fclose (f);
+            if (size < p.nrows * static_cast <int64_t> (column_widths [c]))
+                return false;
+        }
+    }
+    return true;
+}
+
+colstore::ColumnWriter::ColumnWriter (sqlite3 * dbcon, const std::string &dir,
+        const std::string &city)
+    : dbcon (dbcon), dir (dir), city (city)
+{
+    for (auto p: colstore::get_parts (dbcon, city))
+        parts [p.name].part = p;
+
+    std::vector <std::string> stns = colstore::get_stations (dbcon, city);
+    for (size_t i = 0; i < stns.size (); i++)
+        stations.emplace (stns [i], static_cast <int32_t> (i));
+}
+
+int32_t colstore::ColumnWriter::station_key (std::string_view stn_id)
+{
+    buf.assign (stn_id.data (), stn_id.size ());
+    auto it = stations.find (buf);
+    if (it != stations.end ())
+        return it->second;
+
+    const int32_t key = static_cast <int32_t> (stations.size ());
+    stations.emplace (buf, key);
+    new_stations.push_back (buf);
+    return key;
+}
+
+//' add_batch
+//'
+//' Convert all trips of one batch to columns of the partitions of their months
+//' of starting. Values which can not be parsed are stored as NULL.
+//'
+//' @noRd
+void colstore::ColumnWriter::add_batch (const TripBatch &batch)
+{
+    const char * txt = batch.text.c_str ();
+    size_t pos = 0;
+
+    int64_t month = -1;
+    PartData * pd = nullptr;
+    std::array <std::string_view, num_trip_fields> vals;
+    std::array <bool, num_trip_fields> is_set;
+    for (size_t i = 0; i < batch.nrows; i++)
+    {
+        for (size_t j = 0; j < num_trip_fields; j++)
+        {
+            const int len = batch.lens [i * num_trip_fields + j];
+            is_set [j] = len >= 0;
+            if (len < 0)
+                continue;
+            vals [j] = std::string_view (txt + pos, static_cast <size_t> (len));
+            pos += static_cast <size_t> (len);
+        }
+
+        int64_t start = null_time, stop = null_time;
+        if (!is_set [trip::start_time] ||
+                !utils::parse_datetime_fixed (vals [trip::start_time], start))
+            start = null_time;
+        if (!is_set [trip::stop_time] ||
+                !utils::parse_datetime_fixed (vals [trip::stop_time], stop))
+            stop = null_time;
+
+        // consecutive trips are generally in the same month
+        int64_t this_month = 0;
+        std::string name = "NA";
+        if (start != null_time)
+        {
+            int y;
+            unsigned int m, d;
+            utils::civil_from_days (utils::epoch_day (start), y, m, d);
+            this_month = static_cast <int64_t> (y) * 12 + m;
+            if (pd == nullptr || this_month != month)
+            {
+                char mbuf [16];
+                snprintf (mbuf, sizeof (mbuf), "%04d-%02u", y, m);
+                name = mbuf;
+            }
+        }
+        if (pd == nullptr || this_month != month)
+        {
+            pd = &parts [name];
+            pd->part.name = name;
+            month = this_month;
+        }
+
+        Part &p = pd->part;
+        if (start != null_time)
+        {
+            if (p.min_start == null_time || start < p.min_start)
+                p.min_start = start;
+            if (p.max_start == null_time || start > p.max_start)
+                p.max_start = start;
+        }
+        if (stop != null_time)
+        {
+            if (p.min_stop == null_time || stop < p.min_stop)
+                p.min_stop = stop;
+            if (p.max_stop == null_time || stop > p.max_stop)
+                p.max_stop = stop;
+        }
+        pd->start_time.push_back (start);
+        pd->stop_time.push_back (stop);
+
+        pd->start_station.push_back (is_set [trip::start_station_id] ?
+                station_key (vals [trip::start_station_id]) : null_int);
+        pd->end_station.push_back (is_set [trip::end_station_id] ?
+                station_key (vals [trip::end_station_id]) : null_int);
+
+        double dur = std::nan ("");
+        if (is_set [trip::duration])
+        {
+            buf.assign (vals [trip::duration].data (),
+                    vals [trip::duration].size ());
+            char * end;
+            const double d = strtod (buf.c_str (), &end);
+            if (end != buf.c_str ())
+                dur = d;
+        }
+        pd->duration.push_back (dur);
+
+        int32_t ut = null_int;
+        if (is_set [trip::user_type])
+        {
+            std::string_view u = vals [trip::user_type];
+            int32_t val;
+            auto res = std::from_chars (u.data (), u.data () + u.size (), val);
+            if (res.ec == std::errc () && res.ptr == u.data () + u.size ())
+                ut = val;
+        }
+        pd->user_type.push_back (ut);
+    }
+}
+
+void colstore::ColumnWriter::write_column (const std::string &part,
+        Column col, int64_t nrows, const void * data, size_t width, size_t n)
+{
+    const std::string fname = colstore::file_name (dir, city, part, col);
+    FILE * f = fopen (fname.c_str (), "r+b");
+    if (f == nullptr && nrows == 0)
+        f = fopen (fname.c_str (), "wb");
+    if (f == nullptr)
+        throw std::runtime_error ("Unable to open column store file " + fname);
+
+    // Rows beyond those committed are overwritten
+    const int64_t offset = nrows * static_cast <int64_t> (width);
+    fseek (f, 0, SEEK_END);
+    bool ok = utils::file_tell (f) >= offset &&
+        utils::file_seek (f, offset) == 0;
+    if (ok)
+        ok = fwrite (data, width, n, f) == n;
+    if (fclose (f) != 0 || !ok)
+        throw std::runtime_error ("Unable to write column store file " + fname);
+}
+
+//' commit
+//'
+//' Append all trips added since the previous commit to the files of each
+//' partition, and record the new rows and stations in the database.
+//'
+//' @noRd
+void colstore::ColumnWriter::commit ()
+{
+    sqlite3_stmt * stmt;
+    sqlite3_prepare_v2 (dbcon, "INSERT INTO column_parts (city, part, nrows, "
+            "min_start, max_start, min_stop, max_stop) VALUES "
+            "(?, ?, ?, ?, ?, ?, ?) ON CONFLICT (city, part) DO UPDATE SET "
+            "nrows = excluded.nrows, min_start = excluded.min_start, "
+            "max_start = excluded.max_start, min_stop = excluded.min_stop, "
+            "max_stop = excluded.max_stop", -1, &stmt, nullptr);
+
+    int rc = SQLITE_DONE;
+    try
+    {
+        for (auto &pdi: parts)
+        {
+            PartData &pd = pdi.second;
+            Part &p = pd.part;
+            const size_t n = pd.start_time.size ();
+            if (n == 0)
+                continue;
+
+            write_column (p.name, colstore::start_time, p.nrows,
+                    pd.start_time.data (), sizeof (int64_t), n);
+            write_column (p.name, colstore::stop_time, p.nrows,
+                    pd.stop_time.data (), sizeof (int64_t), n);
+            write_column (p.name, colstore::start_station, p.nrows,
+                    pd.start_station.data (), sizeof (int32_t), n);
+            write_column (p.name, colstore::end_station, p.nrows,
+                    pd.end_station.data (), sizeof (int32_t), n);
+            write_column (p.name, colstore::duration, p.nrows,
+                    pd.duration.data (), sizeof (double), n);
+            write_column (p.name, colstore::user_type, p.nrows,
+                    pd.user_type.data (), sizeof (int32_t), n);
+            p.nrows += static_cast <int64_t> (n);
+
+            sqlite3_bind_text (stmt, 1, city.c_str (), -1, SQLITE_STATIC);
+            sqlite3_bind_text (stmt, 2, p.name.c_str (), -1, SQLITE_STATIC);
+            sqlite3_bind_int64 (stmt, 3, p.nrows);
+            const int64_t times [4] = {p.min_start, p.max_start, p.min_stop,
+                p.max_stop};
+            for (int j = 0; j < 4; j++)
+            {
+                if (times [j] == null_time)
+                    sqlite3_bind_null (stmt, j + 4);
+                else
+                    sqlite3_bind_int64 (stmt, j + 4, times [j]);
+            }
+            rc = sqlite3_step (stmt);
+            sqlite3_reset (stmt);
+            if (rc != SQLITE_DONE)
+                break;
+
+            pd.start_time.clear ();
+            pd.stop_time.clear ();
+            pd.start_station.clear ();
+            pd.end_station.clear ();
+            pd.duration.clear ();
+            pd.user_type.clear ();
+        }
+    } catch (...)
+    {
+        sqlite3_finalize (stmt);
+        throw;
+    }
+    sqlite3_finalize (stmt);
+    if (rc != SQLITE_DONE)
+        throw std::runtime_error ("Unable to update column_parts table");
+
+    if (new_stations.empty ())
+        return;
+
+    sqlite3_prepare_v2 (dbcon, "INSERT INTO column_stations (city, key, "
+            "stn_id) VALUES (?, ?, ?)", -1, &stmt, nullptr);
+    const int32_t key0 = static_cast <int32_t> (stations.size () -
+            new_stations.size ());
+    for (size_t i = 0; i < new_stations.size (); i++)
+    {
+        sqlite3_bind_text (stmt, 1, city.c_str (), -1, SQLITE_STATIC);
+        sqlite3_bind_int (stmt, 2, key0 + static_cast <int32_t> (i));
+        sqlite3_bind_text (stmt, 3, new_stations [i].c_str (), -1,
+                SQLITE_STATIC);
+        rc = sqlite3_step (stmt);
+        sqlite3_reset (stmt);
+        if (rc != SQLITE_DONE)
+            break;
+    }
+    sqlite3_finalize (stmt);
+    if (rc != SQLITE_DONE)
+        throw std::runtime_error ("Unable to update column_stations table");
+    new_stations.clear ();
+}
+
+colstore::MappedFile::MappedFile (const std::string &filename, size_t size)
+    : map_addr (nullptr), map_len (0), addr (nullptr)
+{
+    if (size == 0)
+        return;
+
+    FILE * f = fopen (filename.c_str (), "rb");
+    if (f == nullptr)
+        throw std::runtime_error ("Unable to open file " + filename);
+
+#ifndef _WIN32
+    void * a = mmap (nullptr, size, PROT_READ, MAP_PRIVATE, fileno (f), 0);
+    if (a != MAP_FAILED)
+    {
+        madvise (a, size, MADV_SEQUENTIAL);
+        map_addr = a;
+        map_len = size;
+        addr = a;
+        fclose (f);
+        return;
+    }
+#endif
+
+    buffer.resize ((size + sizeof (int64_t) - 1) / sizeof (int64_t));
+    const size_t nread = fread (buffer.data (), 1, size, f);
+    fclose (f);
+    if (nread != size)
+        throw std::runtime_error ("Unable to read file " + filename);
+    addr = buffer.data ();
+}
+
+colstore::MappedFile::~MappedFile ()
+{
+#ifndef _WIN32
+    if (map_addr != nullptr)
+        munmap (map_addr, map_len);
+#endif
+}
+
+colstore::PartReader::PartReader (const std::string &dir,
+        const std::string &city, const Part &part)
+{
+    for (size_t c = 0; c < num_columns; c++)
+        files [c].reset (new MappedFile (colstore::file_name (dir, city,
+                        part.name, static_cast <Column> (c)),
+                    static_cast <size_t> (part.nrows) * column_widths [c]));
+}
+
+bool colstore::RowFilter::skip_part (const Part &p) const
+{
+    const bool need_start = has_max_start || max_start_secs >= 0 ||
+        weekdays != 0;
+    const bool need_stop = has_min_stop || min_stop_secs >= 0;
+    if ((need_start && p.min_start == null_time) ||
+            (need_stop && p.max_stop == null_time))
+        return true;
+    return (has_max_start && p.min_start > max_start) ||
+        (has_min_stop && p.max_stop < min_stop);
+}
+
+bool colstore::RowFilter::matches (const PartReader &r, size_t i) const
+{
+    auto secs = [] (int64_t t) {
+        return static_cast <int> (t - utils::epoch_day (t) * 86400);
+    };
+
+    if (has_max_start || max_start_secs >= 0 || weekdays != 0)
+    {
+        const int64_t t = r.start_time () [i];
+        if (t == null_time || (has_max_start && t > max_start) ||
+                (max_start_secs >= 0 && secs (t) > max_start_secs))
+            return false;
+        if (weekdays != 0 &&
+                !(weekdays & (1u << utils::weekday (utils::epoch_day (t)))))
+            return false;
+    }
+    if (has_min_stop || min_stop_secs >= 0)
+    {
+        const int64_t t = r.stop_time () [i];
+        if (t == null_time || (has_min_stop && t < min_stop) ||
+                (min_stop_secs >= 0 && secs (t) < min_stop_secs))
+            return false;
+    }
+    if (has_user_type && r.user_type () [i] != user_type)
+        return false;
+    if (has_start_station && r.start_station () [i] != start_station)
+        return false;
+
+    return true;
+}
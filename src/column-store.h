@@ -0,0 +1,168 @@
+#pragma once
+/***************************************************************************
+ *  Project:    bikedata
+ *  File:       column-store.h
+ *  Language:   C++
+ *
+ *  Author:     Mark Padgham
+ *  E-Mail:     mark.padgham@email.com
+ *
+ *  Description:    Columnar store of trips held alongside the SQLite3
+ *                  database, in binary files of fixed-width values for each
+ *                  city and month, which are memory-mapped for scanning.
+ *
+ *  Compiler Options:   -std=c++17
+ ***************************************************************************/
+
+#include "common.h"
+#include "utils.h"
+#include "vendor/sqlite3/sqlite3.h"
+#include "sqlite3db-utils.h"
+
+#include <array>
+#include <climits>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include <Rcpp.h>
+
+namespace colstore {
+
+// Columns of the store. Times are seconds since 1970 (int64_t), stations are
+// keys into the "column_stations" table (int32_t), durations are doubles, and
+// user types are int32_t.
+enum Column {
+    start_time, stop_time, start_station, end_station, duration, user_type
+};
+const size_t num_columns = 6;
+
+// Values of NULL fields. NULL durations are NaN.
+const int64_t null_time = INT64_MIN;
+const int32_t null_int = INT32_MIN;
+
+// One partition of the store, holding all trips of one city which started in
+// one month (named "YYYY-MM"), or with NULL start times (named "NA"). Ranges
+// of times are null_time for partitions with no non-NULL times.
+struct Part {
+    std::string name;
+    int64_t nrows = 0;
+    int64_t min_start = null_time, max_start = null_time;
+    int64_t min_stop = null_time, max_stop = null_time;
+};
+
+std::string dir_name (sqlite3 * dbcon);
+std::string file_name (const std::string &dir, const std::string &city,
+        const std::string &part, Column col);
+bool has_store (sqlite3 * dbcon);
+std::vector <Part> get_parts (sqlite3 * dbcon, const std::string &city);
+std::vector <std::string> get_stations (sqlite3 * dbcon,
+        const std::string &city);
+
+// Appends trips of one city to the store. Trips are held in memory until
+// "commit", which appends them to the files of each partition and updates the
+// "column_parts" and "column_stations" tables, and must be called within the
+// same transaction which inserts the trips into the trips table. Files may
+// then hold rows beyond those recorded in "column_parts" (if that transaction
+// is not committed), which are ignored, and overwritten by the next commit.
+class ColumnWriter
+{
+    public:
+        ColumnWriter (sqlite3 * dbcon, const std::string &dir,
+                const std::string &city);
+
+        ColumnWriter (const ColumnWriter &) = delete;
+        ColumnWriter &operator= (const ColumnWriter &) = delete;
+
+        void add_batch (const TripBatch &batch);
+        void commit ();
+
+    private:
+        struct PartData {
+            Part part;
+            std::vector <int64_t> start_time, stop_time;
+            std::vector <int32_t> start_station, end_station, user_type;
+            std::vector <double> duration;
+        };
+
+        sqlite3 * dbcon;
+        std::string dir, city, buf;
+        std::map <std::string, PartData> parts;
+        std::unordered_map <std::string, int32_t> stations;
+        std::vector <std::string> new_stations;
+
+        int32_t station_key (std::string_view stn_id);
+        void write_column (const std::string &part, Column col, int64_t nrows,
+                const void * data, size_t width, size_t n);
+};
+
+// Read-only mapping of the first "size" bytes of a file, falling back to
+// reading into memory where files can not be mapped (as for LineReader).
+class MappedFile
+{
+    public:
+        MappedFile (const std::string &filename, size_t size);
+        ~MappedFile ();
+
+        MappedFile (const MappedFile &) = delete;
+        MappedFile &operator= (const MappedFile &) = delete;
+
+        const void * data () const { return addr; }
+
+    private:
+        void * map_addr;
+        size_t map_len;
+        const void * addr;
+        std::vector <int64_t> buffer; // 8-byte aligned
+};
+
+// All columns of one partition
+class PartReader
+{
+    public:
+        PartReader (const std::string &dir, const std::string &city,
+                const Part &part);
+
+        const int64_t * start_time () const { return col <int64_t> (
+                colstore::start_time); }
+        const int64_t * stop_time () const { return col <int64_t> (
+                colstore::stop_time); }
+        const int32_t * start_station () const { return col <int32_t> (
+                colstore::start_station); }
+        const int32_t * end_station () const { return col <int32_t> (
+                colstore::end_station); }
+        const double * duration () const { return col <double> (
+                colstore::duration); }
+        const int32_t * user_type () const { return col <int32_t> (
+                colstore::user_type); }
+
+    private:
+        std::array <std::unique_ptr <MappedFile>, num_columns> files;
+
+        template <typename T> const T * col (Column c) const {
+            return static_cast <const T *> (files [c]->data ());
+        }
+};
+
+// Filters on trips in the store, equivalent to those of tripmat::filter_qry.
+// Trips with NULL values of any filtered field do not match.
+struct RowFilter {
+    bool has_min_stop = false, has_max_start = false;
+    int64_t min_stop = 0, max_start = 0; // stop_time >= ; start_time <=
+    int min_stop_secs = -1, max_start_secs = -1; // times of day, or -1
+    unsigned int weekdays = 0; // bits 0 (Sunday) to 6, or 0 for all
+    bool has_user_type = false;
+    int32_t user_type = 0;
+    bool has_start_station = false;
+    int32_t start_station = 0;
+
+    bool skip_part (const Part &p) const;
+    bool matches (const PartReader &r, size_t i) const;
+};
+
+bool has_files (const std::string &dir, const std::string &city,
+        const std::vector <Part> &parts);
+
+} // end namespace colstore
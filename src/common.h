@@ -2,14 +2,20 @@
 
 #include <stdio.h>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <map>
 #include <unordered_set>
 #include <locale> // tolower
 #include <algorithm> // count
+#include <array>
+#include <chrono>
+#include <cstdint>
 
 #include <boost/algorithm/string/replace.hpp>
 
+#include "string-map.h"
+
 
 // Stores the header data structure for a given city and file type, as directly
 // read in data from R/sysdata.rda, as generated by the data-raw/sysdata.Rmd
@@ -21,5 +27,162 @@ struct HeaderStruct {
     std::vector <int> position_file2db;
 };
 
+// A contiguous range of complete lines of one data file, from byte offset
+// "begin" up to but excluding "end", along with the header structure of that
+// file. Large files may be split into several chunks which can be read
+// independently.
+struct FileChunk {
+    std::string filename;
+    size_t filenum;
+    int64_t begin, end;
+    HeaderStruct headers;
+};
+
 // total number of fields in the trip table of database
 const unsigned int num_db_fields = 15;
+
+// Columns of the trips table which are filled by the line-reading routines
+// in read-city-files.cpp, in the order in which they are bound to the insert
+// statement (immediately following the "city" column).
+namespace trip {
+enum Field {
+    duration, start_time, stop_time, start_station_id, end_station_id,
+    bike_id, user_type, birth_year, gender
+};
+}
+const unsigned int num_trip_fields = 9;
+
+// Reasons for which lines of data files are not stored, as returned by the
+// line-reading routines in read-city-files.cpp. Lines which are stored return
+// "none" (= 0).
+namespace reject {
+enum Reason {
+    none, fields, datetime, station
+};
+}
+const unsigned int num_reject_reasons = 4;
+
+// Stages of reading data files which are timed when profiling (see
+// rcpp_import_to_trip_table). The "read", "parse", and "datetime" stages are
+// done by parser threads.
+namespace stage {
+enum Stage {
+    plan, read, parse, datetime, wait, insert, trip_counts, columns, stations,
+    commit, checkpoint, indexes
+};
+}
+const unsigned int num_stages = 12;
+
+// Adds the time between construction and destruction to "secs", unless that
+// is a nullptr, so stages are only timed when profiling.
+class StageTimer
+{
+    public:
+        explicit StageTimer (double * secs) : secs (secs)
+        {
+            if (secs)
+                t0 = std::chrono::steady_clock::now ();
+        }
+        ~StageTimer ()
+        {
+            if (secs)
+                *secs += std::chrono::duration <double> (
+                        std::chrono::steady_clock::now () - t0).count ();
+        }
+
+        StageTimer (const StageTimer &) = delete;
+        StageTimer &operator= (const StageTimer &) = delete;
+
+    private:
+        double * secs;
+        std::chrono::steady_clock::time_point t0;
+};
+
+// A single parsed line of a data file. Fields which are not set by the
+// respective reading routine remain NULL in the database.
+struct TripRow {
+    std::array <std::string, num_trip_fields> values;
+    std::array <bool, num_trip_fields> is_set;
+
+    void clear () { is_set.fill (false); }
+    void set (trip::Field f, std::string_view s)
+    {
+        values [f].assign (s.data (), s.size ());
+        is_set [f] = true;
+    }
+};
+
+// Data on one station read from trip files, keyed by station ID (with city
+// prefix). Locations are the text of the files.
+struct StationRow {
+    std::string name, latitude, longitude;
+};
+
+// State of date-time parsing (see utils::parse_datetime). "day_first" is only
+// true for London, where dates are d/m/YYYY rather than m/d/YYYY, while "fixed"
+// records whether the previous value had the standard fixed layout of
+// "YYYY-mm-dd HH:MM:SS".
+struct DateTimeFormat {
+    bool day_first = false;
+    bool fixed = false;
+};
+
+// Positions of the commas and double quotes of one line, in increasing order,
+// as filled by utils::index_line (see line-index.h). The vectors only grow, so
+// generally hold more values than the numbers of positions.
+struct LineIndex {
+    std::vector <uint32_t> commas, quotes;
+    size_t ncommas = 0, nquotes = 0;
+};
+
+// Working storage for the line-reading routines of one thread. This is re-used
+// for every line, so strings are only allocated while they grow to their
+// largest required sizes.
+struct LineScratch {
+    std::string line, line2;
+    std::array <std::string, num_db_fields> fields;
+    DateTimeFormat datetime_format;
+    LineIndex index;
+    double * datetime_secs = nullptr; // only when profiling
+};
+
+// Hash of the content of a data file, accumulated line by line as a polynomial
+// (modulo 2^61 - 1) in the hashes of each line, so hashes of consecutive chunks
+// of a file can be combined into the same hash of the whole file regardless of
+// how it was split. See utils.cpp.
+struct ContentHash {
+    uint64_t value = 0;
+    uint64_t nlines = 0;
+
+    void add_line (std::string_view line);
+    void append (const ContentHash &h);
+    std::string hex () const;
+};
+
+// All trips parsed from one data file, stored in a single character arena so
+// that parser threads can pass them to the database writer without allocating
+// individual strings for each field. Lengths of -1 flag NULL fields. Stations
+// are those read from files which include station data.
+struct TripBatch {
+    std::string text;
+    std::vector <int> lens;
+    size_t nrows = 0;
+    StringMap <StationRow> stations;
+    ContentHash hash; // of all lines read, including those not inserted
+    std::array <size_t, num_reject_reasons> rejected {}; // lines not inserted
+    std::array <double, num_stages> secs {}; // of parsing, when profiling
+
+    void push_back (const TripRow &row)
+    {
+        for (size_t i = 0; i < num_trip_fields; i++)
+        {
+            if (row.is_set [i])
+            {
+                text += row.values [i];
+                lens.push_back (static_cast <int> (row.values [i].size ()));
+            } else
+                lens.push_back (-1);
+        }
+        nrows++;
+    }
+};
@@ -0,0 +1,159 @@
+/***************************************************************************
+ *  Project:    bikedata
+ *  File:       line-index.cpp
+ *  Language:   C++
+ *
+ *  Author:     Mark Padgham
+ *  E-Mail:     mark.padgham@email.com
+ *
+ *  Description:    Index of the positions of all commas and double quotes
+ *                  in lines of data files. The AVX2 routine is compiled for
+ *                  that target only, and used only where the processor has
+ *                  it, so the package itself needs no special compiler flags.
+ *
+ *  Compiler Options:   -std=c++17
+ ***************************************************************************/
+
+#include "line-index.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define BIKEDATA_X86
+#include <immintrin.h>
+#endif
+
+namespace {
+
+// Append the positions of all bits of "mask", offset by "pos", to "out"
+inline void push_bits (uint32_t mask, size_t pos, uint32_t * out, size_t &n)
+{
+    while (mask != 0)
+    {
+#if defined(__GNUC__)
+        out [n++] = static_cast <uint32_t> (pos) +
+            static_cast <uint32_t> (__builtin_ctz (mask));
+#else
+        uint32_t b = 0;
+        while (((mask >> b) & 1u) == 0)
+            b++;
+        out [n++] = static_cast <uint32_t> (pos) + b;
+#endif
+        mask &= mask - 1;
+    }
+}
+
+// Scan bytes from "i" to the end of the line; returns the number of bytes
+// scanned.
+size_t scan_scalar (const char * s, size_t i, size_t n, LineIndex &index)
+{
+    for (; i < n; i++)
+    {
+        if (s [i] == ',')
+            index.commas [index.ncommas++] = static_cast <uint32_t> (i);
+        else if (s [i] == '\"')
+            index.quotes [index.nquotes++] = static_cast <uint32_t> (i);
+    }
+    return i;
+}
+
+#if defined(BIKEDATA_X86) && defined(__SSE2__)
+
+size_t scan_sse2 (const char * s, size_t i, size_t n, LineIndex &index)
+{
+    const __m128i comma = _mm_set1_epi8 (','), quote = _mm_set1_epi8 ('\"');
+    for (; i + 16 <= n; i += 16)
+    {
+        const __m128i block = _mm_loadu_si128 (
+                reinterpret_cast <const __m128i *> (s + i));
+        push_bits (static_cast <uint32_t> (_mm_movemask_epi8 (
+                        _mm_cmpeq_epi8 (block, comma))), i,
+                index.commas.data (), index.ncommas);
+        push_bits (static_cast <uint32_t> (_mm_movemask_epi8 (
+                        _mm_cmpeq_epi8 (block, quote))), i,
+                index.quotes.data (), index.nquotes);
+    }
+    return i;
+}
+
+#endif
+
+#if defined(BIKEDATA_X86)
+
+__attribute__ ((target ("avx2")))
+size_t scan_avx2 (const char * s, size_t i, size_t n, LineIndex &index)
+{
+    const __m256i comma = _mm256_set1_epi8 (','),
+          quote = _mm256_set1_epi8 ('\"');
+    for (; i + 32 <= n; i += 32)
+    {
+        const __m256i block = _mm256_loadu_si256 (
+                reinterpret_cast <const __m256i *> (s + i));
+        push_bits (static_cast <uint32_t> (_mm256_movemask_epi8 (
+                        _mm256_cmpeq_epi8 (block, comma))), i,
+                index.commas.data (), index.ncommas);
+        push_bits (static_cast <uint32_t> (_mm256_movemask_epi8 (
+                        _mm256_cmpeq_epi8 (block, quote))), i,
+                index.quotes.data (), index.nquotes);
+    }
+    return i;
+}
+
+bool cpu_has_avx2 ()
+{
+    __builtin_cpu_init ();
+    return __builtin_cpu_supports ("avx2");
+}
+
+const bool has_avx2 = cpu_has_avx2 ();
+
+#else
+
+const bool has_avx2 = false;
+
+#endif
+
+} // end anonymous namespace
+
+//' index_line
+//'
+//' Find the positions of all commas and double quotes in one line.
+//'
+//' @param line Line of a data file
+//' @param index LineIndex (see common.h) to be filled, which is re-used for
+//'        every line so that its vectors need only grow for the longest line
+//'
+//' @noRd
+void utils::index_line (std::string_view line, LineIndex &index)
+{
+    const size_t n = line.size ();
+    if (index.commas.size () < n)
+    {
+        index.commas.resize (n);
+        index.quotes.resize (n);
+    }
+    index.ncommas = index.nquotes = 0;
+
+    const char * s = line.data ();
+    size_t i = 0;
+#if defined(BIKEDATA_X86)
+    if (has_avx2)
+        i = scan_avx2 (s, i, n, index);
+#endif
+#if defined(BIKEDATA_X86) && defined(__SSE2__)
+    i = scan_sse2 (s, i, n, index);
+#endif
+    scan_scalar (s, i, n, index);
+}
+
+//' index_line_method
+//'
+//' @return Name of the instruction set used by index_line
+//'
+//' @noRd
+const char * utils::index_line_method ()
+{
+#if defined(BIKEDATA_X86) && defined(__SSE2__)
+    return has_avx2 ? "avx2" : "sse2";
+#else
+    return has_avx2 ? "avx2" : "scalar";
+#endif
+}
@@ -0,0 +1,85 @@
+#pragma once
+/***************************************************************************
+ *  Project:    bikedata
+ *  File:       line-index.h
+ *  Language:   C++
+ *
+ *  Author:     Mark Padgham
+ *  E-Mail:     mark.padgham@email.com
+ *
+ *  Description:    Index of the positions of all commas and double quotes
+ *                  in lines of data files, found in a single vectorised pass
+ *                  over each line, and the splitting of indexed lines into
+ *                  fields. Blocks of lines are scanned with AVX2 where the
+ *                  processor has it, otherwise with SSE2 on all x86-64
+ *                  processors, and otherwise with portable scalar code.
+ *
+ *  Compiler Options:   -std=c++17
+ ***************************************************************************/
+
+#include "common.h"
+
+#include <string_view>
+
+namespace utils {
+
+void index_line (std::string_view line, LineIndex &index);
+const char * index_line_method ();
+
+} // end namespace utils
+
+// Successive fields of an indexed line. Each call to "next" is equivalent to
+// utils::strtokv with a delimiter of a comma, preceded by a double quote if
+// "quote_before", and followed by one if "quote_after", so fields extend to
+// the first such delimiter, or to the end of the line.
+class FieldCursor
+{
+    public:
+        FieldCursor (std::string_view line, const LineIndex &index)
+            : line (line), index (index) {}
+
+        // Skip to just after the first double quote, as for an opening quote
+        // of the first field. Lines without quotes then have no more fields.
+        void skip_quote ()
+        {
+            size_t q = 0;
+            while (q < index.nquotes && index.quotes [q] < start)
+                q++;
+            if (q < index.nquotes)
+                start = index.quotes [q] + 1;
+            else
+                done = true;
+        }
+
+        bool next (bool quote_before, bool quote_after,
+                std::string_view &token)
+        {
+            if (done)
+                return false;
+
+            const size_t first = start + (quote_before ? 1 : 0);
+            for (; k < index.ncommas; k++)
+            {
+                const size_t p = index.commas [k];
+                if (p < first ||
+                        (quote_before && line [p - 1] != '\"') ||
+                        (quote_after && (p + 1 >= line.size () ||
+                                         line [p + 1] != '\"')))
+                    continue;
+                token = line.substr (start, p - start -
+                        (quote_before ? 1 : 0));
+                start = p + 1 + (quote_after ? 1 : 0);
+                k++;
+                return true;
+            }
+            token = line.substr (start);
+            done = true;
+            return true;
+        }
+
+    private:
+        std::string_view line;
+        const LineIndex &index;
+        size_t start = 0, k = 0; // start of next field, and of next comma
+        bool done = false;
+};
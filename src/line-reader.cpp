@@ -0,0 +1,182 @@
+/***************************************************************************
+ *  Project:    bikedata
+ *  File:       line-reader.cpp
+ *  Language:   C++
+ *
+ *  Author:     Mark Padgham
+ *  E-Mail:     mark.padgham@email.com
+ *
+ *  Description:    Reader which delivers lines from a byte range of a data
+ *                  file as views into a memory-mapped copy of that file,
+ *                  falling back to buffered reading where files can not be
+ *                  mapped.
+ *
+ *  Compiler Options:   -std=c++17
+ ***************************************************************************/
+
+#include "line-reader.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+/***************************************************************************
+ * Ranges are mapped read-only with a sequential access hint, and lines are
+ * returned as views directly into the mapping, so no data are copied and
+ * lines may be of any length. Mapping is not used on Windows, or where it
+ * fails (such as for very large files on 32-bit systems), in which case the
+ * range is read through a buffer which grows as needed to hold the longest
+ * line.
+ ***************************************************************************/
+
+// size of blocks read in the buffered fallback
+const size_t READ_BLOCK_SIZE = 1024 * 1024;
+
+LineReader::LineReader (const std::string &filename, int64_t begin,
+        int64_t end)
+    : range_begin (begin), range_end (end), pos (0),
+    map_addr (nullptr), map_len (0), data (nullptr), size (0),
+    pFile (nullptr), buf_begin (0), buf_end (0), eof (false)
+{
+    pFile = fopen (filename.c_str (), "rb");
+    if (pFile == nullptr)
+        throw std::runtime_error ("Unable to open file " + filename);
+
+    if (range_end < 0)
+    {
+        fseek (pFile, 0, SEEK_END);
+        range_end = utils::file_tell (pFile);
+    }
+    if (range_end < range_begin)
+        range_end = range_begin;
+
+    if (map_file ())
+    {
+        fclose (pFile);
+        pFile = nullptr;
+    } else if (utils::file_seek (pFile, range_begin) != 0)
+    {
+        fclose (pFile);
+        throw std::runtime_error ("Unable to read file " + filename);
+    }
+}
+
+LineReader::~LineReader ()
+{
+#ifndef _WIN32
+    if (map_addr != nullptr)
+        munmap (map_addr, map_len);
+#endif
+    if (pFile != nullptr)
+        fclose (pFile);
+}
+
+bool LineReader::map_file ()
+{
+#ifdef _WIN32
+    return false;
+#else
+    const int64_t len = range_end - range_begin;
+    if (len <= 0)
+        return true; // nothing to read
+    if (static_cast <uint64_t> (len) > SIZE_MAX / 2)
+        return false;
+
+    // mmap offsets must be multiples of the page size
+    const int64_t page = static_cast <int64_t> (sysconf (_SC_PAGESIZE));
+    const int64_t map_begin = range_begin - range_begin % page;
+    const size_t lead = static_cast <size_t> (range_begin - map_begin);
+    map_len = lead + static_cast <size_t> (len);
+
+    void * addr = mmap (nullptr, map_len, PROT_READ, MAP_PRIVATE,
+            fileno (pFile), static_cast <off_t> (map_begin));
+    if (addr == MAP_FAILED)
+    {
+        map_len = 0;
+        return false;
+    }
+    madvise (addr, map_len, MADV_SEQUENTIAL);
+
+    map_addr = addr;
+    data = static_cast <const char *> (addr) + lead;
+    size = static_cast <size_t> (len);
+    return true;
+#endif
+}
+
+// Move any partial line to the start of the buffer and read the next block,
+// growing the buffer if it is already full of one partial line.
+bool LineReader::fill_buffer ()
+{
+    const size_t remaining = static_cast <size_t> (range_end - range_begin) -
+        (pos + buf_end - buf_begin);
+    if (eof || remaining == 0)
+        return false;
+
+    const size_t partial = buf_end - buf_begin;
+    if (buf_begin > 0 && partial > 0)
+        memmove (&buffer [0], &buffer [buf_begin], partial);
+    buf_begin = 0;
+    buf_end = partial;
+
+    if (buffer.size () - buf_end < READ_BLOCK_SIZE)
+        buffer.resize (buf_end + READ_BLOCK_SIZE);
+
+    const size_t nread = fread (&buffer [buf_end], 1,
+            std::min (READ_BLOCK_SIZE, remaining), pFile);
+    if (nread == 0)
+        eof = true;
+    buf_end += nread;
+
+    return nread > 0;
+}
+
+bool LineReader::next_line (std::string_view &line)
+{
+    if (pFile == nullptr) // mapped
+    {
+        if (pos >= size)
+            return false;
+        const char * start = data + pos;
+        const char * nl = static_cast <const char *> (
+                memchr (start, '\n', size - pos));
+        const size_t len = (nl == nullptr) ? size - pos :
+            static_cast <size_t> (nl - start) + 1;
+        line = std::string_view (start, len);
+        pos += len;
+        return true;
+    }
+
+    size_t searched = 0; // bytes of the current line already searched
+    while (true)
+    {
+        const size_t avail = buf_end - buf_begin;
+        const char * nl = nullptr;
+        if (avail > searched)
+            nl = static_cast <const char *> (memchr (buffer.data () +
+                        buf_begin + searched, '\n', avail - searched));
+        size_t len;
+        if (nl != nullptr)
+            len = static_cast <size_t> (nl - (buffer.data () + buf_begin)) + 1;
+        else
+        {
+            searched = avail;
+            if (fill_buffer ())
+                continue;
+            len = buf_end - buf_begin; // final line without newline
+        }
+        if (len == 0)
+            return false;
+
+        line = std::string_view (buffer.data () + buf_begin, len);
+        buf_begin += len;
+        pos += len;
+        return true;
+    }
+}
@@ -0,0 +1,59 @@
+#pragma once
+/***************************************************************************
+ *  Project:    bikedata
+ *  File:       line-reader.h
+ *  Language:   C++
+ *
+ *  Author:     Mark Padgham
+ *  E-Mail:     mark.padgham@email.com
+ *
+ *  Description:    Reader which delivers lines from a byte range of a data
+ *                  file as views into a memory-mapped copy of that file,
+ *                  falling back to buffered reading where files can not be
+ *                  mapped.
+ *
+ *  Compiler Options:   -std=c++17
+ ***************************************************************************/
+
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cstdio>
+
+class LineReader
+{
+    public:
+        // end < 0 reads to the end of the file
+        LineReader (const std::string &filename, int64_t begin, int64_t end);
+        ~LineReader ();
+
+        LineReader (const LineReader &) = delete;
+        LineReader &operator= (const LineReader &) = delete;
+
+        // Lines include any terminating newline, and are only valid until the
+        // next call.
+        bool next_line (std::string_view &line);
+        // File offset of the start of the next line
+        int64_t offset () const { return range_begin +
+            static_cast <int64_t> (pos); }
+        int64_t end_offset () const { return range_end; }
+
+    private:
+        int64_t range_begin, range_end;
+        size_t pos;
+
+        // memory-mapped range
+        void * map_addr;
+        size_t map_len;
+        const char * data;
+        size_t size;
+
+        // buffered fallback
+        FILE * pFile;
+        std::string buffer;
+        size_t buf_begin, buf_end;
+        bool eof;
+
+        bool map_file ();
+        bool fill_buffer ();
+};
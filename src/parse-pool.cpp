@@ -0,0 +1,128 @@
+/***************************************************************************
+ *  Project:    bikedata
+ *  File:       parse-pool.cpp
+ *  Language:   C++
+ *
+ *  Author:     Mark Padgham 
+ *  E-Mail:     mark.padgham@email.com 
+ *
+ *  Description:    Pool of threads which parse data files into TripBatch
+ *                  objects, delivered back to the calling thread in the
+ *                  original order of the files.
+ *
+ *  Compiler Options:   -std=c++17
+ ***************************************************************************/
+
+#include "parse-pool.h"
+
+/***************************************************************************
+ * Worker threads claim tasks in order, but may finish them in any order. The
+ * calling thread - which alone owns the database connection and may access R
+ * - collects the results strictly in task order through "next_batch", so trip
+ * IDs are identical to those generated by serial reading. Workers are allowed
+ * to run at most "max_ahead" tasks beyond the last collected result, to bound
+ * the amount of parsed data held in memory at any one time.
+ ***************************************************************************/
+
+ParsePool::ParsePool (size_t ntasks, size_t nthreads,
+        std::function <TripBatch (size_t)> parse_fn)
+    : ntasks (ntasks), parse_fn (parse_fn), batches (ntasks),
+    errors (ntasks), done (ntasks, false), next_task (0), nconsumed (0),
+    stopped (false)
+{
+    nthreads = std::max <size_t> (1, std::min (nthreads, ntasks));
+    max_ahead = 2 * nthreads;
+    for (size_t i = 0; i < nthreads; i++)
+        workers.emplace_back (&ParsePool::work, this);
+}
+
+ParsePool::~ParsePool ()
+{
+    stop ();
+}
+
+void ParsePool::stop ()
+{
+    {
+        std::lock_guard <std::mutex> lock (mtx);
+        stopped = true;
+    }
+    cv_space.notify_all ();
+    for (auto &w: workers)
+        if (w.joinable ())
+            w.join ();
+}
+
+void ParsePool::work ()
+{
+    while (true)
+    {
+        size_t i;
+        {
+            std::unique_lock <std::mutex> lock (mtx);
+            cv_space.wait (lock, [this] {
+                    return stopped || next_task >= ntasks ||
+                    next_task < nconsumed + max_ahead; });
+            if (stopped || next_task >= ntasks)
+                return;
+            i = next_task++;
+        }
+
+        TripBatch batch;
+        std::string err;
+        try
+        {
+            batch = parse_fn (i);
+        } catch (std::exception &e)
+        {
+            err = e.what ();
+            if (err.empty ())
+                err = "Unknown error parsing file";
+        } catch (...)
+        {
+            err = "Unknown error parsing file";
+        }
+
+        {
+            std::lock_guard <std::mutex> lock (mtx);
+            batches [i] = std::move (batch);
+            errors [i] = err;
+            done [i] = true;
+        }
+        cv_done.notify_all ();
+    }
+}
+
+//' next_batch
+//'
+//' Wait for task "i" to be completed and return its result. Must only be called
+//' from the main R thread, for successive values of "i", because it checks
+//' for user interrupts while waiting.
+//'
+//' @noRd
+TripBatch ParsePool::next_batch (size_t i)
+{
+    TripBatch batch;
+    std::string err;
+    while (true)
+    {
+        {
+            std::unique_lock <std::mutex> lock (mtx);
+            if (cv_done.wait_for (lock, std::chrono::milliseconds (100),
+                        [this, i] { return static_cast <bool> (done [i]); }))
+            {
+                batch = std::move (batches [i]);
+                err = errors [i];
+                nconsumed = i + 1;
+                break;
+            }
+        }
+        Rcpp::checkUserInterrupt ();
+    }
+    cv_space.notify_all ();
+
+    if (!err.empty ())
+        throw std::runtime_error (err);
+
+    return batch;
+}
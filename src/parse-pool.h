@@ -0,0 +1,54 @@
+#pragma once
+/***************************************************************************
+ *  Project:    bikedata
+ *  File:       parse-pool.h
+ *  Language:   C++
+ *
+ *  Author:     Mark Padgham 
+ *  E-Mail:     mark.padgham@email.com 
+ *
+ *  Description:    Pool of threads which parse data files into TripBatch
+ *                  objects, delivered back to the calling thread in the
+ *                  original order of the files.
+ *
+ *  Compiler Options:   -std=c++17
+ ***************************************************************************/
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <memory>
+
+#include "common.h"
+
+// [[Rcpp::depends(BH)]]
+#include <Rcpp.h>
+
+class ParsePool
+{
+    public:
+        ParsePool (size_t ntasks, size_t nthreads,
+                std::function <TripBatch (size_t)> parse_fn);
+        ~ParsePool ();
+
+        TripBatch next_batch (size_t i);
+        void stop ();
+
+    private:
+        void work ();
+
+        const size_t ntasks;
+        size_t max_ahead;
+        std::function <TripBatch (size_t)> parse_fn;
+
+        std::vector <TripBatch> batches;
+        std::vector <std::string> errors;
+        std::vector <bool> done;
+        size_t next_task, nconsumed;
+        bool stopped;
+
+        std::mutex mtx;
+        std::condition_variable cv_done, cv_space;
+        std::vector <std::thread> workers;
+};
@@ -1,6 +1,6 @@
 /***************************************************************************
  *  Project:    bikedata
- *  File:       read-city-files
+ *  File:       read-city-files.cpp
  *  Language:   C++
  *
  *  Author:     Mark Padgham 
@@ -9,10 +9,13 @@
  *  Description:    Routines to read single lines of the data files for
  *                  different cities.
  *
- *  Compiler Options:   -std=c++11
+ *  Compiler Options:   -std=c++17
  ***************************************************************************/
 
 #include "read-city-files.h"
+#include "line-index.h"
+
+#include <utility> // index_sequence
 
 
 /***************************************************************************
@@ -39,220 +42,399 @@
  * 
  ***************************************************************************/
 
+namespace {
+
+const std::string_view empty_quotes = "\"\"";
+
+// Start or stop times which are missing or can not be parsed, for which trips
+// are stored with NULL times
+const int64_t missing_time = INT64_MIN;
+
+typedef std::array <std::string_view, num_db_fields> FieldValues;
+
+// Missing values are marked in some files with "\N", and in NYC data files
+// starting from Aug 2018 onwards with NULL:
+// https://github.com/ropensci/bikedata/issues/96
+std::string_view replace_missing (std::string_view line,
+        const std::string &city, const HeaderStruct &headers,
+        LineScratch &scratch)
+{
+    if (line.find ("\\N") != std::string_view::npos)
+    {
+        utils::replace_all (line, "\\N",
+                headers.terminal_quote ? "\"\"" : "", scratch.line);
+        line = scratch.line;
+    }
+    
+    if (utils::strfound (city, "ny") &&
+            line.find ("NULL") != std::string_view::npos)
+    {
+        utils::replace_all (line, "NULL", "", scratch.line2);
+        line = scratch.line2;
+    }
+
+    return line;
+}
+
+// Store one field at position "Pos" of the database fields, converting values
+// where necessary. "times" are start and stop times in seconds since
+// 1970-01-01, or missing_time.
+template <int Pos>
+unsigned int set_field (std::string_view token, FieldValues &values,
+        int64_t * times, const std::string &city, LineScratch &scratch)
+{
+    values [Pos] = token;
+
+    if constexpr (Pos == 1 || Pos == 2)
+    {
+        StageTimer timer (scratch.datetime_secs);
+        // some London files have missing datetime strings:
+        if (token.length () == 0 ||
+                !utils::parse_datetime (token, scratch.datetime_format,
+                    times [Pos - 1]))
+        {
+            times [Pos - 1] = missing_time;
+            return reject::none;
+        }
+        utils::format_datetime (times [Pos - 1], scratch.fields [Pos]);
+        values [Pos] = scratch.fields [Pos];
+    } else if constexpr (Pos == 3 || Pos == 7)
+    {
+        // add city prefixes to station names
+        scratch.fields [Pos].assign (city);
+        scratch.fields [Pos].append (token.data (), token.size ());
+        values [Pos] = scratch.fields [Pos];
+    } else if constexpr (Pos == 12) // user type
+        values [Pos] = city::convert_usertype (token, scratch.fields [Pos]);
+    else if constexpr (Pos == 14) // gender
+        values [Pos] = city::convert_gender (token);
+
+    return reject::none;
+}
+
+// set_field for positions known only at run time
+typedef unsigned int (*FieldSetter) (std::string_view token,
+        FieldValues &values, int64_t * times, const std::string &city,
+        LineScratch &scratch);
+
+template <size_t... Pos>
+constexpr std::array <FieldSetter, sizeof... (Pos)> make_field_setters (
+        std::index_sequence <Pos...>)
+{
+    return {{&set_field <static_cast <int> (Pos)>...}};
+}
+
+constexpr std::array <FieldSetter, num_db_fields> field_setters =
+    make_field_setters (std::make_index_sequence <num_db_fields> ());
+
+// Fill the trip row and station data from the fields of one line
+void fill_row (TripRow &row, FieldValues &values, const int64_t * times,
+        StringMap <StationRow> * stations,
+        const std::string &city, const HeaderStruct &headers,
+        const StringMap <std::string> &stn_map,
+        LineScratch &scratch)
+{
+    const bool has_times = times [0] != missing_time &&
+        times [1] != missing_time;
+    if (values [0] == empty_quotes && has_times)
+    {
+        char buf [32];
+        int len = snprintf (buf, sizeof (buf), "%lld",
+                static_cast <long long> (times [1] - times [0]));
+        scratch.fields [0].assign (buf, static_cast <size_t> (len));
+        values [0] = scratch.fields [0];
+    }
+
+    // Use stn_maps for cities which don't have proper station ID values. Names
+    // are also modified here.
+    if (utils::strfound (city, "bo"))
+    {
+        for (size_t i: {4, 8})
+        {
+            city::convert_bo_stn_name (values [i], stn_map,
+                    scratch.fields [i], scratch.fields [i - 1]);
+            values [i - 1] = scratch.fields [i - 1];
+            values [i] = scratch.fields [i];
+        }
+    }
+
+    // Then fill the trip row, in which durations which can not be calculated
+    // and missing times are left as NULL
+    if (values [0] != empty_quotes || has_times)
+        row.set (trip::duration, values [0]);
+    if (times [0] != missing_time)
+        row.set (trip::start_time, values [1]);
+    if (times [1] != missing_time)
+        row.set (trip::stop_time, values [2]);
+    row.set (trip::start_station_id, values [3]);
+    row.set (trip::end_station_id, values [7]);
+    row.set (trip::bike_id, values [11]);
+    row.set (trip::user_type, values [12]);
+    row.set (trip::birth_year, values [13]);
+    row.set (trip::gender, values [14]);
+
+    // and add stations if needed, for start then end stations. Station IDs
+    // are only copied into the map for stations not yet seen.
+    if (headers.data_has_stations)
+    {
+        for (size_t i: {3, 7})
+        {
+            std::string_view stn_id = values [i], lat = values [i + 2],
+                lon = values [i + 3];
+            if (!stations->contains (stn_id) && lat != "0.0" &&
+                    lon != "0.0" && lat != "" && lon != "")
+            {
+                // Names have always been stored without single quotes
+                StationRow &stn = (*stations) [stn_id];
+                stn.name = values [i + 1];
+                boost::replace_all (stn.name, "\'", "");
+                stn.latitude = lat;
+                stn.longitude = lon;
+            }
+        }
+    }
+}
+
+} // end anonymous namespace
+
 //' read_one_line_generic
 //'
 //' Generic routine that works for all systems with well structure data files -
 //' meaning files that do not change structure (including patterns of quotation)
 //' within a single file. Systems may change structure between files, because
-//' file structure is auto-detected at start of each read.
+//' file structure is auto-detected at start of each read. This is the fallback
+//' for layouts which have no specialised routine (see select_generic_parser).
 //'
-//' @param stmt An sqlit3 statement to be assembled by reading the line of data
+//' Fields are views into the line (or into "scratch" where values have to be
+//' modified), so no strings need be allocated once "scratch" has grown to
+//' hold the longest values.
+//'
+//' @param row TripRow to be filled by reading the line of data
 //' @param line Line of data read from citibike file
-//' @param stationqry Sqlite3 query for station data table to be subsequently
-//'        passed to 'import_to_station_table()'
+//' @param stations Data on stations, to be subsequently passed to
+//'        'import_to_station_table()'
 //' @param HeaderStruct from common.h; if filled by examining the file.
 //' @param stn_map Only used for cities which don't have proper station ID
 //' codes, so that names can be mapped to these (currently just BO & DC).
+//' @param scratch Working storage re-used for every line. The time taken to
+//'        convert date-times is added to "scratch.datetime_secs" if set.
+//'
+//' @return 0 (reject::none) if the line is to be stored, otherwise the
+//'         reject::Reason (see common.h) for which it is not.
 //'
 //' @noRd
-unsigned int city::read_one_line_generic (sqlite3_stmt * stmt, char * line,
-        std::map <std::string, std::string> * stationqry,
-        const std::string city, const HeaderStruct &headers,
-        std::map <std::string, std::string> &stn_map)
+unsigned int city::read_one_line_generic (TripRow &row, std::string_view line,
+        StringMap <StationRow> * stations,
+        const std::string &city, const HeaderStruct &headers,
+        const StringMap <std::string> &stn_map,
+        LineScratch &scratch)
 {
-    const char * delim_noq_noq = ",";
-    const char * delim_noq_q = ",\"";
-    const char * delim_q_noq = "\",";
-    const char * delim_q_q = "\",\"";
-
-    std::string linestr = line;
-    if (headers.terminal_quote)
-        boost::replace_all (linestr, "\\N", "\"\"");
-    else
-        boost::replace_all (linestr, "\\N", "");
-    
-    // In NYC data files starting from Aug 2018 onwards missing values
-    // are marked as NULL: https://github.com/ropensci/bikedata/issues/96
-    if (utils::strfound (city, "ny"))
-        boost::replace_all (linestr, "NULL", "");
-
-    std::vector <std::string> values (num_db_fields);
-    std::fill (values.begin (), values.end (), "\"\"");
-    // first field has to be done separately to feed the startline linestr
-    // pointer
-    char * token;
+    line = replace_missing (line, city, headers, scratch);
+    utils::index_line (line, scratch.index);
+
+    FieldValues values;
+    values.fill (empty_quotes);
+    int64_t times [2] = {0, 0};
+    // Delimiters following each field include the closing quote of that
+    // field and the opening quote of the next
+    FieldCursor fields (line, scratch.index);
+    std::string_view token;
     if (headers.quoted [0])
+        fields.skip_quote (); // opening quote
+
+    for (unsigned int i = 0; i < (headers.nvalues - 1); i++)
     {
-        token = utils::strtokm (&linestr[0u], "\""); // opening quote
-        if (headers.quoted [1])
-            token = utils::strtokm (nullptr, delim_q_q);
-        else
-            token = utils::strtokm (nullptr, delim_q_noq);
-        (void) token; // suppress unused variable warning
-    } else
-    {
-        if (headers.quoted [1])
-            token = utils::strtokm (&linestr[0u], delim_noq_q);
-        else
-            token = utils::strtokm (&linestr[0u], delim_noq_noq);
+        // lines with too few fields can not be read
+        if (!fields.next (headers.quoted [i], headers.quoted [i + 1], token))
+            return reject::fields;
+
+        // sometimes (in London) string that should be quoted yet are
+        // missing have no empty quotes, and so the parsing is mucked up.
+        // This nevertheless always leaves empty commas at the start, so
+        if (i > 0 && token.substr (0, 1) == ",")
+            return reject::fields;
+
+        if (headers.position_file2db [i] < 0)
+            continue;
+        const size_t pos = static_cast <size_t> (headers.position_file2db [i]);
+        const unsigned int res = field_setters [pos] (token, values, times,
+                city, scratch);
+        if (res != reject::none)
+            return res;
     }
 
-    unsigned int pos;
-    if (headers.position_file2db [0] >= 0)
-    {
-        pos = static_cast <unsigned int> (headers.position_file2db [0]);
-        values [static_cast <size_t> (headers.position_file2db [0])] = token;
-    } else
-        pos = INT_MAX;
+    fill_row (row, values, times, stations, city, headers, stn_map, scratch);
 
-    if (pos == 1 || pos == 2) // happens for MN
-    {
-        if (values [pos].length () == 0)
-            return 1;
-        values [pos] = utils::convert_datetime (values [pos]);
-    }
+    return reject::none;
+}
 
-    // These don't arise in any data processed to date
-    if (pos == 3 || pos == 7) // add city prefixes to station names
-        values [pos] = city + values [pos];
-    if (pos == 12) // user type
-        values [pos] = city::convert_usertype (values [pos]);
-    if (pos == 14) // gender
-        values [pos] = city::convert_gender (values [pos]);
+/***************************************************************************
+ *  Layouts of data files which are read with specialised versions of
+ *  read_one_line_generic, in which numbers of fields, quoting, and positions
+ *  of fields in the database are all fixed at compile time. "quoted" has a
+ *  '1' for each quoted field, and "position" holds the database field number
+ *  (as tabulated above) of each field, or -1 for fields which are not stored.
+ *  Any other layouts, including those of DC, Minneapolis, and Boston to 2016,
+ *  for which specialised versions were no faster, are read with
+ *  read_one_line_generic.
+ ***************************************************************************/
 
-    for (unsigned int i = 1; i < (headers.nvalues - 1); i++)
-    {
-        if (headers.position_file2db [i] >= 0)
-            pos = static_cast <unsigned int> (headers.position_file2db [i]);
-        else
-            pos = INT_MAX;
+namespace {
+
+struct AllFields {
+    static constexpr std::array <int, 15> position = {
+        0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14};
+};
+
+// NYC to 2016; Boston 2017
+struct AllFieldsUnquoted : AllFields {
+    static constexpr std::string_view quoted = "000000000000000";
+};
+
+// NYC from 2017
+struct AllFieldsQuoted : AllFields {
+    static constexpr std::string_view quoted = "111111111111111";
+};
+
+// Boston from 2018
+struct AllFieldsBo : AllFields {
+    static constexpr std::string_view quoted = "011010001000110";
+};
+
+struct LayoutCh {
+    static constexpr std::array <int, 12> position = {
+        -1, 1, 2, 11, 0, 3, 4, 7, 8, 12, 14, 13};
+    static constexpr std::string_view quoted = "111111111111";
+};
+
+// San Francisco, for which "member_birth_year" is only quoted when empty (see
+// read_trip_chunk)
+struct LayoutSf {
+    static constexpr std::array <int, 16> position = {
+        0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, -1};
+};
+struct LayoutSfQuoted : LayoutSf {
+    static constexpr std::string_view quoted = "1111111111111111";
+};
+struct LayoutSfYear : LayoutSf {
+    static constexpr std::string_view quoted = "1111111111111011";
+};
+
+// Read field "I" of a line of layout "L", as for each iteration of the loop
+// of read_one_line_generic
+template <class L, size_t I>
+inline unsigned int read_field (FieldCursor &fields, FieldValues &values,
+        int64_t * times, const std::string &city, LineScratch &scratch)
+{
+    constexpr bool quoted = L::quoted [I] == '1';
+    constexpr bool next_quoted = L::quoted [I + 1] == '1';
+    constexpr int pos = L::position [I];
 
-        if (headers.quoted [i])
-        {
-            if (headers.quoted [i + 1])
-                token = utils::strtokm (nullptr, delim_q_q);
-            else
-                token = utils::strtokm (nullptr, delim_q_noq);
-        } else
-        {
-            if (headers.quoted [i + 1])
-                token = utils::strtokm (nullptr, delim_noq_q);
-            else
-                token = utils::strtokm (nullptr, delim_noq_noq);
-        }
+    if constexpr (I == 0 && quoted)
+        fields.skip_quote (); // opening quote
 
-        std::string tks = token;
-        // sometimes (in London) string that should be quoted yet are missing
-        // have no empty quotes, and so the parsing is mucked up. This
-        // nevertheless always leaves empty commas at the start, so
-        if (tks.substr (0, 1) == ",")
-            return 1;
-        if (i == (headers.nvalues - 1) && headers.terminal_quote)
-            boost::replace_all (tks, "\"", "");
+    std::string_view token;
+    if (!fields.next (quoted, next_quoted, token))
+        return reject::fields;
 
-        if (pos < INT_MAX)
-        {
-            values [pos] = tks;
+    if constexpr (I > 0)
+        if (!token.empty () && token.front () == ',')
+            return reject::fields;
 
-            if (pos == 1 || pos == 2)
-            {
-                // some London files have missing datetime strings:
-                if (values [pos].length () == 0)
-                    return 1;
-                values [pos] = utils::convert_datetime (values [pos]);
-            }
+    if constexpr (pos >= 0)
+        return set_field <pos> (token, values, times, city, scratch);
+    else
+        return reject::none;
+}
 
-            if (pos == 3 || pos == 7) // add city prefixes to station names
-                values [pos] = city + values [pos];
+template <class L, size_t... I>
+inline unsigned int read_fields (FieldCursor &fields, FieldValues &values,
+        int64_t * times, const std::string &city, LineScratch &scratch,
+        std::index_sequence <I...>)
+{
+    unsigned int res = reject::none;
+    // evaluated in order of fields, stopping at the first rejected field
+    (void) ((res = read_field <L, I> (fields, values, times, city,
+                    scratch), res == reject::none) && ...);
+    return res;
+}
 
-            if (pos == 12) // user type
-                values [pos] = city::convert_usertype (values [pos]);
+template <class L>
+unsigned int read_one_line_layout (TripRow &row, std::string_view line,
+        StringMap <StationRow> * stations,
+        const std::string &city, const HeaderStruct &headers,
+        const StringMap <std::string> &stn_map,
+        LineScratch &scratch)
+{
+    static_assert (L::quoted.size () == L::position.size (),
+            "layouts must have quotes for each field");
 
-            if (pos == 14) // gender
-                values [pos] = city::convert_gender (values [pos]);
-        }
-    }
+    line = replace_missing (line, city, headers, scratch);
+    utils::index_line (line, scratch.index);
 
-    if (values [0] == "\"\"")
-        values [0] = std::to_string (utils::timediff (values [1], values [2]));
+    FieldValues values;
+    values.fill (empty_quotes);
+    int64_t times [2] = {0, 0};
+    FieldCursor fields (line, scratch.index);
+    const unsigned int res = read_fields <L> (fields, values, times, city,
+            scratch, std::make_index_sequence <L::position.size () - 1> ());
+    if (res != reject::none)
+        return res;
 
-    // Use stn_maps for cities which don't have proper station ID values
-    if (utils::strfound (city, "bo"))
-    {
-        values [3] = city::convert_bo_stn_name (values [4], stn_map);
-        values [7] = city::convert_bo_stn_name (values [8], stn_map);
-    }
+    fill_row (row, values, times, stations, city, headers, stn_map, scratch);
 
-    // Then bind the SQLITE statement
-    // duration
-    sqlite3_bind_text(stmt, 2, values [0].c_str (), -1, SQLITE_TRANSIENT);
-    // starttime
-    sqlite3_bind_text(stmt, 3, values [1].c_str (), -1, SQLITE_TRANSIENT);
-    // endtime
-    sqlite3_bind_text(stmt, 4, values [2].c_str (), -1, SQLITE_TRANSIENT);
-    // startid
-    sqlite3_bind_text(stmt, 5, values [3].c_str (), -1, SQLITE_TRANSIENT);
-    // endid
-    sqlite3_bind_text(stmt, 6, values [7].c_str (), -1, SQLITE_TRANSIENT);
-    // bikeid
-    sqlite3_bind_text(stmt, 7, values [11].c_str (), -1, SQLITE_TRANSIENT);
-    // user
-    sqlite3_bind_text(stmt, 8, values [12].c_str (), -1, SQLITE_TRANSIENT);
-    // birthyear
-    sqlite3_bind_text(stmt, 9, values [13].c_str (), -1, SQLITE_TRANSIENT);
-    // gender
-    sqlite3_bind_text(stmt, 10, values [14].c_str (), -1, SQLITE_TRANSIENT);
-
-    // and add station queries if needed
-    if (headers.data_has_stations)
-    {
-        // start station:
-        std::string stn_id = values [3], stn_name = values [4], lon, lat;
-        if (utils::strfound (city, "sf"))
-        {
-            lon = values [5];
-            lat = values [6];
-        }
-        else
-        {
-            lon = values [5];
-            lat = values [6];
-        }
-        boost::replace_all (stn_name, "\'", "");
-        if (stationqry->count (stn_id) == 0 && lon != "0.0" && lat != "0.0" &&
-                lon != "" && lat != "")
-            (*stationqry)[stn_id] = "(\'" + city + "\',\'" + stn_id + "\',\'" +
-                stn_name + "\'," + lon + "," + lat + ")";
-
-        // end station:
-        stn_id = values [7];
-        stn_name = values [8];
-        if (utils::strfound (city, "sf"))
-        {
-            lon = values [9];
-            lat = values [10];
-        } else
-        {
-            lon = values [9];
-            lat = values [10];
-        }
-        boost::replace_all (stn_name, "\'", "");
-        if (stationqry->count (stn_id) == 0 && lon != "0.0" && lat != "0.0" &&
-                lon != "" && lat != "")
-            (*stationqry)[stn_id] = "(\'" + city + "\',\'" + stn_id + "\',\'" +
-                stn_name + "\'," + lon + "," + lat + ")";
-    }
+    return reject::none;
+}
 
-    return 0;
+template <class L>
+bool layout_matches (const HeaderStruct &headers)
+{
+    if (headers.nvalues != L::position.size () ||
+            headers.quoted.size () < headers.nvalues ||
+            headers.position_file2db.size () < headers.nvalues)
+        return false;
+    for (size_t i = 0; i < headers.nvalues; i++)
+        if (headers.position_file2db [i] != L::position [i] ||
+                headers.quoted [i] != (L::quoted [i] == '1'))
+            return false;
+    return true;
+}
+
+template <class... Ls>
+city::GenericParser select_layout (const HeaderStruct &headers)
+{
+    city::GenericParser parser = &city::read_one_line_generic;
+    (void) ((layout_matches <Ls> (headers) &&
+                (parser = &read_one_line_layout <Ls>, true)) || ...);
+    return parser;
+}
+
+} // end anonymous namespace
+
+//' select_generic_parser
+//'
+//' Select the routine used to read lines of a data file with the given
+//' structure, which is specialised for the layout of the file where that is
+//' known, and otherwise read_one_line_generic.
+//'
+//' @param headers HeaderStruct of the file, including quoting of fields
+//'
+//' @noRd
+city::GenericParser city::select_generic_parser (const HeaderStruct &headers)
+{
+    return select_layout <AllFieldsUnquoted, AllFieldsQuoted, AllFieldsBo,
+           LayoutCh, LayoutSfQuoted, LayoutSfYear> (headers);
 }
 
 //' read_one_line_london
 //'
-//' @param stmt An sqlit3 statement to be assembled by reading the line of data
+//' @param row TripRow to be filled by reading the line of data
 //' @param line Line of data read from Santander cycles file
+//' @param scratch Working storage re-used for every line
 //'
 //' @noRd
-unsigned int city::read_one_line_london (sqlite3_stmt * stmt, char * line)
+unsigned int city::read_one_line_london (TripRow &row, char * line,
+        LineScratch &scratch)
 {
     std::string in_line = line;
 
@@ -265,7 +447,7 @@ unsigned int city::read_one_line_london (sqlite3_stmt * stmt, char * line)
     std::string duration = utils::str_token (&in_line, ","); // Rental ID: not used
     duration = utils::str_token (&in_line, ",");
     std::string bike_id = utils::str_token (&in_line, ",");
-    std::string end_date = utils::convert_datetime_dmy (utils::str_token (&in_line, ","));
+    std::string end_date = utils::str_token (&in_line, ",");
     std::string end_station_id = utils::str_token (&in_line, ",");
     end_station_id = "lo" + end_station_id;
     std::string end_station_name;
@@ -277,21 +459,31 @@ unsigned int city::read_one_line_london (sqlite3_stmt * stmt, char * line)
         in_line = in_line.substr (1, in_line.length ()); // rm comma from start
     } else
         end_station_name = utils::str_token (&in_line, ",");
-    std::string start_date = utils::convert_datetime_dmy (utils::str_token (&in_line, ","));
+    std::string start_date = utils::str_token (&in_line, ",");
+    int64_t end_time = 0, start_time = 0;
+    bool dates_ok;
+    {
+        StageTimer timer (scratch.datetime_secs);
+        dates_ok = utils::parse_datetime (end_date, scratch.datetime_format,
+                end_time);
+        dates_ok = utils::parse_datetime (start_date,
+                scratch.datetime_format, start_time) && dates_ok;
+        utils::format_datetime (start_time, scratch.fields [1]);
+        utils::format_datetime (end_time, scratch.fields [2]);
+    }
     std::string start_station_id = utils::str_token (&in_line, ",");
     start_station_id = "lo" + start_station_id;
 
-    sqlite3_bind_text(stmt, 2, duration.c_str(), -1, SQLITE_TRANSIENT); 
-    sqlite3_bind_text(stmt, 3, start_date.c_str(), -1, SQLITE_TRANSIENT); 
-    sqlite3_bind_text(stmt, 4, end_date.c_str(), -1, SQLITE_TRANSIENT); 
-    sqlite3_bind_text(stmt, 5, start_station_id.c_str(), -1, SQLITE_TRANSIENT); 
-    sqlite3_bind_text(stmt, 6, end_station_id.c_str(), -1, SQLITE_TRANSIENT); 
-    sqlite3_bind_text(stmt, 7, bike_id.c_str(), -1, SQLITE_TRANSIENT); 
+    row.set (trip::duration, duration);
+    row.set (trip::start_time, scratch.fields [1]);
+    row.set (trip::stop_time, scratch.fields [2]);
+    row.set (trip::start_station_id, start_station_id);
+    row.set (trip::end_station_id, end_station_id);
+    row.set (trip::bike_id, bike_id);
 
-    unsigned int res = 0;
-    if (start_date == "" || end_date == "" ||
-            start_date == "NA" || end_date == "NA")
-        res = 1;
+    unsigned int res = reject::none;
+    if (!dates_ok)
+        res = reject::datetime;
 
     return res;
 }
@@ -301,14 +493,16 @@ unsigned int city::read_one_line_london (sqlite3_stmt * stmt, char * line)
 //' North American Bike Share Association open data standard (LA and
 //' Philadelpia) have identical file formats
 //'
-//' @param stmt An sqlit3 statement to be assembled by reading the line of data
+//' @param row TripRow to be filled by reading the line of data
 //' @param line Line of data read from LA metro or Philadelphia Indego file
-//' @param stationqry Sqlite3 query for station data table to be subsequently
-//'        passed to 'import_to_station_table()'
+//' @param stations Data on stations, to be subsequently passed to
+//'        'import_to_station_table()'
+//' @param scratch Working storage re-used for every line
 //'
 //' @noRd
-unsigned int city::read_one_line_nabsa (sqlite3_stmt * stmt, char * line,
-        std::map <std::string, std::string> * stationqry, std::string city)
+unsigned int city::read_one_line_nabsa (TripRow &row, char * line,
+        StringMap <StationRow> * stations, std::string city,
+        LineScratch &scratch)
 {
     std::string in_line = line;
     boost::replace_all (in_line, "\\N"," "); 
@@ -319,128 +513,150 @@ unsigned int city::read_one_line_nabsa (sqlite3_stmt * stmt, char * line,
 
     const char * delim;
     delim = ",";
-    char * trip_id = std::strtok (&in_line[0u], delim); 
+    char * next = nullptr;
+    char * trip_id = utils::strtokm (&in_line[0u], delim, &next);
     (void) trip_id; // supress unused variable warning;
-    unsigned int ret = 0;
-
-    std::string trip_duration = std::strtok (nullptr, delim);
-    std::string start_date = std::strtok (nullptr, delim);
-    start_date = utils::convert_datetime (start_date);
-    std::string end_date = std::strtok (nullptr, delim);
-    end_date = utils::convert_datetime (end_date);
-    std::string start_station_id = std::strtok (nullptr, delim);
+    unsigned int ret = reject::none;
+
+    std::string trip_duration = utils::strtokm (nullptr, delim, &next);
+    const char * start_date = utils::strtokm (nullptr, delim, &next);
+    const char * end_date = utils::strtokm (nullptr, delim, &next);
+    int64_t start_time = 0, end_time = 0;
+    {
+        StageTimer timer (scratch.datetime_secs);
+        if (start_date == nullptr || end_date == nullptr ||
+                !utils::parse_datetime (start_date, scratch.datetime_format,
+                    start_time) ||
+                !utils::parse_datetime (end_date, scratch.datetime_format,
+                    end_time))
+            return reject::datetime;
+        utils::format_datetime (start_time, scratch.fields [1]);
+        utils::format_datetime (end_time, scratch.fields [2]);
+    }
+    std::string start_station_id = utils::strtokm (nullptr, delim, &next);
     if (start_station_id == " " || start_station_id == "#N/A")
-        ret = 1;
+        ret = reject::station;
     start_station_id = city + start_station_id;
-    std::string start_station_lat = std::strtok (nullptr, delim);
-    std::string start_station_lon = std::strtok (nullptr, delim);
+    std::string start_station_lat = utils::strtokm (nullptr, delim, &next);
+    std::string start_station_lon = utils::strtokm (nullptr, delim, &next);
     // lat and lons are sometimes empty, which is useless 
-    if (stationqry->count(start_station_id) == 0 && ret == 0 &&
+    if (!stations->contains (start_station_id) && ret == 0 &&
             start_station_lat != " " && start_station_lon != " " &&
             start_station_lat != "0" && start_station_lon != "0")
     {
-        std::string start_station_name = "";
-        (*stationqry)[start_station_id] = "(\'" + city + "\',\'" +
-            start_station_id + "\',\'\'," + 
-            start_station_lat + delim + start_station_lon + ")";
+        stations->emplace (start_station_id, {"", start_station_lat,
+                start_station_lon});
     }
 
-    std::string end_station_id = std::strtok (nullptr, delim);
+    std::string end_station_id = utils::strtokm (nullptr, delim, &next);
     if (end_station_id == " " || end_station_id == "#N/A")
-        ret = 1;
+        ret = reject::station;
     end_station_id = city + end_station_id;
-    std::string end_station_lat = std::strtok (nullptr, delim);
-    std::string end_station_lon = std::strtok (nullptr, delim);
-    if (stationqry->count(end_station_id) == 0 && ret == 0 &&
+    std::string end_station_lat = utils::strtokm (nullptr, delim, &next);
+    std::string end_station_lon = utils::strtokm (nullptr, delim, &next);
+    if (!stations->contains (end_station_id) && ret == 0 &&
             end_station_lat != " " && end_station_lon != " " &&
             end_station_lat != "0" && end_station_lon != "0")
     {
-        std::string end_station_name = "";
-        (*stationqry)[end_station_id] = "(\'" + city + "\',\'" +
-            end_station_id + "\',\'\'," + 
-            end_station_lat + "," + end_station_lon + ")";
+        stations->emplace (end_station_id, {"", end_station_lat,
+                end_station_lon});
     }
     // NABSA systems only have duration of membership as (30 = monthly, etc)
-    std::string user_type = std::strtok (nullptr, delim); // bike_id
-    user_type = std::strtok (nullptr, delim); // plan_duration
-    user_type = std::strtok (nullptr, delim); // trip_route_category
-    user_type = std::strtok (nullptr, delim); // finally, "passholder_type"
+    std::string user_type = utils::strtokm (nullptr, delim, &next); // bike_id
+    user_type = utils::strtokm (nullptr, delim, &next); // plan_duration
+    user_type = utils::strtokm (nullptr, delim, &next); // trip_route_category
+    user_type = utils::strtokm (nullptr, delim, &next); // finally, "passholder_type"
     if (user_type == "" || user_type == "Walk-up")
         user_type = "0"; // casual
     else
         user_type = "1"; // subscriber
 
-    sqlite3_bind_text(stmt, 2, trip_duration.c_str(), -1, SQLITE_TRANSIENT); 
-    sqlite3_bind_text(stmt, 3, start_date.c_str(), -1, SQLITE_TRANSIENT); 
-    sqlite3_bind_text(stmt, 4, end_date.c_str(), -1, SQLITE_TRANSIENT); 
-    sqlite3_bind_text(stmt, 5, start_station_id.c_str(), -1, SQLITE_TRANSIENT); 
-    sqlite3_bind_text(stmt, 6, end_station_id.c_str(), -1, SQLITE_TRANSIENT); 
-    sqlite3_bind_text(stmt, 7, "", -1, SQLITE_TRANSIENT); // bike ID
-    sqlite3_bind_text(stmt, 8, user_type.c_str(), -1, SQLITE_TRANSIENT); 
+    row.set (trip::duration, trip_duration);
+    row.set (trip::start_time, scratch.fields [1]);
+    row.set (trip::stop_time, scratch.fields [2]);
+    row.set (trip::start_station_id, start_station_id);
+    row.set (trip::end_station_id, end_station_id);
+    row.set (trip::bike_id, ""); // bike ID
+    row.set (trip::user_type, user_type);
 
     // The boost::replace_all above ensures void values are all single spaces
     if (start_station_id == " " || end_station_id == " " ||
             start_station_lat == " " || start_station_lon == " " ||
             end_station_lat == " " || end_station_lon == " ")
-        ret = 1; // trip data not stored!
+        ret = reject::station; // trip data not stored!
 
     return ret;
 }
 
 
-std::string city::convert_usertype (std::string ut)
+//' convert_usertype
+//'
+//' @param buf Storage for the lower-case version of "ut", without whitespace
+//'
+//' @return "1" for members or subscribers, otherwise "0"
+//'
+//' @noRd
+std::string_view city::convert_usertype (std::string_view ut,
+        std::string &buf)
 {
     // see comment in sqlite3db-add-data.cpp/get_field_positions - this is not
     // locale-safe!
-    std::transform (ut.begin (), ut.end (), ut.begin (), ::tolower);
-    boost::replace_all (ut, " ", "");
-    if (utils::strfound (ut, "member") || utils::strfound (ut, "subscriber") ||
-            utils::strfound (ut, "flex") || utils::strfound (ut, "monthly") ||
-            utils::strfound (ut, "indego30") || utils::strfound (ut, "1"))
-        ut = "1";
+    buf.clear ();
+    for (char c: ut)
+        if (c != ' ')
+            buf.push_back (static_cast <char> (::tolower (c)));
+    if (utils::strfound (buf, "member") || utils::strfound (buf, "subscriber") ||
+            utils::strfound (buf, "flex") || utils::strfound (buf, "monthly") ||
+            utils::strfound (buf, "indego30") || utils::strfound (buf, "1"))
+        return "1";
     else
-        ut = "0";
-    return ut;
+        return "0";
 }
 
-std::string city::convert_gender (std::string g)
+std::string_view city::convert_gender (std::string_view g)
 {
-    if (utils::strfound (g, "Female") || utils::strfound (g, "F") ||
-            utils::strfound (g, "2"))
-        g = "2";
-    else if (utils::strfound (g, "Male") || utils::strfound (g, "M") ||
-            utils::strfound (g, "1"))
-        g = "1";
+    const auto found = [g] (std::string_view target) {
+        return g.find (target) != std::string_view::npos;
+    };
+    if (found ("Female") || found ("F") || found ("2"))
+        return "2";
+    else if (found ("Male") || found ("M") || found ("1"))
+        return "1";
     else
-        g = "0";
-    return g;
+        return "0";
 }
 
 //' Convert names of Boston stations as given in trip files to standard names
 //'
-//' @param station_name String as read from trip file
+//' @param station_name String as read from trip file, which may be a view into
+//'        name
 //' @param stn_map Map of station names to IDs
+//' @param name Standard name of the station
+//' @param station_id ID of the station, or empty if not known
+//'
+//' @note Both outputs are assigned into existing buffers, so nothing is
+//' allocated once these have grown to hold the longest names.
 //'
 //' @noRd
-std::string city::convert_bo_stn_name (std::string &station_name,
-        std::map <std::string, std::string> &stn_map)
+void city::convert_bo_stn_name (std::string_view station_name,
+        const StringMap <std::string> &stn_map, std::string &name,
+        std::string &station_id)
 {
-    std::string station, station_id = "";
-    boost::replace_all (station_name, "\'", ""); // rm apostrophes
+    name.assign (station_name);
+    name.erase (std::remove (name.begin (), name.end (), '\''),
+            name.end ()); // rm apostrophes
 
-    size_t ipos = station_name.find ("(", 0);
+    station_id.clear ();
+    size_t ipos = name.find ('(');
     if (ipos != std::string::npos)
     {
-        station_id = "bo" + station_name.substr (ipos + 1,
-                station_name.length () - ipos - 2);
-        station_name = station_name.substr (0, ipos - 1);
-    } 
-    std::map <std::string, std::string>::const_iterator mpos;
-    mpos = stn_map.find (station_name);
-    if (mpos != stn_map.end ())
-        station_id = mpos->second;
-
-    return station_id;
+        station_id.assign ("bo");
+        station_id.append (name, ipos + 1, name.length () - ipos - 2);
+        name.resize (ipos > 0 ? ipos - 1 : name.length ());
+    }
+    const std::string * id = stn_map.find (name);
+    if (id != nullptr)
+        station_id.assign (*id);
 }
 
 //' Convert names of DC stations as given in trip files to standard names
@@ -457,7 +673,7 @@ std::string city::convert_bo_stn_name (std::string &station_name,
 //'
 //' @noRd
 std::string city::convert_dc_stn_name (std::string &station_name, bool id,
-        std::map <std::string, std::string> &stn_map)
+        const StringMap <std::string> &stn_map)
 {
     std::string station, station_id = "";
     boost::replace_all (station_name, "\'", ""); // rm apostrophes
@@ -482,10 +698,9 @@ std::string city::convert_dc_stn_name (std::string &station_name, bool id,
                 station_name.length () - 1);
     if (!id && !id_in_namestr)
     {
-        std::map <std::string, std::string>::const_iterator mpos;
-        mpos = stn_map.find (station_name);
-        if (mpos != stn_map.end ())
-            station_id = mpos->second;
+        const std::string * id = stn_map.find (station_name);
+        if (id != nullptr)
+            station_id = *id;
     }
 
     return station_id;
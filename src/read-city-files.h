@@ -1,6 +1,6 @@
 /***************************************************************************
  *  Project:    bikedata
- *  File:       read-city-files
+ *  File:       read-city-files.h
  *  Language:   C++
  *
  *  Author:     Mark Padgham 
@@ -9,31 +9,43 @@
  *  Description:    Routines to read single lines of the data files for
  *                  different cities.
  *
- *  Compiler Options:   -std=c++11
+ *  Compiler Options:   -std=c++17
  ***************************************************************************/
 #pragma once
 
 #include "common.h"
 #include "utils.h"
-#include "vendor/sqlite3/sqlite3.h"
 
 namespace city {
 
-unsigned int read_one_line_generic (sqlite3_stmt * stmt, char * line,
-        std::map <std::string, std::string> * stationqry,
-        const std::string city, const HeaderStruct &headers,
-        std::map <std::string, std::string> &stn_map);
-unsigned int read_one_line_london (sqlite3_stmt * stmt, char * line);
-unsigned int read_one_line_nabsa (sqlite3_stmt * stmt, char * line,
-        std::map <std::string, std::string> * stationqry,
-        std::string city);
+unsigned int read_one_line_generic (TripRow &row, std::string_view line,
+        StringMap <StationRow> * stations,
+        const std::string &city, const HeaderStruct &headers,
+        const StringMap <std::string> &stn_map,
+        LineScratch &scratch);
+// Routines reading lines of data files which are read with the generic
+// routine, as returned by select_generic_parser for the structure of each file.
+typedef unsigned int (*GenericParser) (TripRow &row, std::string_view line,
+        StringMap <StationRow> * stations,
+        const std::string &city, const HeaderStruct &headers,
+        const StringMap <std::string> &stn_map,
+        LineScratch &scratch);
 
-std::string convert_usertype (std::string ut);
-std::string convert_gender (std::string g);
+GenericParser select_generic_parser (const HeaderStruct &headers);
 
-std::string convert_bo_stn_name (std::string &station_name,
-        std::map <std::string, std::string> &stn_map);
+unsigned int read_one_line_london (TripRow &row, char * line,
+        LineScratch &scratch);
+unsigned int read_one_line_nabsa (TripRow &row, char * line,
+        StringMap <StationRow> * stations,
+        std::string city, LineScratch &scratch);
+
+std::string_view convert_usertype (std::string_view ut, std::string &buf);
+std::string_view convert_gender (std::string_view g);
+
+void convert_bo_stn_name (std::string_view station_name,
+        const StringMap <std::string> &stn_map, std::string &name,
+        std::string &station_id);
 std::string convert_dc_stn_name (std::string &station_name, bool id,
-        std::map <std::string, std::string> &stn_map);
+        const StringMap <std::string> &stn_map);
 
 } // end namespace city
@@ -0,0 +1,258 @@
+/***************************************************************************
+ *  Project:    bikedata
+ *  File:       read-headers.cpp
+ *  Language:   C++
+ *
+ *  Author:     Mark Padgham
+ *  E-Mail:     mark.padgham@email.com
+ *
+ *  Description:    Routines to map the header lines and quotation patterns
+ *                  of data files on to the fields of the trips table. These
+ *                  do not depend on the database, so can also be compiled
+ *                  into the stand-alone benchmarks of inst/bench.
+ *
+ *  Compiler Options:   -std=c++17
+ ***************************************************************************/
+
+#include "read-headers.h"
+
+//' HeaderSchema
+//'
+//' Load all variations of field names. Note that this is where the R 1-indexed
+//' positions are re-mapped to 0-indexed C++ versions.
+//'
+//' @param header_file_name File written by R/zzz.R
+//'
+//' @noRd
+db_add::HeaderSchema::HeaderSchema (const std::string &header_file_name)
+{
+    std::ifstream in_file;
+    in_file.open (header_file_name.c_str (), std::ios_base::in);
+    std::string line;
+    getline (in_file, line, '\n'); // header
+
+    while (getline (in_file, line, '\n'))
+    {
+        size_t ipos = line.find (",");
+        //std::string f1 = line.substr (0, ipos); // generic name: not used
+        line = line.substr (ipos + 1, line.length () - ipos - 1);
+        ipos = line.find (",");
+        std::string f2 = line.substr (0, ipos);
+        line = line.substr (ipos + 1, line.length () - ipos - 1);
+        ipos = line.find (",");
+        int indx = atoi (line.substr (0, ipos).c_str ());
+        line = line.substr (ipos + 1, line.length () - ipos - 1);
+        // line is then the city
+        variations [f2].emplace_back (line, indx - 1);
+    }
+    in_file.close ();
+}
+
+//' position
+//'
+//' @return The database field of one (normalised) field name of a data file
+//' from the nominated city, or -1 if the field is not stored. Where names are
+//' used for different fields in different cities, the first matching entry is
+//' used.
+//'
+//' @noRd
+int db_add::HeaderSchema::position (const std::string &field,
+        const std::string &city) const
+{
+    auto v = variations.find (field);
+    if (v == variations.end ())
+        return -1;
+    for (auto &var: v->second)
+        if (var.first.find ("all") != std::string::npos ||
+                var.first.find (city) != std::string::npos)
+            return var.second;
+    return -1;
+}
+
+//' Examine the header line of the data file to map the records on to the
+//' corresponding columns in the database. The database has the following fields
+//' and column numbers:
+//'    | number | field                   |
+//'    | ----   | ----------------------- |
+//'    | 0      | duration                |
+//'    | 1      | start_time              |
+//'    | 2      | end_time                |
+//'    | 3      | start_station_id        |
+//'    | 4      | start_station_name      |
+//'    | 5      | start_station_latitude  |
+//'    | 6      | start_station_longitude |
+//'    | 7      | end_station_id          |
+//'    | 8      | end_station_name        |
+//'    | 9      | end_station_latitude    |
+//'    | 10     | end_station_longitude   |
+//'    | 11     | bike_id                 |
+//'    | 12     | user_type               |
+//'    | 13     | birth_year              |
+//'    | 14     | gender                  |
+//' The HeaderStruct has vectors for "position" and "quoted". Each of these has
+//' the same length as the number of entries in the actual file (not necessarily
+//' equal to "num_db_fields = 15"), with "position" mapping each entry on to its
+//' corresponding position in the database, and using -1 to denote no
+//' corresponding field. Quotes are filled by "get_field_quotes".
+//' @noRd
+HeaderStruct db_add::HeaderSchema::field_positions (
+        std::string_view header_line, const std::string &city) const
+{
+    std::string key = city;
+    key += ':';
+    key.append (header_line.data (), header_line.size ());
+    {
+        std::lock_guard <std::mutex> lock (mtx);
+        auto m = mapped.find (key);
+        if (m != mapped.end ())
+            return m->second;
+    }
+
+    // remove all quotes, whitespace, underscores, and convert to lower. Dots
+    // are removed because csv test files replace " " with ".". Note that this
+    // only works because all systems to date are from the English-speaking
+    // world; see
+    // https://stackoverflow.com/questions/313970/how-to-convert-stdstring-to-lower-case
+    std::string line;
+    line.reserve (header_line.size ());
+    for (char c: header_line)
+        if (c != '\"' && c != ' ' && c != '_' && c != '.' && c != '\n' &&
+                c != '\r')
+            line.push_back (static_cast <char> (::tolower (c)));
+
+    HeaderStruct headers;
+    headers.data_has_stations = false;
+    headers.terminal_quote = false;
+    size_t start = 0, end;
+    do
+    {
+        end = line.find (',', start);
+        const std::string field = line.substr (start, end == std::string::npos ?
+                std::string::npos : end - start);
+        headers.position_file2db.push_back (position (field, city));
+        start = end + 1;
+    } while (end != std::string::npos);
+
+    headers.nvalues = static_cast <unsigned int> (
+            headers.position_file2db.size ());
+
+    std::lock_guard <std::mutex> lock (mtx);
+    mapped.emplace (key, headers);
+
+    return headers;
+}
+
+//' header_schema
+//'
+//' The HeaderSchema loaded from the nominated file, which is only read on the
+//' first call for each file.
+//'
+//' @noRd
+const db_add::HeaderSchema &db_add::header_schema (
+        const std::string &header_file_name)
+{
+    static std::mutex mtx;
+    static std::unordered_map <std::string,
+           std::unique_ptr <HeaderSchema> > schemas;
+
+    std::lock_guard <std::mutex> lock (mtx);
+    std::unique_ptr <HeaderSchema> &schema = schemas [header_file_name];
+    if (!schema)
+        schema.reset (new HeaderSchema (header_file_name));
+    return *schema;
+}
+
+//' get_field_positions
+//'
+//' @param header_line First line of a data file
+//' @param header_file_name File of variations of field names (see
+//'        HeaderSchema)
+//'
+//' @noRd
+HeaderStruct db_add::get_field_positions (std::string_view header_line,
+        const std::string &header_file_name, bool data_has_stations,
+        const std::string &city)
+{
+    HeaderStruct headers = db_add::header_schema (header_file_name).
+        field_positions (header_line, city);
+    headers.data_has_stations = data_has_stations;
+    return headers;
+}
+
+//' get_field_quotes
+//'
+//' The quotation structure of the header line does not always reflect the
+//' actual structure of the data, so the patterns of quotations are determined by
+//' the first data line rather than in "get_field_positions".
+//' @noRd
+void db_add::get_field_quotes (std::string_view line, HeaderStruct &headers)
+{
+    LineIndex index;
+    utils::index_line (line, index);
+    db_add::get_field_quotes (line, index, headers);
+}
+
+//' get_field_quotes
+//'
+//' Version for lines which have already been indexed. Each field is quoted if
+//' its first quote precedes its first comma, and then extends to the next '",'
+//' if quoted, otherwise to the next comma.
+//'
+//' @param index LineIndex of the line, from utils::index_line
+//'
+//' @noRd
+void db_add::get_field_quotes (std::string_view line, const LineIndex &index,
+        HeaderStruct &headers)
+{
+    headers.quoted.resize (headers.position_file2db.size ());
+    size_t start = 0, c = 0, q = 0; // start of field; next comma and quote
+    for (unsigned int i = 0; i < (headers.nvalues - 1); i++)
+    {
+        while (c < index.ncommas && index.commas [c] < start)
+            c++;
+        while (q < index.nquotes && index.quotes [q] < start)
+            q++;
+        headers.quoted [i] = q < index.nquotes &&
+            (c == index.ncommas || index.quotes [q] < index.commas [c]);
+
+        if (headers.quoted [i])
+        {
+            size_t cq = c;
+            while (cq < index.ncommas && (index.commas [cq] == start ||
+                        line [index.commas [cq] - 1] != '"'))
+                cq++;
+            // Malformed lines without '",' advance by one character
+            start = (cq < index.ncommas) ? index.commas [cq] + 1 : start + 1;
+        } else if (c < index.ncommas)
+            start = index.commas [c] + 1;
+    }
+    while (q < index.nquotes && index.quotes [q] < start)
+        q++;
+    if (q == index.nquotes)
+    {
+        headers.quoted [headers.nvalues - 1] = false;
+        headers.terminal_quote = false;
+    } else
+    {
+        headers.quoted [headers.nvalues - 1] = true;
+        headers.terminal_quote = true;
+    }
+}
+
+void db_add::dump_headers (const HeaderStruct &headers)
+{
+    Rcpp::Rcout << "Header has " << headers.nvalues <<
+        " with [quoted, pos_file2db, _db2file] having [" <<
+        headers.quoted.size () << ", " << headers.position_file2db.size () <<
+         "]" << std::endl;
+
+    for (size_t i = 0; i < headers.position_file2db.size (); i++)
+    {
+        Rcpp::Rcout << "pos [" << i << "] = " <<
+            headers.position_file2db [i];
+        if (headers.quoted [i])
+            Rcpp::Rcout << " is quoted" << std::endl;
+        else
+            Rcpp::Rcout << " is NOT quoted" << std::endl;
+    }
+}
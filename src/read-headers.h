@@ -0,0 +1,71 @@
+#pragma once
+/***************************************************************************
+ *  Project:    bikedata
+ *  File:       read-headers.h
+ *  Language:   C++
+ *
+ *  Author:     Mark Padgham
+ *  E-Mail:     mark.padgham@email.com
+ *
+ *  Description:    Routines to map the header lines and quotation patterns
+ *                  of data files on to the fields of the trips table. These
+ *                  do not depend on the database, so can also be compiled
+ *                  into the stand-alone benchmarks of inst/bench.
+ *
+ *  Compiler Options:   -std=c++17
+ ***************************************************************************/
+
+#include "common.h"
+#include "utils.h"
+#include "line-index.h"
+
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+
+namespace db_add {
+
+// Variations of the names of fields in the header lines of data files, as
+// written by R/zzz.R to "bikedata_headers.csv", which are loaded once for each
+// R session (see header_schema) and are not changed thereafter. The mappings
+// of header lines on to fields of the database are memoised, so each distinct
+// header of each city is only examined once, and the schema may be used from
+// any thread.
+class HeaderSchema
+{
+    public:
+        explicit HeaderSchema (const std::string &header_file_name);
+
+        HeaderSchema (const HeaderSchema &) = delete;
+        HeaderSchema &operator= (const HeaderSchema &) = delete;
+
+        HeaderStruct field_positions (std::string_view header_line,
+                const std::string &city) const;
+
+    private:
+        // (city, 0-indexed field number) of each variation of field names,
+        // where city is "all" for names used in all cities.
+        std::unordered_map <std::string,
+            std::vector <std::pair <std::string, int> > > variations;
+
+        // memoised results of field_positions, keyed by city and header line
+        mutable std::mutex mtx;
+        mutable std::unordered_map <std::string, HeaderStruct> mapped;
+
+        int position (const std::string &field, const std::string &city) const;
+};
+
+const HeaderSchema &header_schema (const std::string &header_file_name);
+
+HeaderStruct get_field_positions (std::string_view header_line,
+        const std::string &header_file_name, bool data_has_stations,
+        const std::string &city);
+void get_field_quotes (std::string_view line, HeaderStruct &headers);
+void get_field_quotes (std::string_view line, const LineIndex &index,
+        HeaderStruct &headers);
+void dump_headers (const HeaderStruct &headers);
+
+} // end namespace db_add
@@ -9,7 +9,7 @@
  *  Description:    Routines to read and store data on bike docking stations in
  *                  the stations table of the SQLite3 database.
  *
- *  Compiler Options:   -std=c++11
+ *  Compiler Options:   -std=c++17
  ***************************************************************************/
 
 #include "read-station-files.h"
@@ -18,71 +18,140 @@
 //'
 //' Inserts data into the table of stations in the database. Applies to those
 //' cities for which station data are included and read as part of the actual
-//' raw trips data: ny, boston, la, philly.
+//' raw trips data: ny, la, philly, sf. This is called within the transaction
+//' which inserts the trips.
 //'
 //' @param dbcon Active connection to sqlite3 database
-//' @param stationqry Station query constructed during reading of data with
-//'        rcpp_import_to_trip_table ()
+//' @param stations Stations read from data with rcpp_import_to_trip_table ()
 //'
-//' @return integer result code
+//' @return Number of stations added to the table
 //'
 //' @noRd
-int stns::import_to_station_table (sqlite3 * dbcon,
-    std::map <std::string, std::string> stationqry)
+int stns::import_to_station_table (sqlite3 * dbcon, const std::string &city,
+        const std::map <std::string, StationRow> &stations)
 {
-    char *zErrMsg = nullptr;
-    int rc;
-
-    // http://stackoverflow.com/questions/19337029/insert-if-not-exists-statement-in-sqlite
-    std::string fullstationqry = "INSERT OR IGNORE INTO stations "
-        "(city, stn_id, name, latitude, longitude) VALUES ";
-    fullstationqry += stationqry.begin ()->second;
-    for (auto thisstation = std::next (stationqry.begin ());
-            thisstation != stationqry.end (); ++thisstation)
+    stns::StationInsert ins (dbcon);
+    int n = 0;
+    for (auto &s: stations)
+        n += ins.insert (city, s.first, s.second);
+
+    return n;
+}
+
+stns::StationInsert::StationInsert (sqlite3 * dbcon)
+    : dbcon (dbcon)
+{
+    const char * update_qry = "UPDATE stations SET "
+        "name = ?3, latitude = ?4, longitude = ?5 "
+        "WHERE stn_id = ?2 AND name IS NULL AND longitude IS NULL";
+    const char * ins_qry = "INSERT OR IGNORE INTO stations "
+        "(city, stn_id, name, latitude, longitude) VALUES (?, ?, ?, ?, ?)";
+    if (sqlite3_prepare_v2 (dbcon, update_qry, -1, &update, nullptr) !=
+            SQLITE_OK ||
+            sqlite3_prepare_v2 (dbcon, ins_qry, -1, &ins, nullptr) !=
+            SQLITE_OK)
     {
-        fullstationqry += ", " + thisstation->second;
+        sqlite3_finalize (update);
+        sqlite3_finalize (ins);
+        throw std::runtime_error ("Unable to prepare station insertion");
     }
-    fullstationqry += ";";
 
-    rc = sqlite3_exec(dbcon, fullstationqry.c_str(), nullptr, nullptr, &zErrMsg);
-    if (rc != SQLITE_OK)
-        throw std::runtime_error ("Unable to insert stations into station table");
-
-    std::string qry = "SELECT AddGeometryColumn"
-                      "('stations', 'geom', 4326, 'POINT', 'XY');";
-    const char *sql = qry.c_str ();
-    rc = sqlite3_exec(dbcon, sql, nullptr, nullptr, &zErrMsg);
-    sqlite3_free (zErrMsg);
-
-    // NOTE: This 2nd query has to be a different variable, otherwise sqlite
-    // produces a memory leak
-    std::string qry2 = "UPDATE stations SET geom = MakePoint(longitude, latitude, 4326);";
-    const char *sql2 = qry2.c_str ();
-    rc = sqlite3_exec(dbcon, sql2, nullptr, nullptr, &zErrMsg);
-    sqlite3_free (zErrMsg);
-
-    return rc;
+    // This fails unless the database has a "geom" column, and SpatiaLite is
+    // loaded.
+    const char * geom_qry = "UPDATE stations SET "
+        "geom = MakePoint(longitude, latitude, 4326) "
+        "WHERE stn_id = ? AND name = ?";
+    if (sqlite3_prepare_v2 (dbcon, geom_qry, -1, &geom, nullptr) != SQLITE_OK)
+    {
+        sqlite3_finalize (geom);
+        geom = nullptr;
+    }
+}
+
+stns::StationInsert::~StationInsert ()
+{
+    sqlite3_finalize (update);
+    sqlite3_finalize (ins);
+    sqlite3_finalize (geom);
+}
+
+void stns::StationInsert::bind_row (sqlite3_stmt * stmt,
+        const std::string &city, const std::string &stn_id,
+        const StationRow &stn)
+{
+    sqlite3_bind_text (stmt, 1, city.c_str (), -1, SQLITE_STATIC);
+    sqlite3_bind_text (stmt, 2, stn_id.c_str (), -1, SQLITE_STATIC);
+    sqlite3_bind_text (stmt, 3, stn.name.c_str (), -1, SQLITE_STATIC);
+    db_utils::bind_number (stmt, 4, stn.latitude);
+    db_utils::bind_number (stmt, 5, stn.longitude);
+}
+
+//' StationInsert::insert
+//'
+//' @param stn_id Station ID, including city prefix
+//'
+//' @return True if a new row was added to the stations table
+//'
+//' @noRd
+bool stns::StationInsert::insert (const std::string &city,
+        const std::string &stn_id, const StationRow &stn)
+{
+    bind_row (update, city, stn_id, stn);
+    int rc = sqlite3_step (update);
+    sqlite3_reset (update);
+    if (rc != SQLITE_DONE)
+        throw std::runtime_error ("Unable to update station " + stn_id);
+    if (sqlite3_changes (dbcon) > 0)
+    {
+        set_geom (stn_id, stn);
+        return false;
+    }
+
+    bind_row (ins, city, stn_id, stn);
+    rc = sqlite3_step (ins);
+    sqlite3_reset (ins);
+    if (rc != SQLITE_DONE)
+        throw std::runtime_error ("Unable to insert station " + stn_id);
+    if (sqlite3_changes (dbcon) == 0)
+        return false;
+
+    set_geom (stn_id, stn);
+
+    return true;
 }
 
+// Rows are unique on (stn_id, name), so this only touches the row just
+// inserted or filled in.
+void stns::StationInsert::set_geom (const std::string &stn_id,
+        const StationRow &stn)
+{
+    if (!geom)
+        return;
+
+    sqlite3_bind_text (geom, 1, stn_id.c_str (), -1, SQLITE_STATIC);
+    sqlite3_bind_text (geom, 2, stn.name.c_str (), -1, SQLITE_STATIC);
+    sqlite3_step (geom);
+    sqlite3_reset (geom);
+}
 
 //' get_bo_stn_table
 //'
 //' Because some data files for Boston contain only the names of stations
-//' and not their ID numbers, a std::map is generated here mapping those names
+//' and not their ID numbers, a StringMap is generated here mapping those names
 //' onto IDs for easy insertion into the trips data table.
 //'
 //' @param dbcon Active connection to SQLite3 database
 //'
-//' @return std::map of <station name, station ID>
+//' @return StringMap of <station name, station ID>
 //'
 //' @note The map is tiny, so it's okay to return values rather than refs
 //'
 //' @noRd
-std::map <std::string, std::string> stns::get_bo_stn_table (sqlite3 * dbcon)
+StringMap <std::string> stns::get_bo_stn_table (sqlite3 * dbcon)
 {
     sqlite3_stmt * stmt;
     std::stringstream ss;
-    std::map <std::string, std::string> stn_map;
+    StringMap <std::string> stn_map;
 
     char qry_stns [BUFFER_SIZE] = "\0";
     snprintf (qry_stns, BUFFER_SIZE,
@@ -111,21 +180,21 @@ std::map <std::string, std::string> stns::get_bo_stn_table (sqlite3 * dbcon)
 //' get_dc_stn_table
 //'
 //' Because some data files for Washington DC contain only the names of stations
-//' and not their ID numbers, a std::map is generated here mapping those names
+//' and not their ID numbers, a StringMap is generated here mapping those names
 //' onto IDs for easy insertion into the trips data table.
 //'
 //' @param dbcon Active connection to SQLite3 database
 //'
-//' @return std::map of <station name, station ID>
+//' @return StringMap of <station name, station ID>
 //'
 //' @note The map is tiny, so it's okay to return values rather than refs
 //'
 //' @noRd
-std::map <std::string, std::string> stns::get_dc_stn_table (sqlite3 * dbcon)
+StringMap <std::string> stns::get_dc_stn_table (sqlite3 * dbcon)
 {
     sqlite3_stmt * stmt;
     std::stringstream ss;
-    std::map <std::string, std::string> stn_map;
+    StringMap <std::string> stn_map;
 
     char qry_stns [BUFFER_SIZE] = "\0";
     snprintf (qry_stns, BUFFER_SIZE,
@@ -268,8 +337,8 @@ std::unordered_set <std::string> stns::get_stn_ids (sqlite3 * dbcon, std::string
 //' @param dbcon Active connection to sqlite3 database
 //' @param stn_data An R DataFrame of (id, name, lon, lat) for all stations
 //'
-//' @return Number of stations to potentially be added to stations table (if not
-//'         already there).
+//' @return Number of stations added to stations table (excluding any already
+//'         there).
 //'
 //' @noRd
 // [[Rcpp::export]]
@@ -277,55 +346,43 @@ int rcpp_import_stn_df (const char * bikedb, Rcpp::DataFrame stn_data,
         std::string city)
 {
     sqlite3 *dbcon;
-    char *zErrMsg = nullptr;
 
     int rc = sqlite3_open_v2 (bikedb, &dbcon, SQLITE_OPEN_READWRITE, nullptr);
     if (rc != SQLITE_OK)
         throw std::runtime_error ("Can't establish sqlite3 connection");
 
-    std::string stationqry_base = "INSERT OR IGNORE INTO stations "
-        "(city, stn_id, name, longitude, latitude) VALUES ";
-    std::string stationqry = stationqry_base;
-
-    std::string msg = "Unable to insert stations for " + city; // used below
-
-    int num_stns_old = db_utils::get_stn_table_size (dbcon);
-
     Rcpp::CharacterVector stn_id = stn_data ["id"];
     Rcpp::CharacterVector stn_name = stn_data ["name"];
     Rcpp::CharacterVector stn_lon = stn_data ["lon"];
     Rcpp::CharacterVector stn_lat = stn_data ["lat"];
 
-    unsigned count = 0;
-    for (size_t i = 0; i < static_cast <size_t> (stn_data.nrow ()); i++)
+    // R objects are copied before inserting, so that no R API is called while
+    // the transaction is open.
+    std::vector <std::string> ids;
+    std::vector <StationRow> rows;
+    const size_t n = static_cast <size_t> (stn_data.nrow ());
+    for (size_t i = 0; i < n; i++)
     {
-        stationqry += "(\'" + city + "\',\'" + city + stn_id (i) + "\',\'" + 
-            stn_name (i) + "\'," + stn_lon (i) + "," + stn_lat (i) + ")";
-        // Older versions of SQLite3 only allow queries to contain max 500
-        // elements, so they are broken up here into chunks of 100
-        if (count == 100)
-        {
-            stationqry += ";";
-            rc = sqlite3_exec(dbcon, stationqry.c_str(), nullptr, nullptr, &zErrMsg);
-            sqlite3_free (zErrMsg);
-
-            if (rc != SQLITE_OK)
-                throw std::runtime_error (msg);
-            stationqry = stationqry_base;
-            count = 0;
-        }
-        else if (i < (static_cast <size_t> (stn_data.nrow ()) - 1))
-            stationqry += ",";
-        count++;
+        ids.push_back (city + Rcpp::as <std::string> (stn_id (i)));
+        rows.push_back ({Rcpp::as <std::string> (stn_name (i)),
+                Rcpp::as <std::string> (stn_lat (i)),
+                Rcpp::as <std::string> (stn_lon (i))});
     }
-    stationqry += ";";
 
-    rc = sqlite3_exec(dbcon, stationqry.c_str(), nullptr, nullptr, &zErrMsg);
-    if (rc != SQLITE_OK)
-        throw std::runtime_error (msg);
-    sqlite3_free (zErrMsg);
-
-    int num_stns_added = db_utils::get_stn_table_size (dbcon) - num_stns_old;
+    int num_stns_added = 0;
+    sqlite3_exec (dbcon, "BEGIN TRANSACTION", nullptr, nullptr, nullptr);
+    try
+    {
+        stns::StationInsert ins (dbcon);
+        for (size_t i = 0; i < n; i++)
+            num_stns_added += ins.insert (city, ids [i], rows [i]);
+    } catch (...)
+    {
+        sqlite3_exec (dbcon, "ROLLBACK", nullptr, nullptr, nullptr);
+        sqlite3_close_v2 (dbcon);
+        throw std::runtime_error ("Unable to insert stations for " + city);
+    }
+    sqlite3_exec (dbcon, "COMMIT", nullptr, nullptr, nullptr);
 
     rc = sqlite3_close_v2(dbcon);
     if (rc != SQLITE_OK)
@@ -10,7 +10,7 @@
  *  Description:    Routines to read and store data on bike docking stations in
  *                  the stations table of the SQLite3 database.
  *
- *  Compiler Options:   -std=c++11
+ *  Compiler Options:   -std=c++17
  ***************************************************************************/
 
 #include <unordered_set>
@@ -18,11 +18,42 @@
 #include "sqlite3db-utils.h"
 
 namespace stns {
-int import_to_station_table (sqlite3 * dbcon,
-    std::map <std::string, std::string> stationqry);
 
-std::map <std::string, std::string> get_bo_stn_table (sqlite3 * dbcon);
-std::map <std::string, std::string> get_dc_stn_table (sqlite3 * dbcon);
+// Prepared statements inserting stations into the stations table, ignoring
+// any already present. In databases with the compact schema, stations first
+// encountered in trip data are entered with only city and station ID, and
+// these rows are filled in here rather than duplicated, so that their "id"
+// values remain valid keys of the trips. Geometries are only set for rows
+// which are inserted or filled in, and only for databases with a "geom"
+// column created through SpatiaLite.
+class StationInsert
+{
+    public:
+        StationInsert (sqlite3 * dbcon);
+        ~StationInsert ();
+
+        StationInsert (const StationInsert &) = delete;
+        StationInsert &operator= (const StationInsert &) = delete;
+
+        bool insert (const std::string &city, const std::string &stn_id,
+                const StationRow &stn);
+
+    private:
+        sqlite3 * dbcon;
+        sqlite3_stmt * update = nullptr; // fills in rows with only IDs
+        sqlite3_stmt * ins = nullptr;
+        sqlite3_stmt * geom = nullptr;
+
+        void bind_row (sqlite3_stmt * stmt, const std::string &city,
+                const std::string &stn_id, const StationRow &stn);
+        void set_geom (const std::string &stn_id, const StationRow &stn);
+};
+
+int import_to_station_table (sqlite3 * dbcon, const std::string &city,
+        const std::map <std::string, StationRow> &stations);
+
+StringMap <std::string> get_bo_stn_table (sqlite3 * dbcon);
+StringMap <std::string> get_dc_stn_table (sqlite3 * dbcon);
 std::unordered_set <std::string> get_stn_ids (sqlite3 * dbcon, std::string ci);
 
 } // end namespace stns
@@ -1,6 +1,6 @@
 /***************************************************************************
  *  Project:    bikedata
- *  File:       splite3db-add-data.cpp
+ *  File:       sqlite3db-add-data.cpp
  *  Language:   C++
  *
  *  Author:     Mark Padgham 
@@ -10,7 +10,7 @@
  *                  Routines to construct sqlite3 database and associated
  *                  indexes are in 'sqlite3db-add-data.cpp'.
  *
- *  Compiler Options:   -std=c++11
+ *  Compiler Options:   -std=c++17
  ***************************************************************************/
 
 #include "sqlite3db-add-data.h"
@@ -56,32 +56,70 @@
 //'
 //' Extracts bike data for NYC citibike
 //' 
+//' Each group of files is committed in turn. In databases with write-ahead
+//' logs, the log is then checkpointed once it exceeds WAL_CHECKPOINT_FRAMES,
+//' without waiting for any readers, and finally truncated where possible.
+//'
 //' @param bikedb A string containing the path to the Sqlite3 database to 
 //'        use. It will be created automatically.
 //' @param datafiles A character vector containin the paths to the citibike 
 //'        .csv files to import.
+//' @param datafile_names Names under which each of datafiles is recorded in
+//'        the "datafiles" table. All files with the same name (such as all
+//'        files from one zip archive) are read in a single transaction which
+//'        also inserts the entry for that name into the "datafiles" table, so
+//'        interrupted calls leave only complete files in the database. Files
+//'        with names already in that table are skipped.
 //' @param city First two letters of city for which data are to be added (thus
 //'        far, "ny", "bo", "ch", "dc", and "la")
 //' @param quiet If FALSE (0), progress is displayed on screen
+//' @param nthreads Number of threads used to parse files. Large files are
+//'        split into chunks of complete lines, each of which is parsed by one
+//'        thread, while the calling thread holds the only connection to the
+//'        database and inserts parsed trips in the original file order.
+//'        Values < 2 parse all files serially in the calling thread.
+//' @param bulk If true, load data with pragmas which favour speed over
+//'        durability, restoring previous values afterwards. Indexes of the
+//'        trips table are dropped before loading, and rebuilt afterwards.
+//'        Files are split into chunks of at most CHUNK_SIZE bytes, but chunks
+//'        are no longer committed separately: as for all other loads, each
+//'        group of datafile_names is committed in one transaction. An
+//'        interrupted bulk load thus loses all of the file in progress rather
+//'        than at most one chunk, because trips of a partly-stored file could
+//'        not be removed on resuming without also reversing its additions to
+//'        trip_counts, statistics tables, and any column store.
+//' @param profile If true, the result has an additional "profile" attribute
+//'        with times of each stage of reading (see profile_list).
+//' @param chunk_size If positive, the size in bytes of the chunks into which
+//'        all files are split, regardless of nthreads and bulk; otherwise
+//'        CHUNK_SIZE. Only intended for testing.
 //'
-//' @return integer result code
+//' @return Number of trips added
 //'
 //' @noRd
 // [[Rcpp::export]]
-int rcpp_import_to_trip_table (const char* bikedb, 
-        Rcpp::CharacterVector datafiles, std::string city,
-        std::string header_file_name, bool data_has_stations, bool quiet)
+Rcpp::IntegerVector rcpp_import_to_trip_table (const char* bikedb, 
+        Rcpp::CharacterVector datafiles, Rcpp::CharacterVector datafile_names,
+        std::string city, std::string header_file_name,
+        bool data_has_stations, bool quiet, int nthreads, bool bulk,
+        bool profile, double chunk_size)
 {
     sqlite3 *dbcon;
     char *zErrMsg = nullptr;
     const char *zVfs = nullptr;
     size_t rc;
 
+    if (datafile_names.size () != datafiles.size ())
+        throw std::runtime_error ("datafiles and datafile_names must have "
+                "the same length");
+
     rc = static_cast <size_t> (sqlite3_open_v2(bikedb, &dbcon, SQLITE_OPEN_READWRITE, zVfs));
     //rc = static_cast <size_t> (sqlite3_open(bikedb, &dbcon));
     if (rc != SQLITE_OK)
         throw std::runtime_error ("Can't establish sqlite3 connection");
 
+    db_utils::upgrade_datafiles (dbcon);
+
     // dc stations have to be initially imported because for 3.5 years only
     // station addresses were given with no IDs. The stations table is needed in
     // these cases to extract the right IDs.
@@ -90,8 +128,7 @@ int rcpp_import_to_trip_table (const char* bikedb,
     // A stn_map is now also needed for Boston, because they've changed to
     // annual dumps for pre-2015, yet some trip files have only names and not
     // the station IDs in the station files now provided.
-    std::map <std::string, std::string> stn_map;
-    stn_map.clear ();
+    StringMap <std::string> stn_map;
     if (city == "dc")
     {
         stn_map = stns::get_dc_stn_table (dbcon);
@@ -100,307 +137,1433 @@ int rcpp_import_to_trip_table (const char* bikedb,
         stn_map = stns::get_bo_stn_table (dbcon);
     }
 
-    FILE * pFile;
-    char in_line [BUFFER_SIZE] = "\0";
-    char sqlqry [BUFFER_SIZE] = "\0";
+    // R objects may only be accessed from this thread. Files are grouped by
+    // name, in order of first appearance, and names already in the datafiles
+    // table are skipped.
+    std::vector <DataFile> groups;
+    std::vector <std::vector <std::string> > group_files;
+    std::map <std::string, size_t> group_index;
+    for (int i = 0; i < datafiles.size (); i++)
+    {
+        const std::string name = Rcpp::as <std::string> (datafile_names [i]);
+        auto g = group_index.find (name);
+        if (g == group_index.end ())
+        {
+            g = group_index.emplace (name, groups.size ()).first;
+            groups.emplace_back ();
+            groups.back ().name = name;
+            group_files.emplace_back ();
+        }
+        group_files [g->second].push_back (
+                Rcpp::as <std::string> (datafiles [i]));
+    }
+    std::vector <std::string> filenames;
+    std::vector <size_t> file_group;
+    for (size_t g = 0; g < groups.size (); g++)
+    {
+        if (db_add::has_datafile (dbcon, city, groups [g].name))
+            continue;
+        for (auto f: group_files [g])
+        {
+            filenames.push_back (f);
+            file_group.push_back (g);
+        }
+    }
+    const size_t nfiles = filenames.size ();
+
+    // Numbers of lines and of trips of each file are always counted, but
+    // times are only recorded when profiling.
+    IngestProfile prof;
+    prof.files.resize (nfiles);
+    auto secs = [&] (stage::Stage s) {
+        return profile ? &prof.secs [s] : nullptr;
+    };
 
-    sqlite3_stmt * stmt;
-    std::map <std::string, std::string> stationqry;
+    // Files are split into chunks of complete lines in this thread. Large
+    // files are only split when reading in parallel, or in bulk mode, unless
+    // a chunk_size is given.
+    int64_t split_size = 0;
+    if (chunk_size > 0)
+        split_size = static_cast <int64_t> (chunk_size);
+    else if (nthreads > 1 || bulk)
+        split_size = CHUNK_SIZE;
+    std::vector <FileChunk> chunks;
+    std::vector <ContentHash> header_hash (nfiles);
+    std::vector <int64_t> file_size (nfiles);
+    {
+        StageTimer timer (secs (stage::plan));
+        for (size_t filenum = 0; filenum < nfiles; filenum++)
+        {
+            std::vector <FileChunk> fchunks = db_add::plan_trip_file (
+                    filenames [filenum], filenum, city, header_file_name,
+                    data_has_stations, split_size, header_hash [filenum]);
+            file_size [filenum] = fchunks.back ().end;
+            prof.files [filenum].bytes = file_size [filenum];
+            chunks.insert (chunks.end (), fchunks.begin (), fchunks.end ());
+        }
+    }
+
+    TripInsert ins;
+    std::map <std::string, StationRow> stations;
+    std::unordered_set <std::string> stations_added;
 
     int ntrips = 0; // ntrips is added in this call
 
-    snprintf(sqlqry, BUFFER_SIZE,
-             "INSERT INTO trips VALUES (NOT NULL, @CI, @TD, @ST, @ET, @SSID, @ESID, @BID, @UT, @BY, @GE)");
+    const bool compact = db_utils::is_compact (dbcon);
+    const bool partitioned = !compact && parts::is_partitioned (dbcon);
+    CompactKeys keys;
+    TripParts tparts;
+    if (compact)
+    {
+        db_add::get_compact_keys (dbcon, city, keys);
+        db_add::prepare_trip_insert (dbcon, "trips_compact", ins);
+    } else if (partitioned)
+        db_add::prepare_trip_parts (dbcon, city, bulk, tparts);
+    else
+        db_add::prepare_trip_insert (dbcon, "trips", ins);
+    TripCube cube;
+    db_add::prepare_trip_cube (dbcon, compact, cube);
+    TripStats stats;
+    db_add::prepare_trip_stats (dbcon, stats);
+    std::unique_ptr <colstore::ColumnWriter> columns;
+    if (colstore::has_store (dbcon))
+        columns.reset (new colstore::ColumnWriter (dbcon,
+                    colstore::dir_name (dbcon), city));
 
-    sqlite3_prepare_v2(dbcon, sqlqry, BUFFER_SIZE, &stmt, nullptr);
+    // Updating indexes with each insertion is much slower than rebuilding them
+    // once all data have been loaded.
+    db_utils::Indexes indexes;
+    if (bulk)
+    {
+        std::vector <std::string> tables;
+        if (partitioned)
+        {
+            for (auto &pii: tparts.parts)
+                tables.push_back (pii.second.tp.table);
+        } else
+            tables.push_back (compact ? "trips_compact" : "trips");
+        for (auto t: tables)
+        {
+            db_utils::Indexes idx = db_utils::get_indexes (dbcon, t);
+            indexes.insert (indexes.end (), idx.begin (), idx.end ());
+        }
+        for (auto idx: indexes)
+        {
+            std::string qry = "DROP INDEX " + idx.first;
+            sqlite3_exec (dbcon, qry.c_str (), nullptr, nullptr, nullptr);
+        }
+    }
+    auto rebuild_indexes = [&] (bool report) {
+        StageTimer timer (secs (stage::indexes));
+        for (auto idx: indexes)
+        {
+            double t = db_utils::create_index (dbcon, idx.second);
+            if (report)
+                Rcpp::Rcout << "rebuilt index " << idx.first << " in " <<
+                    t << "s" << std::endl;
+        }
+        // tables of partitions added while loading
+        db_add::index_trip_parts (dbcon, tparts);
+    };
 
-    sqlite3_exec(dbcon, "BEGIN TRANSACTION", nullptr, nullptr, &zErrMsg);
-    sqlite3_free (zErrMsg);
+    // Databases with write-ahead logs remain readable by other connections
+    // while data are added, and are checkpointed after commits here (see
+    // checkpoint_wal) rather than automatically.
+    const bool has_wal = db_utils::is_wal (dbcon);
+    WalLog wal;
+    if (has_wal)
+        db_add::start_wal (dbcon, wal);
 
-    for(int filenum = 0; filenum < datafiles.length(); filenum++) 
+    // Bulk loading does not sync writes to disk, which remains safe if R
+    // crashes, but not if the operating system does. journal_mode can only be
+    // changed outside of transactions, and is retained for databases with
+    // write-ahead logs.
+    db_utils::Pragmas old_pragmas;
+    if (bulk)
     {
-        Rcpp::checkUserInterrupt ();
-        if (!quiet)
-            Rcpp::Rcout << "reading file " << filenum + 1 << "/" <<
-                datafiles.size() << ": " <<
-                datafiles [filenum] << std::endl;
+        db_utils::Pragmas pragmas = {
+                {"synchronous", "OFF"},
+                {"cache_size", "-65536"}, // KiB
+                {"temp_store", "MEMORY"}};
+        if (!has_wal)
+            pragmas.insert (pragmas.begin (), {"journal_mode", "TRUNCATE"});
+        old_pragmas = db_utils::set_pragmas (dbcon, pragmas);
+    }
 
-        std::string filename_i = Rcpp::as <std::string> (datafiles [filenum]);
-        HeaderStruct headers = db_add::get_field_positions (filename_i,
-                header_file_name, data_has_stations, city);
+    sqlite3_exec(dbcon, "BEGIN TRANSACTION", nullptr, nullptr, &zErrMsg);
+    sqlite3_free (zErrMsg);
 
-        pFile = fopen (datafiles [filenum], "r");
-        char * junk = fgets (in_line, BUFFER_SIZE, pFile);
-        (void) junk; // suppress unused variable warning
-        utils::rm_dos_end (in_line);
+    const size_t nchunks = chunks.size ();
 
-        // One London file ("21JourneyDataExtract31Aug2016-06Sep2016.csv") has
-        // "Start/EndStation Logical Terminal" numbers instead of IDs.  These
-        // don't map on to any known station numbers and so can't be used.
-        if (city == "lo")
+    auto parse_one = [&] (size_t i) {
+        return db_add::read_trip_chunk (chunks [i], city, stn_map, profile);
+    };
+    auto write_one = [&] (size_t i, TripBatch &batch) {
+        const size_t filenum = chunks [i].filenum;
+        DataFile &group = groups [file_group [filenum]];
+        if (i == 0 || chunks [i - 1].filenum != filenum)
         {
-            std::string in_line2 = in_line;
-            if (in_line2.find ("Logical Terminal") != std::string::npos)
-                continue; // skip rest of that loop
+            if (!quiet)
+                Rcpp::Rcout << "reading file " << filenum + 1 << "/" <<
+                    nfiles << ": " << filenames [filenum] << std::endl;
+            group.size += file_size [filenum];
+            group.hash.append (header_hash [filenum]);
         }
-
-        bool get_structure = true;
-        while (fgets (in_line, BUFFER_SIZE, pFile) != nullptr) 
+        prof.add_batch (filenum, batch);
         {
-            if (get_structure)
-            {
-                db_add::get_field_quotes (in_line, headers);
-                // see issue#78 - from April 2018 "member_birth_year" is quoted
-                // when empty but unquoted when not, requiring structures to be
-                // re-read for every line.
-                if (city != "sf")
-                    get_structure = false;
-                //db_add::dump_headers (headers);
-            }
+            StageTimer timer (secs (stage::insert));
+            if (compact)
+                ntrips += db_add::insert_trip_batch_compact (ins, keys,
+                        batch);
+            else if (partitioned)
+                ntrips += db_add::insert_trip_parts (dbcon, tparts, city,
+                        batch);
+            else
+                ntrips += db_add::insert_trip_batch (ins, city, batch);
+        }
+        if (cube.stmt)
+        {
+            StageTimer timer (secs (stage::trip_counts));
+            db_add::count_trip_batch (cube, batch, compact ? &keys : nullptr);
+            db_add::flush_trip_cube (cube, city, compact ? &keys : nullptr);
+        }
+        if (stats.city_stmt)
+        {
+            StageTimer timer (secs (stage::trip_counts));
+            db_add::count_trip_stats (stats, batch, compact);
+            db_add::flush_trip_stats (stats, city, compact);
+        }
+        if (columns)
+        {
+            StageTimer timer (secs (stage::columns));
+            columns->add_batch (batch);
+        }
+        group.nrows += static_cast <int64_t> (batch.nrows);
+        group.hash.append (batch.hash);
+        // Stations are merged in file order, so the first entry for each
+        // station is retained exactly as for serial reading.
+        for (size_t s = 0; s < batch.stations.size (); s++)
+            stations.emplace (batch.stations.key (s),
+                    batch.stations.value (s));
 
-            utils::rm_dos_end (in_line);
-            sqlite3_bind_text (stmt, 1, city.c_str (), -1, SQLITE_TRANSIENT); 
+        // Groups are committed whole, in bulk mode too, so interrupted loads
+        // never leave a partly-stored file.
+        if (i < nchunks - 1 &&
+                file_group [chunks [i + 1].filenum] == file_group [filenum])
+            return;
 
-            // London, LA, and Philly data are ballsed up and change format
-            // within data files, so they are read with their own std::string
-            // routines, rather than then generic char * routine.
-            if (city == "lo")
-                rc = city::read_one_line_london (stmt, in_line);
-            else if (city == "la" || city == "ph")
-                rc = city::read_one_line_nabsa (stmt, in_line, &stationqry, city);
-            else 
-                rc = city::read_one_line_generic (stmt, in_line, &stationqry, city,
-                        headers, stn_map);
-            if (rc == 0) // only != 0 for LA, London, Boston, and MN
+        // Last chunk of group, for which stations not added by previous groups
+        // are added along with any columns, and the entry in the datafiles
+        // table.
+        if (city == "ny" || city == "la" || city == "ph" || city == "sf")
+        {
+            StageTimer timer (secs (stage::stations));
+            std::map <std::string, StationRow> new_stations;
+            for (auto &s: stations)
+                if (stations_added.insert (s.first).second)
+                    new_stations.emplace (s.first, s.second);
+            if (!new_stations.empty ())
+                stns::import_to_station_table (dbcon, city, new_stations);
+        }
+        stations.clear ();
+        {
+            StageTimer timer (secs (stage::commit));
+            if (columns)
+                columns->commit ();
+            if (partitioned)
+                db_add::commit_trip_parts (dbcon, tparts);
+            db_add::insert_datafile (dbcon, city, group);
+            if (sqlite3_exec (dbcon, "COMMIT", nullptr, nullptr,
+                        nullptr) != SQLITE_OK)
+                throw std::runtime_error ("Unable to commit " + group.name);
+        }
+        if (has_wal)
+            db_add::checkpoint_wal (dbcon, wal, false);
+        if (sqlite3_exec (dbcon, "BEGIN TRANSACTION", nullptr, nullptr,
+                    nullptr) != SQLITE_OK)
+            throw std::runtime_error ("Unable to begin transaction");
+    };
+
+    // Chunks are parsed in the pool of threads if nthreads > 1, otherwise
+    // serially here.
+    std::unique_ptr <ParsePool> pool;
+    if (nthreads > 1 && nchunks > 1)
+        pool.reset (new ParsePool (nchunks, static_cast <size_t> (nthreads),
+                    parse_one));
+    try
+    {
+        for (size_t i = 0; i < nchunks; i++)
+        {
+            Rcpp::checkUserInterrupt ();
+            // all time spent on each file by this thread
+            StageTimer file_timer (profile ?
+                    &prof.files [chunks [i].filenum].secs : nullptr);
+            TripBatch batch;
+            if (pool)
             {
-                ntrips++;
-                sqlite3_step (stmt);
-            }
-            sqlite3_reset (stmt);
+                StageTimer timer (secs (stage::wait));
+                batch = pool->next_batch (i);
+            } else
+                batch = parse_one (i);
+            write_one (i, batch);
         }
+    } catch (...)
+    {
+        // Only the group currently being read is rolled back
+        if (pool)
+            pool->stop ();
+        db_add::finalize_trip_insert (ins);
+        db_add::finalize_trip_parts (tparts);
+        sqlite3_finalize (keys.stmt);
+        sqlite3_finalize (cube.stmt);
+        db_add::finalize_trip_stats (stats);
+        sqlite3_exec (dbcon, "ROLLBACK", nullptr, nullptr, nullptr);
+        try
+        {
+            rebuild_indexes (false);
+        } catch (...) { }
+        sqlite3_close_v2 (dbcon);
+        throw;
     }
-    sqlite3_finalize(stmt);
+    db_add::finalize_trip_insert (ins);
+    db_add::finalize_trip_parts (tparts);
+    sqlite3_finalize (keys.stmt);
+    sqlite3_finalize (cube.stmt);
+    db_add::finalize_trip_stats (stats);
 
     sqlite3_exec(dbcon, "END TRANSACTION", nullptr, nullptr, &zErrMsg);
     sqlite3_free (zErrMsg);
 
-    if (city == "ny" || city == "la" || city == "ph" || city == "sf")
-        stns::import_to_station_table (dbcon, stationqry);
+    if (bulk)
+    {
+        rebuild_indexes (!quiet);
+        db_utils::set_pragmas (dbcon, old_pragmas);
+    }
+
+    if (has_wal)
+    {
+        db_add::checkpoint_wal (dbcon, wal, true);
+        prof.secs [stage::checkpoint] = wal.secs;
+        if (!quiet)
+            Rcpp::Rcout << "copied " << wal.copied << " pages of the " <<
+                "write-ahead log to the database in " << wal.checkpoints <<
+                " checkpoints taking " << wal.secs << "s" << std::endl;
+    }
 
     rc = static_cast <size_t> (sqlite3_close_v2 (dbcon));
     if (rc != SQLITE_OK)
         throw std::runtime_error ("Unable to close sqlite database");
 
-    return ntrips;
-}
+    Rcpp::IntegerVector res = Rcpp::IntegerVector::create (ntrips);
+    if (profile)
+        res.attr ("profile") = db_add::profile_list (prof, filenames);
 
+    return res;
+}
 
-//' rcpp_import_to_file_table
+//' plan_trip_file
 //'
-//' Creates and/or updates the table of datafile names in the database
-//' 
-//' @param bikedb A string containing the path to the Sqlite3 database to 
-//'        use. 
-//' @param datafiles List of names of files to be added - must be names of
-//'        compressed \code{.zip} archives, not expanded \code{.csv} files
-//' @param city Name of city associated with datafile
+//' Read the header and first line of one data file to establish its structure,
+//' and divide the remainder into chunks of complete lines. Chunk boundaries are
+//' placed at the start of the first line beginning at or after each multiple
+//' of chunk_size, so every line - of any length - belongs to exactly one chunk.
 //'
-//' @return Number of datafile names added to database table
+//' @param filename Full path to the data file
+//' @param filenum Index of file in list of all files to be read
+//' @param chunk_size Size in bytes of chunks, or 0 to return the whole file as
+//'        a single chunk
+//' @param header_hash On return, the ContentHash of the header line, or of
+//'        the whole file if it can not be read
+//'
+//' @return Vector of chunks in file order
 //'
 //' @noRd
-// [[Rcpp::export]]
-int rcpp_import_to_file_table (const char * bikedb,
-        Rcpp::CharacterVector datafiles, std::string city, int nfiles)
+std::vector <FileChunk> db_add::plan_trip_file (const std::string &filename,
+        size_t filenum, const std::string &city,
+        const std::string &header_file_name, bool data_has_stations,
+        int64_t chunk_size, ContentHash &header_hash)
 {
-    sqlite3 *dbcon;
-    char *zErrMsg = nullptr;
-    int rc;
+    FileChunk chunk;
+    chunk.filename = filename;
+    chunk.filenum = filenum;
 
-    rc = sqlite3_open_v2(bikedb, &dbcon, SQLITE_OPEN_READWRITE, nullptr);
-    if (rc != SQLITE_OK)
-        throw std::runtime_error ("Can't establish sqlite3 connection");
+    LineReader reader (filename, 0, -1);
+    std::string_view line;
+    header_hash = ContentHash ();
+    if (reader.next_line (line)) // header
+        header_hash.add_line (line);
+    chunk.headers = db_add::get_field_positions (line, header_file_name,
+            data_has_stations, city);
+    chunk.begin = reader.offset ();
 
-    for (auto i : datafiles)
+    std::vector <FileChunk> chunks;
+
+    // One London file ("21JourneyDataExtract31Aug2016-06Sep2016.csv") has
+    // "Start/EndStation Logical Terminal" numbers instead of IDs.  These
+    // don't map on to any known station numbers and so can't be used.
+    if (city == "lo" && line.find ("Logical Terminal") != std::string::npos)
     {
-        std::string datafile_qry = "INSERT INTO datafiles "
-                                   "(id, city, name) VALUES (";
-        datafile_qry += std::to_string (nfiles) + ",\"" + city + "\",\"" + 
-            i + "\");";
-
-        const char *sql = datafile_qry.c_str ();
-        rc = sqlite3_exec(dbcon, sql, nullptr, nullptr, &zErrMsg);
-        sqlite3_free (zErrMsg);
-        //rc = sqlite3_exec(dbcon, datafile_qry.c_str(), nullptr, nullptr, &zErrMsg);
-        if (rc == 0)
-            nfiles++;
+        while (reader.next_line (line))
+            header_hash.add_line (line);
+        chunk.end = chunk.begin;
+        chunks.push_back (chunk);
+        return chunks;
     }
 
-    rc = sqlite3_close_v2(dbcon);
-    //rc = sqlite3_close(dbcon);
-    if (rc != SQLITE_OK)
-        throw std::runtime_error ("Unable to close sqlite database");
-    sqlite3_free (zErrMsg);
+    // Quoting structure is taken from the first line of data. For sf this is
+    // re-read for every line (see read_trip_chunk).
+    if (reader.next_line (line))
+        db_add::get_field_quotes (line, chunk.headers);
+
+    const int64_t file_size = reader.end_offset ();
+    int64_t target = chunk.begin + chunk_size;
+    while (chunk_size > 0 && target < file_size)
+    {
+        // The boundary is the end of the line which includes "target - 1",
+        // searched for in a window which is widened until it holds that line.
+        int64_t boundary = file_size;
+        for (int64_t window = BOUNDARY_WINDOW; ; window *= 2)
+        {
+            const int64_t end = std::min (target - 1 + window, file_size);
+            LineReader scan (filename, target - 1, end);
+            if (scan.next_line (line) &&
+                    (line.back () == '\n' || end == file_size))
+            {
+                boundary = scan.offset ();
+                break;
+            }
+        }
+        if (boundary >= file_size)
+            break;
+        chunk.end = boundary;
+        chunks.push_back (chunk);
+        chunk.begin = chunk.end;
+        target = chunk.begin + chunk_size;
+    }
+
+    chunk.end = file_size;
+    chunks.push_back (chunk);
 
-    return nfiles;
+    return chunks;
 }
 
-//' Examine the header line of the data file to map the records on to the
-//' corresponding columns in the database. The database has the following fields
-//' and column numbers:
-//'    | number | field                   |
-//'    | ----   | ----------------------- |
-//'    | 0      | duration                |
-//'    | 1      | start_time              |
-//'    | 2      | end_time                |
-//'    | 3      | start_station_id        |
-//'    | 4      | start_station_name      |
-//'    | 5      | start_station_latitude  |
-//'    | 6      | start_station_longitude |
-//'    | 7      | end_station_id          |
-//'    | 8      | end_station_name        |
-//'    | 9      | end_station_latitude    |
-//'    | 10     | end_station_longitude   |
-//'    | 11     | bike_id                 |
-//'    | 12     | user_type               |
-//'    | 13     | birth_year              |
-//'    | 14     | gender                  |
-//' The HeaderStruct has vectors for "position" and "quoted". Each of these has
-//' the same length as the number of entries in the actual file (not necessarily
-//' equal to "num_db_fields = 15"), with "position" mapping each entry on to its
-//' corresponding position in the database, and using -1 to denote no
-//' corresponding field.
+//' read_trip_chunk
+//'
+//' Read all trips from one chunk of a data file into a TripBatch. This does not
+//' touch either the database or any R objects, and so may be called from parser
+//' threads.
+//'
+//' @param chunk FileChunk returned from plan_trip_file
+//' @param stn_map Only used for cities which don't have proper station ID
+//' codes, so that names can be mapped to these (currently just BO & DC).
+//' @param profile If true, times of reading lines, parsing them, and
+//'        converting date-times are recorded in the "secs" of the batch.
+//'
 //' @noRd
-HeaderStruct db_add::get_field_positions (const std::string fname,
-        const std::string header_file_name, bool data_has_stations,
-        const std::string city)
+TripBatch db_add::read_trip_chunk (const FileChunk &chunk,
+        const std::string &city,
+        const StringMap <std::string> &stn_map, bool profile)
 {
-    std::ifstream in_file;
-    // load file header variants - this file is very small, so no real loss
-    // doing this repeatedly here. Note that this is where the R 1-indexed
-    // positions are re-mapped to 0-indexed C++ versions.
-    in_file.open (header_file_name.c_str (), std::ios_base::in);
-    // field_name_map is int coz it's from headers.position_file2db which uses
-    // -1 to flag no position
-    std::unordered_map <std::string, int> field_name_map;
-    std::string line;
-    getline (in_file, line, '\n'); // header
-
-    while (getline (in_file, line, '\n'))
+    TripBatch batch;
+    if (chunk.end <= chunk.begin)
+        return batch;
+
+    LineReader reader (chunk.filename, chunk.begin, chunk.end);
+    std::string_view line;
+    // The London and NABSA parsers tokenise lines in place, so lines for
+    // those are copied into this buffer, which is only re-allocated for lines
+    // longer than any previous one.
+    std::string line_buf;
+    LineScratch scratch;
+    scratch.datetime_format.day_first = (city == "lo");
+    double * read_secs = nullptr, * parse_secs = nullptr;
+    if (profile)
     {
-        size_t ipos = line.find (",");
-        //std::string f1 = line.substr (0, ipos); // generic name: not used
-        line = line.substr (ipos + 1, line.length () - ipos - 1);
-        ipos = line.find (",");
-        std::string f2 = line.substr (0, ipos);
-        line = line.substr (ipos + 1, line.length () - ipos - 1);
-        ipos = line.find (",");
-        int indx = atoi (line.substr (0, ipos).c_str ());
-        line = line.substr (ipos + 1, line.length () - ipos - 1);
-        // line is then the city
-        if (line.find ("all") != std::string::npos ||
-                line.find (city) != std::string::npos)
-            field_name_map.emplace (f2, indx - 1);
+        read_secs = &batch.secs [stage::read];
+        parse_secs = &batch.secs [stage::parse];
+        scratch.datetime_secs = &batch.secs [stage::datetime];
     }
-    in_file.close ();
-
-    in_file.open (fname.c_str(), std::ios_base::in);
-    getline (in_file, line, '\n');
-    // remove all quotes, whitespace, underscores, and convert to lower:
-    boost::replace_all (line, "\"", "");
-    boost::replace_all (line, " ", "");
-    boost::replace_all (line, "_", "");
-    boost::replace_all (line, ".", ""); // csv test files replace " " with "."
-    boost::replace_all (line, "\n","");
-    boost::replace_all (line, "\r","");
-    // Note that this only works because all systems to date are from the
-    // English-speaking world; see
-    // https://stackoverflow.com/questions/313970/how-to-convert-stdstring-to-lower-case
-    std::transform (line.begin (), line.end (), line.begin (), ::tolower);
-    // Alternative
-    /*
-    std::locale loc;
-    for (std::string::size_type i = 0; i < line.length (); i++)
-        line [i] = std::tolower (line [i], loc);
-    */
-    unsigned int len = static_cast <unsigned int> (
-            std::count (line.begin (), line.end (), ','));
-    
-    HeaderStruct headers;
-    headers.data_has_stations = data_has_stations;
-    headers.position_file2db.resize (len + 1); // one more fields than commas
-    std::fill (headers.position_file2db.begin (), headers.position_file2db.end (), -1);
-
-    for (unsigned int i = 0; i < len; i++)
+    HeaderStruct headers = chunk.headers;
+    city::GenericParser read_one_line = city::select_generic_parser (headers);
+    TripRow row;
+    while (true)
     {
-        size_t ipos = static_cast <size_t> (line.find (","));
-        std::string field = line.substr (0, ipos);
-        if (field_name_map.find (field) != field_name_map.end ())
-            headers.position_file2db [i] = field_name_map.at (field);
-        line = line.substr (ipos + 1, line.length () - ipos - 1);
+        {
+            // Pages of mapped files are only read when lines are hashed
+            StageTimer timer (read_secs);
+            if (!reader.next_line (line))
+                break;
+            batch.hash.add_line (line);
+        }
+        StageTimer timer (parse_secs);
+
+        // see issue#78 - from April 2018 "member_birth_year" is quoted
+        // when empty but unquoted when not, requiring structures to be
+        // re-read for every line.
+        if (city == "sf")
+        {
+            utils::index_line (line, scratch.index);
+            db_add::get_field_quotes (line, scratch.index, headers);
+            read_one_line = city::select_generic_parser (headers);
+        }
+
+        // remove dos line ending
+        if (line.size () > 1 && line.substr (line.size () - 2) == "\r\n")
+            line.remove_suffix (2);
+        row.clear ();
+
+        // London, LA, and Philly data are ballsed up and change format
+        // within data files, so they are read with their own std::string
+        // routines, rather than then generic routine.
+        unsigned int res;
+        if (city == "lo" || city == "la" || city == "ph")
+        {
+            line_buf.assign (line.data (), line.size ());
+            if (city == "lo")
+                res = city::read_one_line_london (row, &line_buf [0],
+                        scratch);
+            else
+                res = city::read_one_line_nabsa (row, &line_buf [0],
+                        &batch.stations, city, scratch);
+        } else 
+            res = read_one_line (row, line, &batch.stations, city, headers,
+                    stn_map, scratch);
+        if (res == reject::none) // only != 0 for LA, London, Boston, and MN
+            batch.push_back (row);
+        else
+            batch.rejected [res]++;
     }
-    if (field_name_map.find (line) != field_name_map.end ())
+    // parse times include those of converting date-times
+    batch.secs [stage::parse] -= batch.secs [stage::datetime];
+
+    return batch;
+}
+
+//' prepare_trip_insert
+//'
+//' Prepare statements inserting trips into the nominated table, one of which
+//' inserts up to INSERT_ROWS trips with each step. Calendar columns are only
+//' inserted into tables which have them.
+//'
+//' @noRd
+void db_add::prepare_trip_insert (sqlite3 * dbcon, const std::string &table,
+        TripInsert &ins)
+{
+    ins.calendar = db_utils::has_calendar (dbcon);
+    ins.nparams = static_cast <int> (num_trip_fields) + 1 +
+        (ins.calendar ? static_cast <int> (num_calendar_fields) : 0);
+    ins.rows = std::min (static_cast <size_t> (INSERT_ROWS),
+            static_cast <size_t> (MAX_PARAMS / ins.nparams));
+
+    std::string row = "(NULL";
+    for (int i = 0; i < ins.nparams; i++)
+        row += ", ?";
+    row += ")";
+    std::string qry = "INSERT INTO " + table + " VALUES " + row;
+    sqlite3_prepare_v2 (dbcon, qry.c_str (), -1, &ins.single, nullptr);
+    for (size_t i = 1; i < ins.rows; i++)
+        qry += ", " + row;
+    sqlite3_prepare_v2 (dbcon, qry.c_str (), -1, &ins.multi, nullptr);
+}
+
+void db_add::finalize_trip_insert (TripInsert &ins)
+{
+    sqlite3_finalize (ins.multi);
+    sqlite3_finalize (ins.single);
+    ins.multi = ins.single = nullptr;
+}
+
+// Insert all trips of a batch, ins.rows at a time, and any remainder one at
+// a time. bind_row (stmt, col, i, pos) binds the trip in row i, the text of
+// which starts at pos, to the parameters following col, and returns the
+// position of the text of the next row.
+template <typename BindRow>
+static void insert_rows (TripInsert &ins, const TripBatch &batch,
+        BindRow bind_row)
+{
+    size_t i = 0, pos = 0;
+    while (i < batch.nrows)
     {
-        headers.position_file2db [len] = field_name_map.at (line);
+        const size_t n = (batch.nrows - i >= ins.rows) ? ins.rows : 1;
+        sqlite3_stmt * stmt = (n > 1) ? ins.multi : ins.single;
+        for (size_t r = 0; r < n; r++)
+            pos = bind_row (stmt, static_cast <int> (r) * ins.nparams, i++,
+                    pos);
+        const int rc = sqlite3_step (stmt);
+        sqlite3_reset (stmt);
+        if (rc != SQLITE_DONE)
+            throw std::runtime_error ("Unable to insert trips into database");
     }
+    sqlite3_clear_bindings (ins.multi);
+    sqlite3_clear_bindings (ins.single);
+}
+
+//' insert_trip_batch
+//'
+//' Insert all trips from one TripBatch into the trips table. Fields are bound
+//' as static text because each one is re-bound before the next step.
+//'
+//' @param ins Prepared "INSERT INTO trips" statements
+//'
+//' @return Number of trips inserted
+//'
+//' @noRd
+int db_add::insert_trip_batch (TripInsert &ins, const std::string &city,
+        const TripBatch &batch)
+{
+    const char * txt = batch.text.c_str ();
+    insert_rows (ins, batch, [&] (sqlite3_stmt * stmt, int col0, size_t i,
+                size_t pos) {
+        sqlite3_bind_text (stmt, col0 + 1, city.c_str (), -1, SQLITE_STATIC);
+        bool has_time [2] = {false, false};
+        int64_t t [2] = {0, 0};
+        for (size_t j = 0; j < num_trip_fields; j++)
+        {
+            const int len = batch.lens [i * num_trip_fields + j];
+            const int col = col0 + static_cast <int> (j) + 2;
+            if (len < 0)
+                sqlite3_bind_null (stmt, col);
+            else
+            {
+                sqlite3_bind_text (stmt, col, txt + pos, len, SQLITE_STATIC);
+                if (ins.calendar &&
+                        (j == trip::start_time || j == trip::stop_time))
+                {
+                    const size_t k = (j == trip::start_time) ? 0 : 1;
+                    has_time [k] = utils::parse_datetime_fixed (
+                            std::string_view (txt + pos,
+                                static_cast <size_t> (len)), t [k]);
+                }
+                pos += static_cast <size_t> (len);
+            }
+        }
+        if (ins.calendar)
+            db_utils::bind_calendar (stmt, col0 + static_cast <int> (
+                        num_trip_fields) + 2, has_time [0], t [0],
+                    has_time [1], t [1]);
+        return pos;
+    });
+
+    return static_cast <int> (batch.nrows);
+}
 
-    headers.nvalues = len + 1;
+//' get_compact_keys
+//'
+//' Get the integer code of a city, adding it to the "cities" table if needed,
+//' and the integer keys of all stations of that city, for insertion into
+//' databases with the compact schema. Keys are the "id" values of the stations
+//' table, and stations which are not yet in that table are added as they are
+//' first encountered, initially with only city and station ID. Their names and
+//' locations are filled in when station data are subsequently read.
+//'
+//' @noRd
+void db_add::get_compact_keys (sqlite3 * dbcon, const std::string &city,
+        CompactKeys &keys)
+{
+    sqlite3_stmt * stmt;
+    sqlite3_prepare_v2 (dbcon, "INSERT OR IGNORE INTO cities (city) VALUES (?)",
+            -1, &stmt, nullptr);
+    sqlite3_bind_text (stmt, 1, city.c_str (), -1, SQLITE_TRANSIENT);
+    sqlite3_step (stmt);
+    sqlite3_finalize (stmt);
+
+    sqlite3_prepare_v2 (dbcon, "SELECT id FROM cities WHERE city = ?",
+            -1, &stmt, nullptr);
+    sqlite3_bind_text (stmt, 1, city.c_str (), -1, SQLITE_TRANSIENT);
+    if (sqlite3_step (stmt) == SQLITE_ROW)
+        keys.city = sqlite3_column_int (stmt, 0);
+    sqlite3_finalize (stmt);
 
-    return headers;
+    // Some stations (such as in Boston) have several entries with different
+    // names, for which the first is used.
+    keys.stations.clear ();
+    sqlite3_prepare_v2 (dbcon,
+            "SELECT id, stn_id FROM stations WHERE city = ? ORDER BY id",
+            -1, &stmt, nullptr);
+    sqlite3_bind_text (stmt, 1, city.c_str (), -1, SQLITE_TRANSIENT);
+    while (sqlite3_step (stmt) == SQLITE_ROW)
+    {
+        const unsigned char * stn_id = sqlite3_column_text (stmt, 1);
+        if (stn_id != nullptr)
+            keys.stations.emplace (reinterpret_cast <const char *> (stn_id),
+                    sqlite3_column_int (stmt, 0));
+    }
+    sqlite3_finalize (stmt);
+
+    sqlite3_prepare_v2 (dbcon,
+            "INSERT INTO stations (city, stn_id) VALUES (?, ?)",
+            -1, &keys.stmt, nullptr);
+    sqlite3_bind_text (keys.stmt, 1, city.c_str (), -1, SQLITE_TRANSIENT);
 }
 
-//' get_field_quotes
+//' station_key
+//'
+//' @return Integer key of station, added to the stations table if not yet
+//' present.
 //'
-//' The quotation structure of the header line does not always reflect the
-//' actual structure of the data, so the patterns of quotations are determined by
-//' the first data line rather than in "get_field_positions".
 //' @noRd
-void db_add::get_field_quotes (const std::string line, HeaderStruct &headers)
+int db_add::station_key (CompactKeys &keys, std::string_view stn_id)
 {
-    std::string l = line;
-    headers.quoted.resize (headers.position_file2db.size ());
-    for (unsigned int i = 0; i < (headers.nvalues - 1); i++)
+    keys.buf.assign (stn_id.data (), stn_id.size ());
+    auto it = keys.stations.find (keys.buf);
+    if (it != keys.stations.end ())
+        return it->second;
+
+    sqlite3_bind_text (keys.stmt, 2, keys.buf.c_str (), -1, SQLITE_TRANSIENT);
+    if (sqlite3_step (keys.stmt) != SQLITE_DONE)
     {
-        if (l.find ("\"") < l.find (","))
-            headers.quoted [i] = true;
+        sqlite3_reset (keys.stmt);
+        throw std::runtime_error ("Unable to insert station " + keys.buf);
+    }
+    sqlite3_reset (keys.stmt);
+    const int key = static_cast <int> (
+            sqlite3_last_insert_rowid (sqlite3_db_handle (keys.stmt)));
+    keys.stations.emplace (keys.buf, key);
+
+    return key;
+}
+
+//' insert_trip_batch_compact
+//'
+//' Insert all trips from one TripBatch into the trips_compact table, converting
+//' each field to the corresponding integer code.
+//'
+//' @param ins Prepared "INSERT INTO trips_compact" statements
+//'
+//' @return Number of trips inserted
+//'
+//' @noRd
+int db_add::insert_trip_batch_compact (TripInsert &ins, CompactKeys &keys,
+        const TripBatch &batch)
+{
+    const char * txt = batch.text.c_str ();
+    insert_rows (ins, batch, [&] (sqlite3_stmt * stmt, int col0, size_t i,
+                size_t pos) {
+        sqlite3_bind_int (stmt, col0 + 1, keys.city);
+        bool has_time [2] = {false, false};
+        int64_t t [2] = {0, 0};
+        for (size_t j = 0; j < num_trip_fields; j++)
+        {
+            const int len = batch.lens [i * num_trip_fields + j];
+            const int col = col0 + static_cast <int> (j) + 2;
+            if (len < 0)
+            {
+                sqlite3_bind_null (stmt, col);
+                continue;
+            }
+            std::string_view val (txt + pos, static_cast <size_t> (len));
+            pos += static_cast <size_t> (len);
+
+            switch (j)
+            {
+                case trip::start_time:
+                case trip::stop_time:
+                {
+                    const size_t k = (j == trip::start_time) ? 0 : 1;
+                    has_time [k] = utils::parse_datetime_fixed (val, t [k]);
+                    if (has_time [k])
+                        sqlite3_bind_int64 (stmt, col, t [k]);
+                    else
+                        sqlite3_bind_null (stmt, col);
+                    break;
+                }
+                case trip::start_station_id:
+                case trip::end_station_id:
+                    sqlite3_bind_int (stmt, col,
+                            db_add::station_key (keys, val));
+                    break;
+                case trip::bike_id:
+                    sqlite3_bind_text (stmt, col, val.data (),
+                            static_cast <int> (val.size ()), SQLITE_STATIC);
+                    break;
+                default:
+                    db_utils::bind_number (stmt, col, val);
+            }
+        }
+        if (ins.calendar)
+            db_utils::bind_calendar (stmt, col0 + static_cast <int> (
+                        num_trip_fields) + 2, has_time [0], t [0],
+                    has_time [1], t [1]);
+        return pos;
+    });
+
+    return static_cast <int> (batch.nrows);
+}
+
+//' prepare_trip_cube
+//'
+//' Prepare the statement adding counts of trips to the "trip_counts" table.
+//' Databases created before that table was introduced do not have it, and it
+//' is then not maintained.
+//'
+//' @noRd
+void db_add::prepare_trip_cube (sqlite3 * dbcon, bool compact, TripCube &cube)
+{
+    cube.stmt = nullptr;
+    if (!db_utils::has_table (dbcon, "trip_counts"))
+        return;
+
+    const std::string stns = compact ? "start_station, end_station" :
+        "start_station_id, end_station_id";
+    std::string qry = "INSERT INTO trip_counts (city, date, hour, stop_date, "
+        "stop_hour, weekday, user_type, " + stns + ", numtrips) VALUES "
+        "(?, ?, ?, ?, ?, ?, ?, ?, ?, ?) ON CONFLICT (city, date, hour, "
+        "stop_date, stop_hour, user_type, " + stns + ") DO UPDATE SET "
+        "numtrips = numtrips + excluded.numtrips";
+    if (sqlite3_prepare_v2 (dbcon, qry.c_str (), -1, &cube.stmt, nullptr) !=
+            SQLITE_OK)
+        throw std::runtime_error ("Unable to prepare trip_counts statement");
+}
+
+//' count_trip_batch
+//'
+//' Count all trips of one batch into the cells of a TripCube. Date-times which
+//' can not be parsed are counted as NULL, as are the dates and times in SQLite
+//' itself.
+//'
+//' @param keys Only used for databases with the compact schema, for which
+//'        stations are counted by their integer keys; otherwise nullptr.
+//'
+//' @noRd
+void db_add::count_trip_batch (TripCube &cube, const TripBatch &batch,
+        CompactKeys * keys)
+{
+    auto set_time = [] (std::string_view val, int64_t &date, int &hour) {
+        int64_t t;
+        if (!utils::parse_datetime_fixed (val, t))
+            return false;
+        date = utils::epoch_day (t);
+        hour = static_cast <int> ((t - date * 86400) / 3600);
+        return true;
+    };
+    auto set_station = [&keys] (std::string_view val, std::string &stn) {
+        if (keys)
+            stn = std::to_string (db_add::station_key (*keys, val));
         else
-            headers.quoted [i] = false;
+            stn.assign (val.data (), val.size ());
+    };
+
+    const char * txt = batch.text.c_str ();
+    size_t pos = 0;
+    CubeKey key;
+    for (size_t i = 0; i < batch.nrows; i++)
+    {
+        key.date = key.stop_date = 0;
+        key.hour = key.stop_hour = 0;
+        key.user_type.clear ();
+        key.start_station.clear ();
+        key.end_station.clear ();
+        key.nulls = CubeKey::null_start | CubeKey::null_stop |
+            CubeKey::null_user_type | CubeKey::null_start_station |
+            CubeKey::null_end_station;
+        for (size_t j = 0; j < num_trip_fields; j++)
+        {
+            const int len = batch.lens [i * num_trip_fields + j];
+            if (len < 0)
+                continue;
+            std::string_view val (txt + pos, static_cast <size_t> (len));
+            pos += static_cast <size_t> (len);
 
-        size_t ipos;
-        if (headers.quoted [i])
+            switch (j)
+            {
+                case trip::start_time:
+                    if (set_time (val, key.date, key.hour))
+                        key.nulls &= ~CubeKey::null_start;
+                    break;
+                case trip::stop_time:
+                    if (set_time (val, key.stop_date, key.stop_hour))
+                        key.nulls &= ~CubeKey::null_stop;
+                    break;
+                case trip::user_type:
+                    key.user_type.assign (val.data (), val.size ());
+                    key.nulls &= ~CubeKey::null_user_type;
+                    break;
+                case trip::start_station_id:
+                    set_station (val, key.start_station);
+                    key.nulls &= ~CubeKey::null_start_station;
+                    break;
+                case trip::end_station_id:
+                    set_station (val, key.end_station);
+                    key.nulls &= ~CubeKey::null_end_station;
+                    break;
+                default:
+                    break;
+            }
+        }
+        cube.counts [key]++;
+    }
+}
+
+//' flush_trip_cube
+//'
+//' Add all counts of a TripCube to the "trip_counts" table, and clear them.
+//' Values are bound in the same way as the corresponding fields of the trips
+//' table, so the same filters apply to both, except that NULL values are bound
+//' as cube_null or empty strings.
+//'
+//' @param keys Only used for databases with the compact schema, otherwise
+//'        nullptr.
+//'
+//' @noRd
+void db_add::flush_trip_cube (TripCube &cube, const std::string &city,
+        const CompactKeys * keys)
+{
+    sqlite3_stmt * stmt = cube.stmt;
+    for (const auto &c: cube.counts)
+    {
+        const CubeKey &k = c.first;
+        if (keys)
+            sqlite3_bind_int (stmt, 1, keys->city);
+        else
+            sqlite3_bind_text (stmt, 1, city.c_str (), -1, SQLITE_STATIC);
+        if (k.nulls & CubeKey::null_start)
+        {
+            sqlite3_bind_int (stmt, 2, cube_null);
+            sqlite3_bind_int (stmt, 3, cube_null);
+            sqlite3_bind_int (stmt, 6, cube_null);
+        } else
+        {
+            sqlite3_bind_int64 (stmt, 2, k.date);
+            sqlite3_bind_int (stmt, 3, k.hour);
+            sqlite3_bind_int (stmt, 6, utils::weekday (k.date));
+        }
+        if (k.nulls & CubeKey::null_stop)
         {
-            ipos = l.find ("\",");
-            l = l.substr (ipos + 2, l.length () - ipos - 2);
+            sqlite3_bind_int (stmt, 4, cube_null);
+            sqlite3_bind_int (stmt, 5, cube_null);
         } else
         {
-            ipos = l.find (",");
-            l = l.substr (ipos + 1, l.length () - ipos - 1);
+            sqlite3_bind_int64 (stmt, 4, k.stop_date);
+            sqlite3_bind_int (stmt, 5, k.stop_hour);
         }
+        const std::string * text [3] = {&k.user_type, &k.start_station,
+            &k.end_station};
+        for (int j = 0; j < 3; j++)
+        {
+            if (k.nulls & (CubeKey::null_user_type << j))
+            {
+                if (keys)
+                    sqlite3_bind_int (stmt, j + 7, cube_null);
+                else
+                    sqlite3_bind_text (stmt, j + 7, "", -1, SQLITE_STATIC);
+            } else if (keys)
+                db_utils::bind_number (stmt, j + 7, *text [j]);
+            else
+                sqlite3_bind_text (stmt, j + 7, text [j]->c_str (), -1,
+                        SQLITE_STATIC);
+        }
+        sqlite3_bind_int (stmt, 10, c.second);
+
+        const int rc = sqlite3_step (stmt);
+        sqlite3_reset (stmt);
+        if (rc != SQLITE_DONE)
+            throw std::runtime_error ("Unable to add trips to trip_counts");
     }
-    if (l.find ("\"") == std::string::npos)
+    sqlite3_clear_bindings (stmt);
+    cube.counts.clear ();
+}
+
+//' prepare_trip_stats
+//'
+//' Prepare the statements adding to the "trip_stats" and "station_stats"
+//' tables, which are not maintained for databases created before those tables
+//' were introduced.
+//'
+//' @noRd
+void db_add::prepare_trip_stats (sqlite3 * dbcon, TripStats &stats)
+{
+    stats.city_stmt = stats.stn_stmt = nullptr;
+    if (!db_utils::has_table (dbcon, "trip_stats"))
+        return;
+
+    // MIN and MAX with two arguments are NULL if either is
+    const std::string update = "DO UPDATE SET "
+        "numtrips = numtrips + excluded.numtrips, "
+        "first_trip = COALESCE (MIN (first_trip, excluded.first_trip), "
+        "first_trip, excluded.first_trip), "
+        "last_trip = COALESCE (MAX (last_trip, excluded.last_trip), "
+        "last_trip, excluded.last_trip)";
+    std::string qry = "INSERT INTO trip_stats (city, numtrips, first_trip, "
+        "last_trip) VALUES (?, ?, ?, ?) ON CONFLICT (city) " + update;
+    if (sqlite3_prepare_v2 (dbcon, qry.c_str (), -1, &stats.city_stmt,
+                nullptr) != SQLITE_OK)
+        throw std::runtime_error ("Unable to prepare trip_stats statement");
+    qry = "INSERT INTO station_stats (city, stn_id, numtrips, first_trip, "
+        "last_trip) VALUES (?, ?, ?, ?, ?) ON CONFLICT (city, stn_id) " +
+        update;
+    if (sqlite3_prepare_v2 (dbcon, qry.c_str (), -1, &stats.stn_stmt,
+                nullptr) != SQLITE_OK)
+    {
+        sqlite3_finalize (stats.city_stmt);
+        stats.city_stmt = nullptr;
+        throw std::runtime_error ("Unable to prepare station_stats statement");
+    }
+}
+
+void db_add::finalize_trip_stats (TripStats &stats)
+{
+    sqlite3_finalize (stats.city_stmt);
+    sqlite3_finalize (stats.stn_stmt);
+    stats.city_stmt = stats.stn_stmt = nullptr;
+}
+
+//' count_trip_stats
+//'
+//' Add all trips of one batch to the statistics of the city and of their start
+//' stations. Trips without start stations only count towards the city.
+//'
+//' @param compact If true, start times which can not be parsed are ignored,
+//'        as they are stored as NULL; otherwise all start times are compared
+//'        as text, as for MIN and MAX of the trips table.
+//'
+//' @noRd
+void db_add::count_trip_stats (TripStats &stats, const TripBatch &batch,
+        bool compact)
+{
+    const char * txt = batch.text.c_str ();
+    size_t pos = 0;
+    for (size_t i = 0; i < batch.nrows; i++)
     {
-        headers.quoted [headers.nvalues - 1] = false;
-        headers.terminal_quote = false;
-    } else
+        std::string_view start, stn;
+        bool has_start = false, has_stn = false;
+        for (size_t j = 0; j < num_trip_fields; j++)
+        {
+            const int len = batch.lens [i * num_trip_fields + j];
+            if (len < 0)
+                continue;
+            std::string_view val (txt + pos, static_cast <size_t> (len));
+            pos += static_cast <size_t> (len);
+            if (j == trip::start_time)
+            {
+                int64_t t;
+                has_start = !compact || utils::parse_datetime_fixed (val, t);
+                start = val;
+            } else if (j == trip::start_station_id)
+            {
+                has_stn = true;
+                stn = val;
+            }
+        }
+
+        stats.city.numtrips++;
+        if (has_start)
+            stats.city.add (start);
+        if (has_stn)
+        {
+            TripStat &s = stats.stations [stn];
+            s.numtrips++;
+            if (has_start)
+                s.add (start);
+        }
+    }
+}
+
+//' flush_trip_stats
+//'
+//' Add the statistics of a TripStats to the "trip_stats" and "station_stats"
+//' tables, and clear them.
+//'
+//' @param compact If true, start times are written in the form returned by
+//'        the trips view of the compact schema, so that comparisons remain
+//'        valid between batches.
+//'
+//' @noRd
+void db_add::flush_trip_stats (TripStats &stats, const std::string &city,
+        bool compact)
+{
+    if (stats.city.numtrips == 0)
+        return;
+
+    std::string first, last;
+    auto bind_stat = [&] (sqlite3_stmt * stmt, int col, const TripStat &s) {
+        sqlite3_bind_int64 (stmt, col, s.numtrips);
+        if (s.first.empty ())
+        {
+            sqlite3_bind_null (stmt, col + 1);
+            sqlite3_bind_null (stmt, col + 2);
+            return;
+        }
+        first = s.first;
+        last = s.last;
+        int64_t t;
+        if (compact)
+        {
+            utils::parse_datetime_fixed (s.first, t);
+            utils::format_datetime (t, first);
+            utils::parse_datetime_fixed (s.last, t);
+            utils::format_datetime (t, last);
+        }
+        sqlite3_bind_text (stmt, col + 1, first.c_str (), -1,
+                SQLITE_TRANSIENT);
+        sqlite3_bind_text (stmt, col + 2, last.c_str (), -1,
+                SQLITE_TRANSIENT);
+    };
+    auto step = [] (sqlite3_stmt * stmt, const std::string &table) {
+        const int rc = sqlite3_step (stmt);
+        sqlite3_reset (stmt);
+        if (rc != SQLITE_DONE)
+            throw std::runtime_error ("Unable to add trips to " + table);
+    };
+
+    sqlite3_bind_text (stats.city_stmt, 1, city.c_str (), -1, SQLITE_STATIC);
+    bind_stat (stats.city_stmt, 2, stats.city);
+    step (stats.city_stmt, "trip_stats");
+    sqlite3_clear_bindings (stats.city_stmt);
+
+    sqlite3_bind_text (stats.stn_stmt, 1, city.c_str (), -1, SQLITE_STATIC);
+    for (size_t s = 0; s < stats.stations.size (); s++)
     {
-        headers.quoted [headers.nvalues - 1] = true;
-        headers.terminal_quote = true;
+        const std::string_view stn = stats.stations.key (s);
+        sqlite3_bind_text (stats.stn_stmt, 2, stn.data (),
+                static_cast <int> (stn.size ()), SQLITE_STATIC);
+        bind_stat (stats.stn_stmt, 3, stats.stations.value (s));
+        step (stats.stn_stmt, "station_stats");
     }
+    sqlite3_clear_bindings (stats.stn_stmt);
+
+    stats.city = TripStat ();
+    stats.stations.clear ();
 }
 
-void db_add::dump_headers (const HeaderStruct &headers)
+//' prepare_trip_parts
+//'
+//' Get all existing partitions of one city of a partitioned database. Inserts
+//' into each are prepared as trips are first inserted.
+//'
+//' @noRd
+void db_add::prepare_trip_parts (sqlite3 * dbcon, const std::string &city,
+        bool defer_indexes, TripParts &tparts)
 {
-    Rcpp::Rcout << "Header has " << headers.nvalues <<
-        " with [quoted, pos_file2db, _db2file] having [" <<
-        headers.quoted.size () << ", " << headers.position_file2db.size () <<
-         "]" << std::endl;
+    tparts = TripParts ();
+    tparts.defer_indexes = defer_indexes;
+    for (auto tp: parts::get_parts (dbcon, city))
+        tparts.parts [tp.part.name].tp = tp;
+}
 
-    for (size_t i = 0; i < headers.position_file2db.size (); i++)
+//' insert_trip_parts
+//'
+//' Insert all trips from one TripBatch into the tables of the partitions of
+//' their months of starting, creating tables of new partitions as needed.
+//' Trips with start times which can not be parsed are inserted into the "NA"
+//' partition.
+//'
+//' @return Number of trips inserted
+//'
+//' @noRd
+int db_add::insert_trip_parts (sqlite3 * dbcon, TripParts &tparts,
+        const std::string &city, const TripBatch &batch)
+{
+    const char * txt = batch.text.c_str ();
+    size_t pos = 0;
+
+    // consecutive trips are generally in the same month
+    int64_t month = -1;
+    PartInsert * pi = nullptr;
+    for (size_t i = 0; i < batch.nrows; i++)
     {
-        Rcpp::Rcout << "pos [" << i << "] = " <<
-            headers.position_file2db [i];
-        if (headers.quoted [i])
-            Rcpp::Rcout << " is quoted" << std::endl;
-        else
-            Rcpp::Rcout << " is NOT quoted" << std::endl;
+        const size_t pos0 = pos;
+        int64_t t [2] = {colstore::null_time, colstore::null_time};
+        for (size_t j = 0; j < num_trip_fields; j++)
+        {
+            const int len = batch.lens [i * num_trip_fields + j];
+            if (len < 0)
+                continue;
+            if (j == trip::start_time || j == trip::stop_time)
+            {
+                const size_t k = (j == trip::start_time) ? 0 : 1;
+                if (!utils::parse_datetime_fixed (std::string_view (txt + pos,
+                                static_cast <size_t> (len)), t [k]))
+                    t [k] = colstore::null_time;
+            }
+            pos += static_cast <size_t> (len);
+        }
+
+        int64_t this_month = 0;
+        std::string name = "NA";
+        if (t [0] != colstore::null_time)
+        {
+            int y;
+            unsigned int m, d;
+            utils::civil_from_days (utils::epoch_day (t [0]), y, m, d);
+            this_month = static_cast <int64_t> (y) * 12 + m;
+            if (pi == nullptr || this_month != month)
+            {
+                char mbuf [16];
+                snprintf (mbuf, sizeof (mbuf), "%04d-%02u", y, m);
+                name = mbuf;
+            }
+        }
+        if (pi == nullptr || this_month != month)
+        {
+            pi = &tparts.parts [name];
+            if (pi->tp.table.empty ())
+            {
+                pi->tp.city = city;
+                pi->tp.part.name = name;
+                pi->tp.table = parts::table_name (city, name);
+            }
+            month = this_month;
+        }
+
+        colstore::Part &p = pi->tp.part;
+        if (t [0] != colstore::null_time)
+        {
+            if (p.min_start == colstore::null_time || t [0] < p.min_start)
+                p.min_start = t [0];
+            if (p.max_start == colstore::null_time || t [0] > p.max_start)
+                p.max_start = t [0];
+        }
+        if (t [1] != colstore::null_time)
+        {
+            if (p.min_stop == colstore::null_time || t [1] < p.min_stop)
+                p.min_stop = t [1];
+            if (p.max_stop == colstore::null_time || t [1] > p.max_stop)
+                p.max_stop = t [1];
+        }
+        pi->batch.text.append (txt + pos0, pos - pos0);
+        pi->batch.lens.insert (pi->batch.lens.end (),
+                batch.lens.begin () + static_cast <std::ptrdiff_t> (
+                    i * num_trip_fields),
+                batch.lens.begin () + static_cast <std::ptrdiff_t> (
+                    (i + 1) * num_trip_fields));
+        pi->batch.nrows++;
+    }
+
+    int ntrips = 0;
+    for (auto &pii: tparts.parts)
+    {
+        PartInsert &part = pii.second;
+        if (part.batch.nrows == 0)
+            continue;
+        if (part.ins.single == nullptr)
+        {
+            if (part.tp.part.nrows == 0 &&
+                    !db_utils::has_table (dbcon, part.tp.table))
+            {
+                parts::create_table (dbcon, part.tp.table,
+                        !tparts.defer_indexes);
+                if (tparts.defer_indexes)
+                    tparts.unindexed.push_back (part.tp.table);
+                tparts.new_tables = true;
+            }
+            db_add::prepare_trip_insert (dbcon, part.tp.table, part.ins);
+        }
+        ntrips += db_add::insert_trip_batch (part.ins, city, part.batch);
+        part.tp.part.nrows += static_cast <int64_t> (part.batch.nrows);
+        part.changed = true;
+        part.batch.text.clear ();
+        part.batch.lens.clear ();
+        part.batch.nrows = 0;
+    }
+
+    return ntrips;
+}
+
+//' commit_trip_parts
+//'
+//' Record the numbers and ranges of times of all partitions with trips added
+//' since the previous commit in the "trip_parts" table, and recreate the views
+//' of all partitions if any were added. Must be called within the same
+//' transaction which inserts the trips.
+//'
+//' @noRd
+void db_add::commit_trip_parts (sqlite3 * dbcon, TripParts &tparts)
+{
+    for (auto &pii: tparts.parts)
+        if (pii.second.changed)
+        {
+            parts::update_part (dbcon, pii.second.tp);
+            pii.second.changed = false;
+        }
+    if (tparts.new_tables)
+        parts::create_views (dbcon);
+    tparts.new_tables = false;
+}
+
+//' index_trip_parts
+//'
+//' Create indexes of all tables of partitions added with deferred indexes,
+//' excluding those of any transaction which was rolled back.
+//'
+//' @noRd
+void db_add::index_trip_parts (sqlite3 * dbcon, TripParts &tparts)
+{
+    for (auto t: tparts.unindexed)
+        if (db_utils::has_table (dbcon, t))
+            parts::create_indexes (dbcon, t);
+    tparts.unindexed.clear ();
+}
+
+void db_add::finalize_trip_parts (TripParts &tparts)
+{
+    for (auto &pii: tparts.parts)
+        db_add::finalize_trip_insert (pii.second.ins);
+}
+
+//' has_datafile
+//'
+//' @return True if the nominated file is in the datafiles table
+//'
+//' @noRd
+bool db_add::has_datafile (sqlite3 * dbcon, const std::string &city,
+        const std::string &name)
+{
+    sqlite3_stmt * stmt;
+    sqlite3_prepare_v2 (dbcon, "SELECT 1 FROM datafiles WHERE city = ? AND "
+            "name = ? LIMIT 1", -1, &stmt, nullptr);
+    sqlite3_bind_text (stmt, 1, city.c_str (), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text (stmt, 2, name.c_str (), -1, SQLITE_TRANSIENT);
+    const bool res = (sqlite3_step (stmt) == SQLITE_ROW);
+    sqlite3_finalize (stmt);
+
+    return res;
+}
+
+//' insert_datafile
+//'
+//' Insert one entry into the datafiles table
+//'
+//' @noRd
+void db_add::insert_datafile (sqlite3 * dbcon, const std::string &city,
+        const DataFile &f)
+{
+    sqlite3_stmt * stmt;
+    sqlite3_prepare_v2 (dbcon, "INSERT INTO datafiles "
+            "(city, name, nrows, size, hash) VALUES (?, ?, ?, ?, ?)",
+            -1, &stmt, nullptr);
+    sqlite3_bind_text (stmt, 1, city.c_str (), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_text (stmt, 2, f.name.c_str (), -1, SQLITE_TRANSIENT);
+    sqlite3_bind_int64 (stmt, 3, f.nrows);
+    sqlite3_bind_int64 (stmt, 4, f.size);
+    sqlite3_bind_text (stmt, 5, f.hash.hex ().c_str (), -1, SQLITE_TRANSIENT);
+    const int rc = sqlite3_step (stmt);
+    sqlite3_finalize (stmt);
+    if (rc != SQLITE_DONE)
+        throw std::runtime_error ("Unable to insert " + f.name +
+                " into datafiles table");
+}
+
+//' start_wal
+//'
+//' Replace the automatic checkpoints of a database with a write-ahead log by a
+//' hook recording the size of the log after each commit, so that checkpoints
+//' are only made by checkpoint_wal.
+//'
+//' @noRd
+void db_add::start_wal (sqlite3 * dbcon, WalLog &wal)
+{
+    sqlite3_wal_hook (dbcon, [] (void * arg, sqlite3 *, const char *,
+                int nframes) {
+            static_cast <WalLog *> (arg)->frames = nframes;
+            return SQLITE_OK;
+            }, &wal);
+}
+
+//' checkpoint_wal
+//'
+//' Copy frames of the write-ahead log back into the database, outside of any
+//' transaction. Checkpoints are passive, so never wait for readers of the
+//' database, and are skipped until at least WAL_CHECKPOINT_FRAMES frames have
+//' been committed since the last one.
+//'
+//' @param final If true, checkpoint regardless of the size of the log, and
+//'        truncate it if no readers remain.
+//'
+//' @noRd
+void db_add::checkpoint_wal (sqlite3 * dbcon, WalLog &wal, bool final)
+{
+    if (wal.frames < wal.backfilled) // log has been restarted
+        wal.backfilled = 0;
+    if (!final && wal.frames - wal.backfilled < WAL_CHECKPOINT_FRAMES)
+        return;
+
+    const auto t0 = std::chrono::steady_clock::now ();
+    int nlog = 0, nckpt = 0;
+    // Truncating checkpoints return SQLITE_BUSY when readers prevent the log
+    // from being truncated, having checkpointed as much as possible.
+    const int rc = sqlite3_wal_checkpoint_v2 (dbcon, nullptr,
+            final ? SQLITE_CHECKPOINT_TRUNCATE : SQLITE_CHECKPOINT_PASSIVE,
+            &nlog, &nckpt);
+    wal.secs += std::chrono::duration <double> (
+            std::chrono::steady_clock::now () - t0).count ();
+    if (rc != SQLITE_OK && rc != SQLITE_BUSY)
+        throw std::runtime_error ("Unable to checkpoint write-ahead log");
+
+    // Logs which have been truncated report no frames, all having been copied.
+    if (rc == SQLITE_OK && nlog == 0)
+        nckpt = wal.frames;
+    wal.checkpoints++;
+    if (nckpt > wal.backfilled)
+        wal.copied += nckpt - wal.backfilled;
+    wal.frames = nlog;
+    wal.backfilled = std::min (nckpt, nlog);
+}
+
+//' profile_list
+//'
+//' Convert the counts and times of rcpp_import_to_trip_table to a list of
+//' three lists, each of which is converted to a data.frame in R:
+//' 1. "stages" with the times in seconds of each stage of reading, from
+//'    planning the chunks of files, through reading and parsing lines and
+//'    converting date-times (all summed over parser threads), waiting for
+//'    parser threads, inserting trips, counting trips in the "trip_counts"
+//'    table, storing columns, importing stations, committing files, and
+//'    checkpointing write-ahead logs, to rebuilding indexes after bulk loading.
+//' 2. "files" with numbers of bytes, lines, trips stored, and lines not
+//'    stored, and seconds spent on each file.
+//' 3. "rejected" with numbers of lines not stored for each reason.
+//'
+//' @noRd
+Rcpp::List db_add::profile_list (const IngestProfile &prof,
+        const std::vector <std::string> &filenames)
+{
+    const char * stage_names [] = {"plan", "read", "parse", "datetime",
+        "wait", "insert", "trip_counts", "columns", "stations", "commit",
+        "checkpoint", "indexes"};
+    Rcpp::CharacterVector stages (num_stages);
+    Rcpp::NumericVector stage_secs (num_stages);
+    for (size_t s = 0; s < num_stages; s++)
+    {
+        stages [s] = stage_names [s];
+        stage_secs [s] = prof.secs [s];
+    }
+
+    const size_t nfiles = prof.files.size ();
+    Rcpp::CharacterVector files (nfiles);
+    Rcpp::NumericVector bytes (nfiles), file_secs (nfiles);
+    Rcpp::IntegerVector lines (nfiles), trips (nfiles), rejected (nfiles);
+    for (size_t i = 0; i < nfiles; i++)
+    {
+        const FileProfile &f = prof.files [i];
+        files [i] = filenames [i];
+        bytes [i] = static_cast <double> (f.bytes);
+        lines [i] = static_cast <int> (f.lines);
+        trips [i] = static_cast <int> (f.trips);
+        rejected [i] = static_cast <int> (f.rejected);
+        file_secs [i] = f.secs;
     }
+
+    const char * reason_names [] = {"fields", "datetime", "station"};
+    Rcpp::CharacterVector reasons (num_reject_reasons - 1);
+    Rcpp::IntegerVector nrejected (num_reject_reasons - 1);
+    for (size_t r = 1; r < num_reject_reasons; r++)
+    {
+        reasons [r - 1] = reason_names [r - 1];
+        nrejected [r - 1] = static_cast <int> (prof.rejected [r]);
+    }
+
+    return Rcpp::List::create (
+            Rcpp::Named ("stages") = Rcpp::List::create (
+                Rcpp::Named ("stage") = stages,
+                Rcpp::Named ("seconds") = stage_secs),
+            Rcpp::Named ("files") = Rcpp::List::create (
+                Rcpp::Named ("file") = files,
+                Rcpp::Named ("bytes") = bytes,
+                Rcpp::Named ("lines") = lines,
+                Rcpp::Named ("trips") = trips,
+                Rcpp::Named ("rejected") = rejected,
+                Rcpp::Named ("seconds") = file_secs),
+            Rcpp::Named ("rejected") = Rcpp::List::create (
+                Rcpp::Named ("reason") = reasons,
+                Rcpp::Named ("lines") = nrejected));
 }
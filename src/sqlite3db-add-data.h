@@ -1,7 +1,7 @@
 #pragma once
 /***************************************************************************
  *  Project:    bikedata
- *  File:       splite3db-add-data.h
+ *  File:       sqlite3db-add-data.h
  *  Language:   C++
  *
  *  Author:     Mark Padgham 
@@ -11,7 +11,7 @@
  *                  Routines to construct sqlite3 database and associated
  *                  indexes are in 'sqlite3db-add-data.cpp'.
  *
- *  Compiler Options:   -std=c++11
+ *  Compiler Options:   -std=c++17
  ***************************************************************************/
 
 #include "common.h"
@@ -20,7 +20,14 @@
 #include "sqlite3db-utils.h"
 #include "read-station-files.h"
 #include "read-city-files.h"
+#include "read-headers.h"
+#include "parse-pool.h"
+#include "line-reader.h"
+#include "column-store.h"
+#include "sqlite3db-parts.h"
 
+#include <charconv>
+#include <unordered_map>
 #include <sstream>
 #include <fstream>
 #include <iostream>
@@ -28,18 +35,236 @@
 // [[Rcpp::depends(BH)]]
 #include <Rcpp.h>
 
-int rcpp_import_to_trip_table (const char* bikedb, 
-        Rcpp::CharacterVector datafiles, std::string city,
-        std::string header_file_name, bool data_has_stations, bool quiet);
-int rcpp_import_to_file_table (const char * bikedb,
-        Rcpp::CharacterVector datafiles, std::string city, int nfiles);
+Rcpp::IntegerVector rcpp_import_to_trip_table (const char* bikedb, 
+        Rcpp::CharacterVector datafiles, Rcpp::CharacterVector datafile_names,
+        std::string city, std::string header_file_name,
+        bool data_has_stations, bool quiet, int nthreads, bool bulk,
+        bool profile, double chunk_size);
+
+// Number of trips inserted by each step of multi-row INSERT statements. Each
+// trip has 10 parameters, or 17 with calendar columns, and older versions of
+// SQLite allow at most MAX_PARAMS in each statement, which may reduce the
+// number of rows of tables with calendar columns.
+#ifndef INSERT_ROWS
+#define INSERT_ROWS 64
+#endif
+#define MAX_PARAMS 999
+
+// Prepared statements inserting "rows" trips, and single trips for the
+// remainder of each batch, with "nparams" parameters for each trip.
+struct TripInsert {
+    sqlite3_stmt * multi = nullptr;
+    sqlite3_stmt * single = nullptr;
+    size_t rows = INSERT_ROWS;
+    int nparams = 0;
+    bool calendar = false;
+};
+
+// Integer codes used in databases with the compact schema. "stations" maps
+// station IDs (with city prefixes) to their "id" values in the stations table,
+// and is held for all files read in one call.
+struct CompactKeys {
+    int city = 0;
+    std::unordered_map <std::string, int> stations;
+    std::string buf;
+    sqlite3_stmt * stmt = nullptr; // inserts new stations
+};
+
+// One entry of the "datafiles" table, for all data files read under one name
+// (such as all files from one zip archive), with total numbers of trips and
+// bytes, and the hash of the contents of all files in the order read.
+struct DataFile {
+    std::string name;
+    int64_t nrows = 0, size = 0;
+    ContentHash hash;
+};
+
+// Counts and times of reading one data file. Times are those spent by the
+// thread writing to the database, including waiting for parser threads.
+struct FileProfile {
+    int64_t bytes = 0;
+    size_t lines = 0, trips = 0, rejected = 0;
+    double secs = 0.0;
+};
+
+// Counts and times of all stages of one call to rcpp_import_to_trip_table,
+// with times of the parsing stages summed over all batches, and so over all
+// parser threads.
+struct IngestProfile {
+    std::array <double, num_stages> secs {};
+    std::array <size_t, num_reject_reasons> rejected {};
+    std::vector <FileProfile> files;
+
+    void add_batch (size_t filenum, const TripBatch &batch)
+    {
+        FileProfile &f = files [filenum];
+        f.lines += batch.hash.nlines;
+        f.trips += batch.nrows;
+        for (size_t r = 0; r < num_reject_reasons; r++)
+        {
+            f.rejected += batch.rejected [r];
+            rejected [r] += batch.rejected [r];
+        }
+        for (auto s: {stage::read, stage::parse, stage::datetime})
+            secs [s] += batch.secs [s];
+    }
+};
+
+// One cell of the "trip_counts" table, which holds numbers of trips by city,
+// date and hour of starting and stopping, weekday, user type, and start and end
+// stations. Dates are days since 1970-01-01, and text fields hold station IDs
+// and user types as bound to the trips table. Cells of trips with NULL values
+// (flagged in "nulls") are stored as NULL.
+struct CubeKey {
+    int64_t date = 0, stop_date = 0;
+    int hour = 0, stop_hour = 0, weekday = 0;
+    std::string user_type, start_station, end_station;
+    unsigned int nulls = 0;
+
+    // bits of "nulls"
+    enum Null {
+        null_start = 1, null_stop = 2, null_user_type = 4,
+        null_start_station = 8, null_end_station = 16
+    };
+
+    bool operator== (const CubeKey &k) const
+    {
+        return date == k.date && stop_date == k.stop_date &&
+            hour == k.hour && stop_hour == k.stop_hour &&
+            nulls == k.nulls && user_type == k.user_type &&
+            start_station == k.start_station &&
+            end_station == k.end_station;
+    }
+};
+
+struct CubeKeyHash {
+    size_t operator() (const CubeKey &k) const
+    {
+        std::hash <std::string> h;
+        size_t res = std::hash <int64_t> () (k.date * 25 + k.hour);
+        res = res * 31 + std::hash <int64_t> () (k.stop_date * 25 +
+                k.stop_hour);
+        res = res * 31 + h (k.user_type);
+        res = res * 31 + h (k.start_station);
+        res = res * 31 + h (k.end_station);
+        return res ^ k.nulls;
+    }
+};
+
+// Counts of trips in each cell, accumulated over one batch and then added to
+// the "trip_counts" table.
+struct TripCube {
+    std::unordered_map <CubeKey, int, CubeKeyHash> counts;
+    sqlite3_stmt * stmt = nullptr; // adds counts to table
+};
+
+// Number of trips, and first and last start times, of one city or station, as
+// held in the "trip_stats" and "station_stats" tables. Times are text as bound
+// to the trips table, and are empty where no start times are known.
+struct TripStat {
+    int64_t numtrips = 0;
+    std::string first, last;
+
+    void add (std::string_view t)
+    {
+        if (first.empty () || t < first)
+            first.assign (t.data (), t.size ());
+        if (last.empty () || t > last)
+            last.assign (t.data (), t.size ());
+    }
+};
+
+// Statistics of all trips of one city, and of trips from each start station,
+// accumulated over one batch and then added to the "trip_stats" and
+// "station_stats" tables.
+struct TripStats {
+    TripStat city;
+    StringMap <TripStat> stations;
+    sqlite3_stmt * city_stmt = nullptr;
+    sqlite3_stmt * stn_stmt = nullptr;
+};
+
+// Trips of one batch to be inserted into one partition of a partitioned
+// database (see sqlite3db-parts.h), along with the statements inserting them,
+// and the numbers and ranges of times of all trips of the partition.
+struct PartInsert {
+    parts::TablePart tp;
+    TripInsert ins;
+    TripBatch batch;
+    bool changed = false; // since "trip_parts" was last updated
+};
+
+// All partitions of one city, by name. Tables of new partitions are created
+// as trips are first inserted, and only indexed once all data have been
+// loaded if "defer_indexes" is set.
+struct TripParts {
+    std::map <std::string, PartInsert> parts;
+    bool new_tables = false; // since views were last created
+    bool defer_indexes = false;
+    std::vector <std::string> unindexed;
+};
+
+// Databases with write-ahead logs are checkpointed after any commit which
+// leaves at least this many frames (pages) in the log, rather than after
+// SQLite's default of 1000, so that checkpoints are fewer, and can be timed.
+#ifndef WAL_CHECKPOINT_FRAMES
+#define WAL_CHECKPOINT_FRAMES 16384
+#endif
+
+// Frames in the write-ahead log after the last commit, as reported by the hook
+// set by start_wal, and of those already copied back into the database, along
+// with numbers and times of all checkpoints.
+struct WalLog {
+    int frames = 0;
+    int backfilled = 0;
+    size_t checkpoints = 0;
+    int64_t copied = 0;
+    double secs = 0.0;
+};
 
 namespace db_add {
 
-HeaderStruct get_field_positions (const std::string fname,
-        const std::string header_file_name, bool data_has_stations,
-        const std::string city);
-void get_field_quotes (const std::string line, HeaderStruct &headers);
-void dump_headers (const HeaderStruct &headers);
+std::vector <FileChunk> plan_trip_file (const std::string &filename,
+        size_t filenum, const std::string &city,
+        const std::string &header_file_name, bool data_has_stations,
+        int64_t chunk_size, ContentHash &header_hash);
+TripBatch read_trip_chunk (const FileChunk &chunk, const std::string &city,
+        const StringMap <std::string> &stn_map, bool profile);
+void prepare_trip_insert (sqlite3 * dbcon, const std::string &table,
+        TripInsert &ins);
+void finalize_trip_insert (TripInsert &ins);
+int insert_trip_batch (TripInsert &ins, const std::string &city,
+        const TripBatch &batch);
+void get_compact_keys (sqlite3 * dbcon, const std::string &city,
+        CompactKeys &keys);
+int station_key (CompactKeys &keys, std::string_view stn_id);
+int insert_trip_batch_compact (TripInsert &ins, CompactKeys &keys,
+        const TripBatch &batch);
+bool has_datafile (sqlite3 * dbcon, const std::string &city,
+        const std::string &name);
+void insert_datafile (sqlite3 * dbcon, const std::string &city,
+        const DataFile &f);
+void prepare_trip_cube (sqlite3 * dbcon, bool compact, TripCube &cube);
+void count_trip_batch (TripCube &cube, const TripBatch &batch,
+        CompactKeys * keys);
+void flush_trip_cube (TripCube &cube, const std::string &city,
+        const CompactKeys * keys);
+void prepare_trip_stats (sqlite3 * dbcon, TripStats &stats);
+void finalize_trip_stats (TripStats &stats);
+void count_trip_stats (TripStats &stats, const TripBatch &batch,
+        bool compact);
+void flush_trip_stats (TripStats &stats, const std::string &city,
+        bool compact);
+void prepare_trip_parts (sqlite3 * dbcon, const std::string &city,
+        bool defer_indexes, TripParts &tparts);
+int insert_trip_parts (sqlite3 * dbcon, TripParts &tparts,
+        const std::string &city, const TripBatch &batch);
+void commit_trip_parts (sqlite3 * dbcon, TripParts &tparts);
+void index_trip_parts (sqlite3 * dbcon, TripParts &tparts);
+void finalize_trip_parts (TripParts &tparts);
+void start_wal (sqlite3 * dbcon, WalLog &wal);
+void checkpoint_wal (sqlite3 * dbcon, WalLog &wal, bool final);
+Rcpp::List profile_list (const IngestProfile &prof,
+        const std::vector <std::string> &filenames);
 
 } // end namespace db_add
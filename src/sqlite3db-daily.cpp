@@ -0,0 +1,516 @@
+/***************************************************************************
+ *  Project:    bikedata
+ *  File:       sqlite3db-daily.cpp
+ *  Language:   C++
+ *
+ *  Author:     Mark Padgham
+ *  E-Mail:     mark.padgham@email.com
+ *
+ *  Description:    Counts of trips on each day, in total or for each start
+ *                  station, optionally standardised by the numbers of
+ *                  stations in operation on each day.
+ *
+ *  Compiler Options:   -std=c++17
+ ***************************************************************************/
+
+#include "sqlite3db-daily.h"
+#include "string-map.h"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+/***************************************************************************
+ * Trips are counted in a single pass, as for tripmat::count_trips, from the
+ * "trip_counts" table where the filters allow, otherwise from the columnar
+ * store where there is one, and otherwise from the trips table (or from the
+ * tables of those partitions of partitioned databases which may hold filtered
+ * trips; see tripmat::trip_tables). Days are integer days since 1970-01-01
+ * throughout, and are only converted to dates in R. Results include every
+ * day from the first to the last day on which trips were counted, with zero
+ * counts for days without trips.
+ ***************************************************************************/
+
+namespace {
+
+// Day of text date-times beginning "YYYY-mm-dd"
+bool text_day (const unsigned char * c, int n, int64_t &day)
+{
+    if (c == nullptr || n < 10 || c [4] != '-' || c [7] != '-')
+        return false;
+    int v [3] = {0, 0, 0};
+    const int pos [3] = {0, 5, 8}, len [3] = {4, 2, 2};
+    for (int i = 0; i < 3; i++)
+        for (int j = pos [i]; j < pos [i] + len [i]; j++)
+        {
+            if (c [j] < '0' || c [j] > '9')
+                return false;
+            v [i] = 10 * v [i] + (c [j] - '0');
+        }
+    day = utils::days_from_civil (v [0], v [1], v [2]);
+    return true;
+}
+
+// Numbers of trips for each station index and day, accumulated in any order.
+// Station indices index the names passed to "expand", or are all 0 for
+// total counts.
+class DayCounter
+{
+    public:
+        void add (size_t stn, int64_t day, double n)
+        {
+            cells [(static_cast <uint64_t> (stn) << 32) |
+                static_cast <uint32_t> (day)] += n;
+        }
+
+        void expand (const std::vector <std::string> &names, bool per_station,
+                daily::DailyCounts &res) const
+        {
+            res = daily::DailyCounts ();
+
+            // stations are sorted by ID, with distinct keys of the same ID
+            // merged, and stations without IDs dropped
+            std::vector <size_t> used;
+            for (auto c: cells)
+            {
+                const size_t s = static_cast <size_t> (c.first >> 32);
+                if (!per_station ||
+                        (s < names.size () && !names [s].empty ()))
+                    used.push_back (s);
+            }
+            if (used.empty ())
+                return;
+            std::unordered_map <size_t, size_t> stn_index;
+            if (per_station)
+            {
+                for (auto s: used)
+                    res.stations.push_back (names [s]);
+                std::sort (res.stations.begin (), res.stations.end ());
+                res.stations.erase (std::unique (res.stations.begin (),
+                            res.stations.end ()), res.stations.end ());
+                for (auto s: used)
+                    stn_index [s] = static_cast <size_t> (std::lower_bound (
+                                res.stations.begin (), res.stations.end (),
+                                names [s]) - res.stations.begin ());
+            } else
+                stn_index [0] = 0;
+
+            int64_t lo = INT64_MAX, hi = INT64_MIN;
+            for (auto c: cells)
+                if (stn_index.count (static_cast <size_t> (c.first >> 32)))
+                {
+                    const int64_t d = static_cast <int32_t> (c.first &
+                            0xffffffffu);
+                    lo = std::min (lo, d);
+                    hi = std::max (hi, d);
+                }
+            res.first_day = lo;
+            res.ndays = static_cast <size_t> (hi - lo + 1);
+            res.counts.assign (std::max (res.stations.size (),
+                        static_cast <size_t> (1)) * res.ndays, 0.0);
+            for (auto c: cells)
+            {
+                auto it = stn_index.find (static_cast <size_t> (c.first >> 32));
+                if (it == stn_index.end ())
+                    continue;
+                const int64_t d = static_cast <int32_t> (c.first & 0xffffffffu);
+                res.counts [it->second * res.ndays +
+                    static_cast <size_t> (d - lo)] += c.second;
+            }
+        }
+
+    private:
+        std::unordered_map <uint64_t, double> cells;
+};
+
+// Count trips from the columnar store, as for tripmat::count_column_trips,
+// with station indices being the keys of the store, and "names" the IDs of
+// those keys.
+bool count_column_days (sqlite3 * dbcon, const TripFilters &filters,
+        bool per_station, DayCounter &counter, std::vector <std::string> &names)
+{
+    // stations are filtered by key, which the store must first look up
+    TripFilters col_filters = filters;
+    std::string station;
+    auto f = col_filters.find ("start_station");
+    if (f != col_filters.end ())
+    {
+        if (!f->second.empty ())
+            station = f->second [0];
+        col_filters.erase (f);
+    }
+
+    f = col_filters.find ("city");
+    colstore::RowFilter rf;
+    if (f == col_filters.end () || f->second.empty () ||
+            !colstore::has_store (dbcon) ||
+            !tripmat::column_filter (col_filters, rf))
+        return false;
+
+    const std::string &city = f->second [0];
+    const std::string dir = colstore::dir_name (dbcon);
+    const std::vector <colstore::Part> parts = colstore::get_parts (dbcon,
+            city);
+    if (parts.empty () || !colstore::has_files (dir, city, parts))
+        return false;
+
+    names = colstore::get_stations (dbcon, city);
+    if (!station.empty ())
+    {
+        rf.has_start_station = true;
+        rf.start_station = -1; // matches no trips
+        for (size_t i = 0; i < names.size (); i++)
+            if (names [i] == station)
+                rf.start_station = static_cast <int32_t> (i);
+    }
+
+    for (auto p: parts)
+    {
+        if (rf.skip_part (p))
+            continue;
+        Rcpp::checkUserInterrupt ();
+        colstore::PartReader r (dir, city, p);
+        const int64_t * start = r.start_time ();
+        const int32_t * start_stn = r.start_station ();
+        for (size_t k = 0; k < static_cast <size_t> (p.nrows); k++)
+        {
+            if (start [k] == colstore::null_time || !rf.matches (r, k) ||
+                    (per_station && start_stn [k] < 0))
+                continue;
+            counter.add (per_station ? static_cast <size_t> (start_stn [k]) :
+                    0, utils::epoch_day (start [k]), 1.0);
+        }
+    }
+
+    return true;
+}
+
+// IDs of stations of compact databases, indexed by their integer keys
+std::vector <std::string> station_keys (sqlite3 * dbcon)
+{
+    std::vector <std::string> names;
+    sqlite3_stmt * stmt;
+    sqlite3_prepare_v2 (dbcon, "SELECT id, stn_id FROM stations", -1, &stmt,
+            nullptr);
+    while (sqlite3_step (stmt) == SQLITE_ROW)
+    {
+        const sqlite3_int64 id = sqlite3_column_int64 (stmt, 0);
+        const unsigned char * c = sqlite3_column_text (stmt, 1);
+        if (id < 0 || c == nullptr)
+            continue;
+        if (static_cast <uint64_t> (id) >= names.size ())
+            names.resize (static_cast <size_t> (id) + 1);
+        names [static_cast <size_t> (id)] =
+            reinterpret_cast <const char *> (c);
+    }
+    sqlite3_finalize (stmt);
+    return names;
+}
+
+} // end anonymous namespace
+
+//' count_daily_trips
+//'
+//' @param dbcon Active connection to sqlite3 database
+//' @param filters TripFilters, which may also include "start_station"
+//' @param per_station If true, trips are counted for each start station;
+//'        otherwise in total
+//' @param res On return, DailyCounts of all days from the first to the last
+//'        day of any filtered trips. Trips with NULL start times, and (when
+//'        counted per station) NULL start stations, are not counted.
+//'
+//' @noRd
+void daily::count_daily_trips (sqlite3 * dbcon, const TripFilters &filters,
+        bool per_station, DailyCounts &res)
+{
+    const bool compact = db_utils::is_compact (dbcon);
+    DayCounter counter;
+    std::vector <std::string> names;
+
+    std::string qry;
+    std::vector <std::string> args;
+    const bool use_cube = db_utils::has_table (dbcon, "trip_counts") &&
+        tripmat::cube_filter_qry (filters, compact, qry, args);
+    if (use_cube ||
+            !count_column_days (dbcon, filters, per_station, counter, names))
+    {
+        if (compact && per_station)
+            names = station_keys (dbcon);
+
+        const std::string stn = compact ? "start_station" :
+            "start_station_id";
+        const bool calendar = !use_cube && db_utils::has_calendar (dbcon);
+        std::vector <std::string> tables;
+        if (use_cube)
+            tables.push_back ("trip_counts");
+        else
+        {
+            tripmat::filter_qry (filters, compact, calendar, qry, args);
+            tables = tripmat::trip_tables (dbcon, filters);
+        }
+        const std::string cols = use_cube ? "date, " + stn + ", numtrips" :
+            std::string (calendar ? "start_day" : "start_time") + ", " + stn;
+        const std::string where = qry;
+
+        // start times are days in trip_counts and calendar columns, otherwise
+        // seconds in compact trips, and text in other trips
+        StringMap <size_t> stn_index;
+        for (auto tbl: tables)
+        {
+            qry = "SELECT " + cols + " FROM " + tbl + where;
+            sqlite3_stmt * stmt;
+            if (sqlite3_prepare_v2 (dbcon, qry.c_str (), -1, &stmt,
+                        nullptr) != SQLITE_OK)
+                throw std::runtime_error ("Unable to prepare query: " + qry);
+            for (size_t i = 0; i < args.size (); i++)
+                sqlite3_bind_text (stmt, static_cast <int> (i) + 1,
+                        args [i].c_str (), -1, SQLITE_TRANSIENT);
+
+            while (sqlite3_step (stmt) == SQLITE_ROW)
+            {
+                int64_t day;
+                if (sqlite3_column_type (stmt, 0) == SQLITE_NULL)
+                    continue;
+                if (use_cube || calendar)
+                {
+                    day = sqlite3_column_int64 (stmt, 0);
+                    if (use_cube && day == cube_null)
+                        continue;
+                }
+                else if (compact)
+                    day = utils::epoch_day (sqlite3_column_int64 (stmt, 0));
+                else if (!text_day (sqlite3_column_text (stmt, 0),
+                            sqlite3_column_bytes (stmt, 0), day))
+                    continue;
+
+                size_t s = 0;
+                if (per_station)
+                {
+                    if (sqlite3_column_type (stmt, 1) == SQLITE_NULL)
+                        continue;
+                    if (compact)
+                    {
+                        const sqlite3_int64 k = sqlite3_column_int64 (stmt,
+                                1);
+                        if (k < 0)
+                            continue;
+                        s = static_cast <size_t> (k);
+                    } else
+                    {
+                        std::string_view id (reinterpret_cast <const char *> (
+                                    sqlite3_column_text (stmt, 1)),
+                                static_cast <size_t> (
+                                    sqlite3_column_bytes (stmt, 1)));
+                        auto r = stn_index.emplace (id, names.size ());
+                        if (r.second)
+                            names.emplace_back (id);
+                        s = *r.first;
+                    }
+                }
+                counter.add (s, day, use_cube ?
+                        sqlite3_column_double (stmt, 2) : 1.0);
+            }
+            sqlite3_finalize (stmt);
+        }
+    }
+
+    counter.expand (names, per_station, res);
+}
+
+//' station_first_days
+//'
+//' First days are those of the "station_stats" table where that exists.
+//'
+//' @param filters TripFilters, of which only the city is used
+//' @param first_days On return, the first day on which trips started from
+//'        each station of the city
+//'
+//' @noRd
+void daily::station_first_days (sqlite3 * dbcon, const TripFilters &filters,
+        std::vector <int64_t> &first_days)
+{
+    TripFilters city_filter;
+    auto f = filters.find ("city");
+    if (f != filters.end ())
+        city_filter.insert (*f);
+
+    const bool compact = db_utils::is_compact (dbcon);
+    const std::string stn = compact ? "start_station" : "start_station_id";
+    std::string qry;
+    std::vector <std::string> args;
+    const bool use_stats = db_utils::has_table (dbcon, "station_stats");
+    const bool use_cube = !use_stats &&
+        db_utils::has_table (dbcon, "trip_counts") &&
+        tripmat::cube_filter_qry (city_filter, compact, qry, args);
+    const bool calendar = !use_stats && !use_cube &&
+        db_utils::has_calendar (dbcon);
+    if (use_stats)
+    {
+        qry = "SELECT stn_id, first_trip FROM station_stats";
+        if (f != filters.end ())
+        {
+            qry += " WHERE city = ?";
+            args.push_back (f->second [0]);
+        }
+    } else if (use_cube)
+        qry = "SELECT " + stn + ", MIN(NULLIF(date, " +
+            std::to_string (cube_null) + ")) FROM trip_counts" + qry;
+    else
+    {
+        tripmat::filter_qry (city_filter, compact, calendar, qry, args);
+        qry = "SELECT " + stn + ", MIN(" + (calendar ? "start_day" :
+                "start_time") + ") FROM " +
+            (compact ? "trips_compact" : "trips") + qry;
+    }
+    if (!use_stats)
+        qry += " GROUP BY " + stn;
+
+    sqlite3_stmt * stmt;
+    if (sqlite3_prepare_v2 (dbcon, qry.c_str (), -1, &stmt, nullptr) !=
+            SQLITE_OK)
+        throw std::runtime_error ("Unable to prepare query: " + qry);
+    for (size_t i = 0; i < args.size (); i++)
+        sqlite3_bind_text (stmt, static_cast <int> (i) + 1, args [i].c_str (),
+                -1, SQLITE_TRANSIENT);
+
+    first_days.clear ();
+    while (sqlite3_step (stmt) == SQLITE_ROW)
+    {
+        int64_t day;
+        if (sqlite3_column_type (stmt, 0) == SQLITE_NULL ||
+                sqlite3_column_type (stmt, 1) == SQLITE_NULL)
+            continue;
+        // cells of trips without start stations
+        if (use_cube && (compact ?
+                    sqlite3_column_int64 (stmt, 0) == cube_null :
+                    sqlite3_column_bytes (stmt, 0) == 0))
+            continue;
+        if (use_cube || calendar)
+            day = sqlite3_column_int64 (stmt, 1);
+        else if (compact && !use_stats)
+            day = utils::epoch_day (sqlite3_column_int64 (stmt, 1));
+        else if (!text_day (sqlite3_column_text (stmt, 1),
+                    sqlite3_column_bytes (stmt, 1), day))
+            continue;
+        first_days.push_back (day);
+    }
+    sqlite3_finalize (stmt);
+}
+
+//' standardise
+//'
+//' Scale daily counts by the inverse of the numbers of stations which had
+//' started operating by each day, relative to the mean of that inverse over
+//' all days, so counts are increased on days with relatively fewer stations.
+//' Results are rounded to 3 decimal places.
+//'
+//' @param first_days First days of operation of each station
+//'
+//' @noRd
+void daily::standardise (const std::vector <int64_t> &first_days,
+        DailyCounts &res)
+{
+    if (res.ndays == 0)
+        return;
+
+    std::vector <int64_t> days = first_days;
+    std::sort (days.begin (), days.end ());
+    std::vector <double> factor (res.ndays);
+    double total = 0.0;
+    size_t n = 0;
+    for (size_t d = 0; d < res.ndays; d++)
+    {
+        const int64_t day = res.first_day + static_cast <int64_t> (d);
+        while (n < days.size () && days [n] <= day)
+            n++;
+        factor [d] = 1.0 / static_cast <double> (std::max (n,
+                    static_cast <size_t> (1)));
+        total += factor [d];
+    }
+    const double mn = total / static_cast <double> (res.ndays);
+
+    for (size_t i = 0; i < res.counts.size (); i++)
+        res.counts [i] = std::round (res.counts [i] *
+                factor [i % res.ndays] / mn * 1000.0) / 1000.0;
+}
+
+//' rcpp_daily_trips
+//'
+//' Count numbers of trips starting on each day.
+//'
+//' @param bikedb A string containing the path to the Sqlite3 database
+//' @param filters Named list of character vectors of filters, as for
+//'        rcpp_tripmat, and optionally "start_station"
+//' @param per_station If true, count trips for each start station
+//' @param standardise If true, standardise counts by the numbers of stations
+//'        in operation on each day
+//'
+//' @return List of "date" (as days since 1970-01-01) of every day from the
+//'         first to the last day with trips, "station" (for per_station only)
+//'         with dates repeated for each station, and "numtrips", which are
+//'         integer unless standardised.
+//'
+//' @noRd
+// [[Rcpp::export]]
+Rcpp::List rcpp_daily_trips (const char * bikedb, Rcpp::List filters,
+        bool per_station, bool standardise)
+{
+    const TripFilters tf = tripmat::trip_filters (filters);
+
+    sqlite3 *dbcon;
+    int rc = sqlite3_open_v2 (bikedb, &dbcon, SQLITE_OPEN_READONLY, nullptr);
+    if (rc != SQLITE_OK)
+        throw std::runtime_error ("Can't establish sqlite3 connection");
+
+    daily::DailyCounts counts;
+    // All queries see the same snapshot of databases with write-ahead logs,
+    // even while data are being added.
+    try
+    {
+        if (sqlite3_exec (dbcon, "BEGIN", nullptr, nullptr, nullptr) !=
+                SQLITE_OK)
+            throw std::runtime_error ("Unable to begin read transaction");
+        daily::count_daily_trips (dbcon, tf, per_station, counts);
+        if (standardise)
+        {
+            std::vector <int64_t> first_days;
+            daily::station_first_days (dbcon, tf, first_days);
+            daily::standardise (first_days, counts);
+        }
+        if (sqlite3_exec (dbcon, "COMMIT", nullptr, nullptr, nullptr) !=
+                SQLITE_OK)
+            throw std::runtime_error ("Unable to end read transaction");
+    } catch (...)
+    {
+        sqlite3_close_v2 (dbcon);
+        throw;
+    }
+
+    rc = sqlite3_close_v2 (dbcon);
+    if (rc != SQLITE_OK)
+        throw std::runtime_error ("Unable to close sqlite database");
+
+    const size_t n = counts.counts.size ();
+    Rcpp::IntegerVector date (n);
+    for (size_t i = 0; i < n; i++)
+        date [i] = static_cast <int> (counts.first_day +
+                static_cast <int64_t> (i % counts.ndays));
+
+    Rcpp::RObject numtrips;
+    if (standardise)
+        numtrips = Rcpp::NumericVector (counts.counts.begin (),
+                counts.counts.end ());
+    else
+        numtrips = Rcpp::IntegerVector (counts.counts.begin (),
+                counts.counts.end ());
+    if (!per_station)
+        return Rcpp::List::create (Rcpp::Named ("date") = date,
+                Rcpp::Named ("numtrips") = numtrips);
+
+    Rcpp::CharacterVector station (n);
+    for (size_t i = 0; i < n; i++)
+        station [i] = counts.stations [i / counts.ndays];
+    return Rcpp::List::create (Rcpp::Named ("date") = date,
+            Rcpp::Named ("station") = station,
+            Rcpp::Named ("numtrips") = numtrips);
+}
@@ -0,0 +1,50 @@
+#pragma once
+/***************************************************************************
+ *  Project:    bikedata
+ *  File:       sqlite3db-daily.h
+ *  Language:   C++
+ *
+ *  Author:     Mark Padgham
+ *  E-Mail:     mark.padgham@email.com
+ *
+ *  Description:    Counts of trips on each day, in total or for each start
+ *                  station, optionally standardised by the numbers of
+ *                  stations in operation on each day.
+ *
+ *  Compiler Options:   -std=c++17
+ ***************************************************************************/
+
+#include "common.h"
+#include "utils.h"
+#include "vendor/sqlite3/sqlite3.h"
+#include "sqlite3db-utils.h"
+#include "sqlite3db-tripmat.h"
+#include "column-store.h"
+
+#include <string>
+#include <vector>
+
+#include <Rcpp.h>
+
+namespace daily {
+
+// Numbers of trips on each of "ndays" consecutive days from "first_day" (as
+// days since 1970-01-01), for each of "stations" (or in total where that is
+// empty), in station-major order.
+struct DailyCounts {
+    int64_t first_day = 0;
+    size_t ndays = 0;
+    std::vector <std::string> stations;
+    std::vector <double> counts;
+};
+
+void count_daily_trips (sqlite3 * dbcon, const TripFilters &filters,
+        bool per_station, DailyCounts &res);
+void station_first_days (sqlite3 * dbcon, const TripFilters &filters,
+        std::vector <int64_t> &first_days);
+void standardise (const std::vector <int64_t> &first_days, DailyCounts &res);
+
+} // end namespace daily
+
+Rcpp::List rcpp_daily_trips (const char * bikedb, Rcpp::List filters,
+        bool per_station, bool standardise);
@@ -0,0 +1,236 @@
+/***************************************************************************
+ *  Project:    bikedata
+ *  File:       sqlite3db-parts.cpp
+ *  Language:   C++
+ *
+ *  Author:     Mark Padgham
+ *  E-Mail:     mark.padgham@email.com
+ *
+ *  Description:    Partitioned databases, which hold trips in one table for
+ *                  each city and month, listed in the "trip_parts" table,
+ *                  with "trips" a view of all of these.
+ *
+ *  Compiler Options:   -std=c++17
+ ***************************************************************************/
+
+#include "sqlite3db-parts.h"
+
+#include <map>
+
+/***************************************************************************
+ * Partitioned databases have an empty "trips_base" table with the structure
+ * of the trips table of other databases, from which the table of each
+ * partition is created, along with copies of any indexes of trips_base. Each
+ * city has a view "trips_<city>" of all of its partitions, and "trips" is a
+ * view of those of all cities. These views are only recreated when
+ * partitions are added.
+ ***************************************************************************/
+
+namespace {
+
+void exec (sqlite3 * dbcon, const std::string &qry)
+{
+    char *zErrMsg = nullptr;
+    const int rc = sqlite3_exec (dbcon, qry.c_str (), nullptr, nullptr,
+            &zErrMsg);
+    sqlite3_free (zErrMsg);
+    if (rc != SQLITE_OK)
+        throw std::runtime_error ("Unable to execute query: " + qry);
+}
+
+// Replace all occurrences of "trips_base" in the SQL definition of a table or
+// index with the name of a partition table
+std::string for_table (std::string sql, const std::string &table)
+{
+    const std::string base = "trips_base";
+    for (size_t pos = sql.find (base); pos != std::string::npos;
+            pos = sql.find (base, pos + table.size ()))
+        sql.replace (pos, base.size (), table);
+    return sql;
+}
+
+} // end anonymous namespace
+
+//' is_partitioned
+//'
+//' @return True for databases holding trips in one table for each city and
+//' month
+//'
+//' @noRd
+bool parts::is_partitioned (sqlite3 * dbcon)
+{
+    return db_utils::has_table (dbcon, "trip_parts");
+}
+
+//' table_name
+//'
+//' @param part Name of partition, either "YYYY-MM" or "NA"
+//'
+//' @noRd
+std::string parts::table_name (const std::string &city,
+        const std::string &part)
+{
+    std::string table = "trips_" + city + "_" + part;
+    for (auto &c: table)
+        if (c == '-')
+            c = '_';
+    return table;
+}
+
+//' get_parts
+//'
+//' @param city City of partitions, or all cities if empty
+//'
+//' @return All partitions, in order of city and month
+//'
+//' @noRd
+std::vector <parts::TablePart> parts::get_parts (sqlite3 * dbcon,
+        const std::string &city)
+{
+    std::string qry = "SELECT city, part, tbl, nrows, min_start, max_start, "
+        "min_stop, max_stop FROM trip_parts";
+    if (!city.empty ())
+        qry += " WHERE city = ?";
+    qry += " ORDER BY city, part";
+    sqlite3_stmt * stmt;
+    sqlite3_prepare_v2 (dbcon, qry.c_str (), -1, &stmt, nullptr);
+    if (!city.empty ())
+        sqlite3_bind_text (stmt, 1, city.c_str (), -1, SQLITE_TRANSIENT);
+
+    auto get_text = [&stmt] (int col) {
+        const unsigned char * c = sqlite3_column_text (stmt, col);
+        return std::string (c == nullptr ? "" :
+                reinterpret_cast <const char *> (c));
+    };
+    auto get_time = [&stmt] (int col) {
+        if (sqlite3_column_type (stmt, col) == SQLITE_NULL)
+            return colstore::null_time;
+        return static_cast <int64_t> (sqlite3_column_int64 (stmt, col));
+    };
+
+    std::vector <TablePart> res;
+    while (sqlite3_step (stmt) == SQLITE_ROW)
+    {
+        TablePart tp;
+        tp.city = get_text (0);
+        tp.part.name = get_text (1);
+        tp.table = get_text (2);
+        tp.part.nrows = sqlite3_column_int64 (stmt, 3);
+        tp.part.min_start = get_time (4);
+        tp.part.max_start = get_time (5);
+        tp.part.min_stop = get_time (6);
+        tp.part.max_stop = get_time (7);
+        res.push_back (tp);
+    }
+    sqlite3_finalize (stmt);
+
+    return res;
+}
+
+//' create_table
+//'
+//' Create the table of a new partition with the structure of trips_base.
+//'
+//' @param indexes If true, copies of all indexes of trips_base are also
+//'        created; otherwise they may be created later with create_indexes.
+//'
+//' @noRd
+void parts::create_table (sqlite3 * dbcon, const std::string &table,
+        bool indexes)
+{
+    sqlite3_stmt * stmt;
+    sqlite3_prepare_v2 (dbcon, "SELECT sql FROM sqlite_master WHERE "
+            "type = 'table' AND name = 'trips_base'", -1, &stmt, nullptr);
+    std::string sql;
+    if (sqlite3_step (stmt) == SQLITE_ROW)
+        sql = reinterpret_cast <const char *> (sqlite3_column_text (stmt, 0));
+    sqlite3_finalize (stmt);
+    if (sql.empty ())
+        throw std::runtime_error ("Database has no trips_base table");
+
+    exec (dbcon, for_table (sql, table));
+    if (indexes)
+        parts::create_indexes (dbcon, table);
+}
+
+//' create_indexes
+//'
+//' Create copies of all indexes of trips_base for the table of one partition,
+//' named as by rcpp_create_db_indexes, and skipping any which already exist.
+//'
+//' @noRd
+void parts::create_indexes (sqlite3 * dbcon, const std::string &table)
+{
+    db_utils::Indexes existing = db_utils::get_indexes (dbcon, table);
+    for (auto idx: db_utils::get_indexes (dbcon, "trips_base"))
+    {
+        const std::string name = for_table (idx.first, table);
+        bool exists = false;
+        for (auto e: existing)
+            exists = exists || e.first == name;
+        if (!exists)
+            db_utils::create_index (dbcon, for_table (idx.second, table));
+    }
+}
+
+//' update_part
+//'
+//' Insert or update the entry of one partition in the "trip_parts" table
+//'
+//' @noRd
+void parts::update_part (sqlite3 * dbcon, const TablePart &tp)
+{
+    sqlite3_stmt * stmt;
+    sqlite3_prepare_v2 (dbcon, "INSERT INTO trip_parts (city, part, tbl, "
+            "nrows, min_start, max_start, min_stop, max_stop) VALUES "
+            "(?, ?, ?, ?, ?, ?, ?, ?) ON CONFLICT (city, part) DO UPDATE SET "
+            "nrows = excluded.nrows, min_start = excluded.min_start, "
+            "max_start = excluded.max_start, min_stop = excluded.min_stop, "
+            "max_stop = excluded.max_stop", -1, &stmt, nullptr);
+    sqlite3_bind_text (stmt, 1, tp.city.c_str (), -1, SQLITE_STATIC);
+    sqlite3_bind_text (stmt, 2, tp.part.name.c_str (), -1, SQLITE_STATIC);
+    sqlite3_bind_text (stmt, 3, tp.table.c_str (), -1, SQLITE_STATIC);
+    sqlite3_bind_int64 (stmt, 4, tp.part.nrows);
+    const int64_t times [4] = {tp.part.min_start, tp.part.max_start,
+        tp.part.min_stop, tp.part.max_stop};
+    for (int j = 0; j < 4; j++)
+    {
+        if (times [j] == colstore::null_time)
+            sqlite3_bind_null (stmt, j + 5);
+        else
+            sqlite3_bind_int64 (stmt, j + 5, times [j]);
+    }
+    const int rc = sqlite3_step (stmt);
+    sqlite3_finalize (stmt);
+    if (rc != SQLITE_DONE)
+        throw std::runtime_error ("Unable to update trip_parts table");
+}
+
+//' create_views
+//'
+//' (Re-)create the views of the partitions of each city, and the "trips" view
+//' of all of these. Views of each city are needed because SQLite limits the
+//' numbers of terms of compound queries.
+//'
+//' @noRd
+void parts::create_views (sqlite3 * dbcon)
+{
+    std::map <std::string, std::vector <std::string> > city_tables;
+    for (auto tp: parts::get_parts (dbcon, ""))
+        city_tables [tp.city].push_back (tp.table);
+
+    std::string trips_qry = "DROP VIEW IF EXISTS trips; "
+        "CREATE VIEW trips AS SELECT * FROM trips_base";
+    for (auto ct: city_tables)
+    {
+        const std::string view = "trips_" + ct.first;
+        std::string qry = "DROP VIEW IF EXISTS " + view + "; CREATE VIEW " +
+            view + " AS ";
+        for (size_t i = 0; i < ct.second.size (); i++)
+            qry += (i == 0 ? "" : " UNION ALL ") + std::string (
+                    "SELECT * FROM ") + ct.second [i];
+        exec (dbcon, qry);
+        trips_qry += " UNION ALL SELECT * FROM " + view;
+    }
+    exec (dbcon, trips_qry);
+}
@@ -0,0 +1,45 @@
+#pragma once
+/***************************************************************************
+ *  Project:    bikedata
+ *  File:       sqlite3db-parts.h
+ *  Language:   C++
+ *
+ *  Author:     Mark Padgham
+ *  E-Mail:     mark.padgham@email.com
+ *
+ *  Description:    Partitioned databases, which hold trips in one table for
+ *                  each city and month, listed in the "trip_parts" table,
+ *                  with "trips" a view of all of these.
+ *
+ *  Compiler Options:   -std=c++17
+ ***************************************************************************/
+
+#include "common.h"
+#include "utils.h"
+#include "vendor/sqlite3/sqlite3.h"
+#include "sqlite3db-utils.h"
+#include "column-store.h"
+
+#include <string>
+#include <vector>
+
+namespace parts {
+
+// One table of trips of one city which started in one month. Partitions are
+// named, and hold ranges of times, as for those of the columnar store (see
+// column-store.h). Tables are named "trips_<city>_<YYYY>_<MM>", or
+// "trips_<city>_NA" for trips with NULL start times.
+struct TablePart {
+    std::string city, table;
+    colstore::Part part;
+};
+
+bool is_partitioned (sqlite3 * dbcon);
+std::string table_name (const std::string &city, const std::string &part);
+std::vector <TablePart> get_parts (sqlite3 * dbcon, const std::string &city);
+void create_table (sqlite3 * dbcon, const std::string &table, bool indexes);
+void create_indexes (sqlite3 * dbcon, const std::string &table);
+void update_part (sqlite3 * dbcon, const TablePart &tp);
+void create_views (sqlite3 * dbcon);
+
+} // end namespace parts
@@ -1,6 +1,6 @@
 /***************************************************************************
  *  Project:    bikedata
- *  File:       splite3db-admin.cpp
+ *  File:       sqlite3db-setup.cpp
  *  Language:   C++
  *
  *  Author:     Mark Padgham 
@@ -9,7 +9,7 @@
  *  Description:    Routines to construct sqlite3 database and associated
  *  indexes. Routines to store and add data are in 'sqlite3db-add-data.h'
  *
- *  Compiler Options:   -std=c++11
+ *  Compiler Options:   -std=c++17
  ***************************************************************************/
 
 #include "sqlite3db-setup.h"
@@ -18,14 +18,59 @@
 //'
 //' Initial creation of SQLite3 database
 //' 
+//' Both schemas include the "trip_counts" table of numbers of trips by city,
+//' date and hour of starting and stopping (with dates as days since
+//' 1970-01-01), weekday (0 for Sunday), user type, and start and end stations.
+//' This is maintained as trips are added, and used to count trip matrices.
+//' Cells of trips with NULL values hold cube_null (see sqlite3db-utils.h) in
+//' their place, so that they are added to rather than duplicated.
+//'
+//' Trips tables of both schemas also have integer calendar columns (see
+//' sqlite3db-utils.h) filled as trips are inserted, so filters on dates, times
+//' of day, and weekdays compare plain columns which indexes can serve, rather
+//' than the results of date and time functions.
+//'
+//' The tables "trip_stats" and "station_stats" hold numbers of trips, and
+//' first and last start times, of each city and of each start station, also
+//' maintained as trips are added, so totals and date ranges need not be
+//' calculated from all trips.
+//'
+//' Partitioned databases (see sqlite3db-parts.cpp) hold trips in a table for
+//' each city and month, all of which have the structure of the "trips_base"
+//' table, and which are listed along with their ranges of times in the table
+//' "trip_parts". "trips" is then a view of all of these.
+//'
+//' Databases with columnar stores (see column-store.cpp) also have the tables
+//' "column_parts", with numbers of rows and ranges of times of each partition
+//' of the store, and "column_stations", with the station IDs of each integer
+//' key used in the store.
+//'
+//' Databases may also use a write-ahead log in place of the default rollback
+//' journal, which is recorded in the database file so applies to all
+//' connections. Readers then see the database as of the start of each of
+//' their transactions, without waiting for data being added, which are
+//' checkpointed as described in rcpp_import_to_trip_table.
+//'
 //' @param bikedb A string containing the path to the Sqlite3 database to 
 //'        be created.
+//' @param compact If true, trips are stored with integer codes in the
+//'        "trips_compact" table, and "trips" is a view which decodes these to
+//'        the standard structure. Station codes are the "id" values of the
+//'        stations table.
+//' @param columnar If true, trips are also written to a columnar store in
+//'        binary files alongside the database. The directory holding these
+//'        files must be created separately.
+//' @param partitioned If true, trips are stored in a table for each city and
+//'        month of starting. Only used for databases without the compact
+//'        schema.
+//' @param wal If true, the database uses a write-ahead log.
 //'
 //' @return integer result code
 //'
 //' @noRd
 // [[Rcpp::export]]
-int rcpp_create_sqlite3_db (const char * bikedb)
+int rcpp_create_sqlite3_db (const char * bikedb, bool compact, bool columnar,
+        bool partitioned, bool wal)
 {
     sqlite3 *dbcon;
     char *zErrMsg = nullptr;
@@ -43,20 +88,119 @@ int rcpp_create_sqlite3_db (const char * bikedb)
     // straight into the db. All other cities require re-ordering of data to
     // this citibike sequence prior to injection into db.
 
-    std::string createqry = "CREATE TABLE trips ("
-        "id integer primary key,"
-        "city text,"
-        "trip_duration numeric,"
-        "start_time timestamp without time zone,"
-        "stop_time timestamp without time zone,"
-        "start_station_id text,"
-        "end_station_id text,"
-        "bike_id text,"
-        "user_type text,"
-        "birth_year text,"
-        "gender text"
-        ");"
-        "CREATE TABLE stations ("
+    // in the order of calendar::Field (see sqlite3db-utils.h)
+    const std::string calendar_cols = "start_day integer,"
+        "start_hour integer,"
+        "start_secs integer,"
+        "stop_day integer,"
+        "stop_hour integer,"
+        "stop_secs integer,"
+        "weekday integer";
+
+    std::string createqry;
+    if (compact)
+    {
+        // Times are seconds since 1970-01-01, cities are integer keys into the
+        // "cities" table, and stations are keys into the "stations" table.
+        createqry = "CREATE TABLE trips_compact ("
+            "id integer primary key,"
+            "city integer,"
+            "trip_duration numeric,"
+            "start_time integer,"
+            "stop_time integer,"
+            "start_station integer,"
+            "end_station integer,"
+            "bike_id text,"
+            "user_type integer,"
+            "birth_year integer,"
+            "gender integer," + calendar_cols +
+            ");"
+            "CREATE TABLE cities ("
+            "    id integer primary key,"
+            "    city text UNIQUE"
+            ");"
+            "CREATE VIEW trips AS SELECT "
+            "t.id AS id,"
+            "c.city AS city,"
+            "t.trip_duration AS trip_duration,"
+            "datetime(t.start_time, 'unixepoch') AS start_time,"
+            "datetime(t.stop_time, 'unixepoch') AS stop_time,"
+            "s1.stn_id AS start_station_id,"
+            "s2.stn_id AS end_station_id,"
+            "t.bike_id AS bike_id,"
+            "t.user_type AS user_type,"
+            "t.birth_year AS birth_year,"
+            "t.gender AS gender,"
+            "t.start_day AS start_day,"
+            "t.start_hour AS start_hour,"
+            "t.start_secs AS start_secs,"
+            "t.stop_day AS stop_day,"
+            "t.stop_hour AS stop_hour,"
+            "t.stop_secs AS stop_secs,"
+            "t.weekday AS weekday "
+            "FROM trips_compact t "
+            "LEFT JOIN cities c ON c.id = t.city "
+            "LEFT JOIN stations s1 ON s1.id = t.start_station "
+            "LEFT JOIN stations s2 ON s2.id = t.end_station;"
+            "CREATE TABLE trip_counts ("
+            "city integer,"
+            "date integer,"
+            "hour integer,"
+            "stop_date integer,"
+            "stop_hour integer,"
+            "weekday integer,"
+            "user_type integer,"
+            "start_station integer,"
+            "end_station integer,"
+            "numtrips integer,"
+            "UNIQUE (city, date, hour, stop_date, stop_hour, user_type, "
+            "start_station, end_station)"
+            ");";
+    } else
+    {
+        createqry = "CREATE TABLE " + std::string (partitioned ?
+                "trips_base" : "trips") + " ("
+            "id integer primary key,"
+            "city text,"
+            "trip_duration numeric,"
+            "start_time timestamp without time zone,"
+            "stop_time timestamp without time zone,"
+            "start_station_id text,"
+            "end_station_id text,"
+            "bike_id text,"
+            "user_type text,"
+            "birth_year text,"
+            "gender text," + calendar_cols +
+            ");"
+            "CREATE TABLE trip_counts ("
+            "city text,"
+            "date integer,"
+            "hour integer,"
+            "stop_date integer,"
+            "stop_hour integer,"
+            "weekday integer,"
+            "user_type text,"
+            "start_station_id text,"
+            "end_station_id text,"
+            "numtrips integer,"
+            "UNIQUE (city, date, hour, stop_date, stop_hour, user_type, "
+            "start_station_id, end_station_id)"
+            ");";
+        if (partitioned)
+            createqry += "CREATE VIEW trips AS SELECT * FROM trips_base;"
+                "CREATE TABLE trip_parts ("
+                "    city text,"
+                "    part text,"
+                "    tbl text,"
+                "    nrows integer,"
+                "    min_start integer,"
+                "    max_start integer,"
+                "    min_stop integer,"
+                "    max_stop integer,"
+                "    UNIQUE (city, part)"
+                ");";
+    }
+    createqry += "CREATE TABLE stations ("
         "    id integer primary key,"
         "    city text,"
         "    stn_id text,"
@@ -68,8 +212,45 @@ int rcpp_create_sqlite3_db (const char * bikedb)
         "CREATE TABLE datafiles ("
         "    id integer primary key,"
         "    city text,"
-        "    name text"
+        "    name text,"
+        "    nrows integer,"
+        "    size integer,"
+        "    hash text"
+        ");"
+        "CREATE INDEX datafiles_city_name ON datafiles (city, name);"
+        "CREATE TABLE trip_stats ("
+        "    city text PRIMARY KEY,"
+        "    numtrips integer,"
+        "    first_trip text,"
+        "    last_trip text"
+        ");"
+        "CREATE TABLE station_stats ("
+        "    city text,"
+        "    stn_id text,"
+        "    numtrips integer,"
+        "    first_trip text,"
+        "    last_trip text,"
+        "    UNIQUE (city, stn_id)"
         ");";
+    if (columnar)
+        createqry += "CREATE TABLE column_parts ("
+            "    city text,"
+            "    part text,"
+            "    nrows integer,"
+            "    min_start integer,"
+            "    max_start integer,"
+            "    min_stop integer,"
+            "    max_stop integer,"
+            "    UNIQUE (city, part)"
+            ");"
+            "CREATE TABLE column_stations ("
+            "    city text,"
+            "    key integer,"
+            "    stn_id text,"
+            "    UNIQUE (city, key)"
+            ");";
+    if (wal)
+        createqry += "PRAGMA journal_mode = WAL;";
 
     const char *sql = createqry.c_str ();
     rc = sqlite3_exec(dbcon, sql, nullptr, nullptr, &zErrMsg);
@@ -86,30 +267,32 @@ int rcpp_create_sqlite3_db (const char * bikedb)
 //' rcpp_create_db_indexes
 //'
 //' Creates the specified indexes in the database to speed up queries. Note
-//' that for the full dataset this may take some time.
+//' that for the full dataset this may take some time. SQLite keeps existing
+//' indexes up to date as data are added, so these are not rebuilt.
 //' 
 //' @param bikedb A string containing the path to the sqlite3 database to use.
 //' @param tables A vector with the tables for which to create indexes. This
 //'        vector should be the same length as the cols vector.
-//' @param cols A vector with the fields for which to create indexes.
-//' @param reindex If false, indexes are created, otherwise they are simply
-//'        reindexed.
+//' @param cols A vector with the fields for which to create indexes, with the
+//'        fields of multi-column indexes separated by commas.
 //'
-//' @return integer result code
+//' @return Vector of times in seconds taken to create each new index, named
+//'         by index.
 //'
 //' @noRd
 // [[Rcpp::export]]
-int rcpp_create_db_indexes (const char* bikedb, Rcpp::CharacterVector tables,
-        Rcpp::CharacterVector cols, bool reindex) 
+Rcpp::NumericVector rcpp_create_db_indexes (const char* bikedb,
+        Rcpp::CharacterVector tables, Rcpp::CharacterVector cols)
 {
     sqlite3 *dbcon;
-    char *zErrMsg = nullptr;
     int rc;
 
     rc = sqlite3_open_v2(bikedb, &dbcon, SQLITE_OPEN_READWRITE, nullptr);
     if (rc != SQLITE_OK)
         throw std::runtime_error ("Can't establish sqlite3 connection");
 
+    std::vector <std::string> idxnames;
+    std::vector <double> times;
     for (int i = 0; i < cols.length(); ++i) 
     {
         Rcpp::checkUserInterrupt ();
@@ -117,74 +300,36 @@ int rcpp_create_db_indexes (const char* bikedb, Rcpp::CharacterVector tables,
             (std::string)cols[i];
         boost::replace_all(idxname, "(", "_");
         boost::replace_all(idxname, ")", "_");
+        boost::replace_all(idxname, ",", "");
         boost::replace_all(idxname, " ", "_");
 
-        std::string idxqry;
-        if (reindex)
-            idxqry = "REINDEX " + idxname;
-        else
-            idxqry = "CREATE INDEX " + idxname + " ON " +
-                (char *)(tables [i]) + "(" + (char *)(cols [i]) + ")";
+        db_utils::Indexes indexes = db_utils::get_indexes (dbcon,
+                (std::string) tables [i]);
+        bool exists = false;
+        for (auto idx: indexes)
+            exists = exists || idx.first == idxname;
+        if (exists)
+            continue;
 
-        rc = sqlite3_exec(dbcon, idxqry.c_str(), nullptr, nullptr, &zErrMsg);
-        if (rc != SQLITE_OK) 
+        std::string idxqry = "CREATE INDEX " + idxname + " ON " +
+            (char *)(tables [i]) + "(" + (char *)(cols [i]) + ")";
+        try
         {
-            std::string errMsg = "Unable to execute index query: " + 
-                idxqry;
-            throw std::runtime_error (errMsg);
+            times.push_back (db_utils::create_index (dbcon, idxqry));
+        } catch (...)
+        {
+            sqlite3_close_v2 (dbcon);
+            throw;
         }
+        idxnames.push_back (idxname);
     } 
 
     rc = sqlite3_close_v2(dbcon);
     if (rc != SQLITE_OK) 
         throw std::runtime_error ("Unable to close sqlite database");
-    sqlite3_free (zErrMsg);
-  
-    return(rc);
-}
 
-//' rcpp_create_city_index
-//'
-//' Creates city index in the database. This function is *always* run, while the
-//' 'create_db_indexes' function is optionally run.
-//' 
-//' @param bikedb A string containing the path to the sqlite3 database to use.
-//' @param reindex If false, indexes are created, otherwise they are simply
-//'        reindexed.
-//'
-//' @return integer result code
-//'
-//' @noRd
-// [[Rcpp::export]]
-int rcpp_create_city_index (const char* bikedb, bool reindex) 
-{
-    sqlite3 *dbcon;
-    char *zErrMsg = nullptr;
-    int rc;
+    Rcpp::NumericVector res (times.begin (), times.end ());
+    res.attr ("names") = idxnames;
 
-    rc = sqlite3_open_v2(bikedb, &dbcon, SQLITE_OPEN_READWRITE, nullptr);
-    if (rc != SQLITE_OK)
-        throw std::runtime_error ("Can't establish sqlite3 connection");
-
-    std::string idxname = "idx_trips_city";
-    std::string idxqry;
-    if (reindex)
-        idxqry = "REINDEX " + idxname;
-    else
-        idxqry = "CREATE INDEX " + idxname + " ON trips(city)";
-
-    rc = sqlite3_exec(dbcon, idxqry.c_str(), nullptr, nullptr, &zErrMsg);
-
-    if (rc != SQLITE_OK) 
-    {
-        std::string errMsg = "Unable to execute index query: " + idxqry;
-        throw std::runtime_error (errMsg);
-    }
-
-    rc = sqlite3_close_v2(dbcon);
-    if (rc != SQLITE_OK) 
-        throw std::runtime_error ("Unable to close sqlite database");
-    sqlite3_free (zErrMsg);
-  
-    return(rc);
+    return res;
 }
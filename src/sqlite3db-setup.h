@@ -1,7 +1,7 @@
 #pragma once
 /***************************************************************************
  *  Project:    bikedata
- *  File:       splite3db-admin.cpp
+ *  File:       sqlite3db-setup.h
  *  Language:   C++
  *
  *  Author:     Mark Padgham 
@@ -10,7 +10,7 @@
  *  Description:    Routines to construct sqlite3 database and associated
  *  indexes. Routines to store and add data are in 'sqlite3db-add-data.h'
  *
- *  Compiler Options:   -std=c++11
+ *  Compiler Options:   -std=c++17
  ***************************************************************************/
 
 #include <stdio.h>
@@ -22,7 +22,7 @@
 #include "sqlite3db-add-data.h"
 #include "vendor/sqlite3/sqlite3.h"
 
-int rcpp_create_sqlite3_db (const char * bikedb);
-int rcpp_create_db_indexes (const char* bikedb, Rcpp::CharacterVector tables,
-        Rcpp::CharacterVector cols, bool reindex);
-int rcpp_create_city_index (const char* bikedb, bool reindex);
+int rcpp_create_sqlite3_db (const char * bikedb, bool compact, bool columnar,
+        bool partitioned, bool wal);
+Rcpp::NumericVector rcpp_create_db_indexes (const char* bikedb,
+        Rcpp::CharacterVector tables, Rcpp::CharacterVector cols);
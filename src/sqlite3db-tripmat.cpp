@@ -0,0 +1,671 @@
+/***************************************************************************
+ *  Project:    bikedata
+ *  File:       sqlite3db-tripmat.cpp
+ *  Language:   C++
+ *
+ *  Author:     Mark Padgham
+ *  E-Mail:     mark.padgham@email.com
+ *
+ *  Description:    Aggregation of trips from the SQLite3 database into
+ *                  matrices of numbers of trips between all pairs of
+ *                  stations.
+ *
+ *  Compiler Options:   -std=c++17
+ ***************************************************************************/
+
+#include "sqlite3db-tripmat.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <cstdlib>
+#include <unordered_map>
+
+/***************************************************************************
+ * Trips are read from a single scan of the trips table, with all filters
+ * applied within that query (so SQLite will use indexes where they exist),
+ * and counted straight into a dense (nstations x nstations) buffer. Stations
+ * are those of the stations table which have locations, sorted by ID, with
+ * one row and column for each distinct ID. Trips to or from any other
+ * stations are not counted. Dates, times of day, and weekdays are filtered
+ * on the calendar columns of trips tables which have them (see
+ * sqlite3db-utils.h), rather than on date and time functions of each trip.
+ * Partitioned databases (see sqlite3db-parts.cpp) are scanned one partition
+ * at a time, skipping those of other cities, and those with ranges of times
+ * outside filtered dates, times, and weekdays.
+ *
+ * Where filters can be answered exactly from the pre-aggregated "trip_counts"
+ * table (see rcpp_create_sqlite3_db), that is scanned instead, and the counts
+ * of each cell summed. This is the case for filters on city, dates, weekdays,
+ * membership, start stations, and times at whole hours ("HH:00:00" for
+ * start_time, which is compared with the time of stopping, and "HH:59:59"
+ * for end_time, which is compared with the time of starting). Otherwise,
+ * trips of databases with columnar stores (see column-store.cpp) are counted
+ * by scanning the store, which answers all filters except those on birth
+ * years and genders.
+ ***************************************************************************/
+
+namespace {
+
+// Days since 1970-01-01 of dates "YYYY-mm-dd", as in the "date" columns of
+// trip_counts and the calendar columns of trips
+bool date_day (const std::string &date, std::string &res)
+{
+    int64_t t;
+    if (!utils::parse_datetime_fixed (date + " 00:00:00", t))
+        return false;
+    res = std::to_string (utils::epoch_day (t));
+    return true;
+}
+
+// Seconds since midnight of times "HH:MM:SS"
+bool time_secs (const std::string &hms, std::string &res)
+{
+    int64_t t;
+    if (hms.size () != 8 ||
+            !utils::parse_datetime_fixed ("1970-01-01 " + hms, t) ||
+            t >= 86400)
+        return false;
+    res = std::to_string (t);
+    return true;
+}
+
+} // end anonymous namespace
+
+//' trip_filters
+//'
+//' Convert the named list of filters passed from R to TripFilters.
+//'
+//' @noRd
+TripFilters tripmat::trip_filters (Rcpp::List filters)
+{
+    TripFilters tf;
+    if (filters.size () > 0)
+    {
+        Rcpp::CharacterVector nms = filters.names ();
+        for (int i = 0; i < filters.size (); i++)
+        {
+            Rcpp::CharacterVector vals = filters [i];
+            std::vector <std::string> v;
+            for (int j = 0; j < vals.size (); j++)
+                v.push_back (Rcpp::as <std::string> (vals [j]));
+            tf [Rcpp::as <std::string> (nms [i])] = v;
+        }
+    }
+    return tf;
+}
+
+//' filter_qry
+//'
+//' Construct the WHERE clause of a query on the trips table from the filters
+//' of bike_tripmat.
+//'
+//' @param filters TripFilters, with weekdays 0-indexed from Sunday
+//' @param compact True for databases with the compact schema
+//' @param calendar True for databases with calendar columns (see
+//'        sqlite3db-utils.h), which are then compared in place of the results
+//'        of date and time functions of start and stop times
+//' @param qry On return, the WHERE clause, or empty if there are no filters
+//' @param args On return, the values of each parameter of qry
+//'
+//' @noRd
+void tripmat::filter_qry (const TripFilters &filters, bool compact,
+        bool calendar, std::string &qry, std::vector <std::string> &args)
+{
+    // times in compact databases are integer seconds since 1970
+    const std::string dt_arg = compact ?
+        "CAST(STRFTIME('%s', ?) AS INTEGER)" : "?";
+    const std::string dt_mod = compact ? ", 'unixepoch'" : "";
+
+    std::string val;
+
+    std::vector <std::string> where;
+    args.clear ();
+    for (auto f: filters)
+    {
+        const std::string &nm = f.first;
+        const std::vector <std::string> &vals = f.second;
+        if (vals.empty ())
+            continue;
+
+        if (nm == "city")
+        {
+            where.push_back (compact ?
+                    "city = (SELECT id FROM cities WHERE city = ?)" :
+                    "city = ?");
+            args.push_back (vals [0]);
+        } else if (nm == "start_date")
+        {
+            if (calendar && date_day (vals [0], val))
+            {
+                where.push_back ("stop_day >= ?");
+                args.push_back (val);
+            } else
+            {
+                where.push_back ("stop_time >= " + dt_arg);
+                args.push_back (vals [0] + " 00:00:00");
+            }
+        } else if (nm == "end_date")
+        {
+            if (calendar && date_day (vals [0], val))
+            {
+                where.push_back ("start_day <= ?");
+                args.push_back (val);
+            } else
+            {
+                where.push_back ("start_time <= " + dt_arg);
+                args.push_back (vals [0] + " 23:59:59");
+            }
+        } else if (nm == "start_time")
+        {
+            if (calendar && time_secs (vals [0], val))
+            {
+                where.push_back ("stop_secs >= ?");
+                args.push_back (val);
+            } else
+            {
+                where.push_back ("time(stop_time" + dt_mod + ") >= ?");
+                args.push_back (vals [0]);
+            }
+        } else if (nm == "end_time")
+        {
+            if (calendar && time_secs (vals [0], val))
+            {
+                where.push_back ("start_secs <= ?");
+                args.push_back (val);
+            } else
+            {
+                where.push_back ("time(start_time" + dt_mod + ") <= ?");
+                args.push_back (vals [0]);
+            }
+        } else if (nm == "weekday")
+        {
+            std::string qry_wd = (calendar ? std::string ("weekday") :
+                    "strftime('%w', start_time" + dt_mod + ")") + " IN (?";
+            for (size_t i = 1; i < vals.size (); i++)
+                qry_wd += ", ?";
+            where.push_back (qry_wd + ")");
+            args.insert (args.end (), vals.begin (), vals.end ());
+        } else if (nm == "member")
+        {
+            where.push_back ("user_type = ?");
+            args.push_back (vals [0]);
+        } else if (nm == "birth_year")
+        {
+            if (vals.size () == 1)
+            {
+                where.push_back ("birth_year = ?");
+                args.push_back (vals [0]);
+            } else
+            {
+                auto cmp = [] (const std::string &a, const std::string &b) {
+                    return strtod (a.c_str (), nullptr) <
+                        strtod (b.c_str (), nullptr);
+                };
+                where.push_back ("birth_year >= ?");
+                where.push_back ("birth_year <= ?");
+                args.push_back (*std::min_element (vals.begin (), vals.end (),
+                            cmp));
+                args.push_back (*std::max_element (vals.begin (), vals.end (),
+                            cmp));
+            }
+        } else if (nm == "gender")
+        {
+            where.push_back ("gender = ?");
+            args.push_back (vals [0]);
+        } else if (nm == "start_station")
+        {
+            where.push_back (compact ? "start_station IN "
+                    "(SELECT id FROM stations WHERE stn_id = ?)" :
+                    "start_station_id = ?");
+            args.push_back (vals [0]);
+        } else
+            throw std::runtime_error ("Unknown trip filter: " + nm);
+    }
+
+    qry.clear ();
+    for (size_t i = 0; i < where.size (); i++)
+        qry += (i == 0 ? " WHERE " : " AND ") + where [i];
+}
+
+//' cube_filter_qry
+//'
+//' Construct the WHERE clause of a query on the trip_counts table equivalent to
+//' that constructed by filter_qry for the trips table.
+//'
+//' @return False if the filters can not be exactly answered from trip_counts,
+//'         in which case qry and args are not valid.
+//'
+//' @noRd
+bool tripmat::cube_filter_qry (const TripFilters &filters, bool compact,
+        std::string &qry, std::vector <std::string> &args)
+{
+    // hour of times "HH:MM:SS" with the nominated minutes and seconds
+    auto hour = [] (const std::string &hms, const char * ms,
+            std::string &res) {
+        if (hms.size () != 8 || hms.substr (2) != ms ||
+                !isdigit (hms [0]) || !isdigit (hms [1]) ||
+                atoi (hms.substr (0, 2).c_str ()) > 23)
+            return false;
+        res = std::to_string (atoi (hms.substr (0, 2).c_str ()));
+        return true;
+    };
+
+    std::vector <std::string> where;
+    std::string val;
+    args.clear ();
+    for (auto f: filters)
+    {
+        const std::string &nm = f.first;
+        const std::vector <std::string> &vals = f.second;
+        if (vals.empty ())
+            continue;
+
+        if (nm == "city")
+        {
+            where.push_back (compact ?
+                    "city = (SELECT id FROM cities WHERE city = ?)" :
+                    "city = ?");
+            args.push_back (vals [0]);
+        } else if (nm == "start_date" && date_day (vals [0], val))
+        {
+            where.push_back ("stop_date >= ?");
+            args.push_back (val);
+        } else if (nm == "end_date" && date_day (vals [0], val))
+        {
+            // excluding cells of trips with NULL start times, as in trips
+            where.push_back ("date <= ? AND date > " +
+                    std::to_string (cube_null));
+            args.push_back (val);
+        } else if (nm == "start_time" && hour (vals [0], ":00:00", val))
+        {
+            where.push_back ("stop_hour >= ?");
+            args.push_back (val);
+        } else if (nm == "end_time" && hour (vals [0], ":59:59", val))
+        {
+            where.push_back ("hour <= ? AND hour > " +
+                    std::to_string (cube_null));
+            args.push_back (val);
+        } else if (nm == "weekday")
+        {
+            std::string qry_wd = "weekday IN (?";
+            for (size_t i = 1; i < vals.size (); i++)
+                qry_wd += ", ?";
+            where.push_back (qry_wd + ")");
+            args.insert (args.end (), vals.begin (), vals.end ());
+        } else if (nm == "member")
+        {
+            where.push_back ("user_type = ?");
+            args.push_back (vals [0]);
+        } else if (nm == "start_station")
+        {
+            where.push_back (compact ? "start_station IN "
+                    "(SELECT id FROM stations WHERE stn_id = ?)" :
+                    "start_station_id = ?");
+            args.push_back (vals [0]);
+        } else
+            return false;
+    }
+
+    qry.clear ();
+    for (size_t i = 0; i < where.size (); i++)
+        qry += (i == 0 ? " WHERE " : " AND ") + where [i];
+
+    return true;
+}
+
+//' column_filter
+//'
+//' Convert filters to those of a columnar store, equivalent to filter_qry.
+//' Cities are not converted, because stores are scanned for one city only.
+//'
+//' @return False if the filters can not be applied to columnar stores.
+//'
+//' @noRd
+bool tripmat::column_filter (const TripFilters &filters,
+        colstore::RowFilter &rf)
+{
+    // seconds of times "HH:MM:SS"
+    auto secs = [] (const std::string &hms, int &res) {
+        int64_t t;
+        if (hms.size () != 8 ||
+                !utils::parse_datetime_fixed ("1970-01-01 " + hms, t) ||
+                t >= 86400)
+            return false;
+        res = static_cast <int> (t);
+        return true;
+    };
+
+    rf = colstore::RowFilter ();
+    for (auto f: filters)
+    {
+        const std::string &nm = f.first;
+        const std::vector <std::string> &vals = f.second;
+        if (vals.empty () || nm == "city")
+            continue;
+
+        if (nm == "start_date")
+        {
+            if (!utils::parse_datetime_fixed (vals [0] + " 00:00:00",
+                        rf.min_stop))
+                return false;
+            rf.has_min_stop = true;
+        } else if (nm == "end_date")
+        {
+            if (!utils::parse_datetime_fixed (vals [0] + " 23:59:59",
+                        rf.max_start))
+                return false;
+            rf.has_max_start = true;
+        } else if (nm == "start_time")
+        {
+            if (!secs (vals [0], rf.min_stop_secs))
+                return false;
+        } else if (nm == "end_time")
+        {
+            if (!secs (vals [0], rf.max_start_secs))
+                return false;
+        } else if (nm == "weekday")
+        {
+            for (auto v: vals)
+            {
+                if (v.size () != 1 || v [0] < '0' || v [0] > '6')
+                    return false;
+                rf.weekdays |= 1u << (v [0] - '0');
+            }
+        } else if (nm == "member")
+        {
+            const std::string &v = vals [0];
+            auto res = std::from_chars (v.data (), v.data () + v.size (),
+                    rf.user_type);
+            if (res.ec != std::errc () || res.ptr != v.data () + v.size ())
+                return false;
+            rf.has_user_type = true;
+        } else
+            return false;
+    }
+
+    return true;
+}
+
+//' count_column_trips
+//'
+//' Count trips from the columnar store of a database, for the filters of
+//' count_trips.
+//'
+//' @param stn_index Indices into counts of each station ID
+//'
+//' @return False if the database has no columnar store for the filtered city,
+//'         or the filters can not be applied to it, in which case counts are
+//'         unchanged.
+//'
+//' @noRd
+bool tripmat::count_column_trips (sqlite3 * dbcon, const TripFilters &filters,
+        const std::unordered_map <std::string, int> &stn_index,
+        std::vector <double> &counts)
+{
+    auto f = filters.find ("city");
+    colstore::RowFilter rf;
+    if (f == filters.end () || f->second.empty () ||
+            !colstore::has_store (dbcon) ||
+            !tripmat::column_filter (filters, rf))
+        return false;
+
+    const std::string &city = f->second [0];
+    const std::string dir = colstore::dir_name (dbcon);
+    const std::vector <colstore::Part> parts = colstore::get_parts (dbcon,
+            city);
+    if (parts.empty () || !colstore::has_files (dir, city, parts))
+        return false;
+
+    std::vector <std::string> stations = colstore::get_stations (dbcon, city);
+    std::vector <int> key_index (stations.size (), -1);
+    for (size_t i = 0; i < stations.size (); i++)
+    {
+        auto it = stn_index.find (stations [i]);
+        if (it != stn_index.end ())
+            key_index [i] = it->second;
+    }
+    auto index = [&key_index] (int32_t key) {
+        if (key < 0 || static_cast <size_t> (key) >= key_index.size ())
+            return -1;
+        return key_index [static_cast <size_t> (key)];
+    };
+
+    const size_t n = stn_index.size ();
+    for (auto p: parts)
+    {
+        if (rf.skip_part (p))
+            continue;
+        Rcpp::checkUserInterrupt ();
+        colstore::PartReader r (dir, city, p);
+        const int32_t * start_stn = r.start_station ();
+        const int32_t * end_stn = r.end_station ();
+        for (size_t k = 0; k < static_cast <size_t> (p.nrows); k++)
+        {
+            const int i = index (start_stn [k]);
+            const int j = index (end_stn [k]);
+            if (i >= 0 && j >= 0 && rf.matches (r, k))
+                counts [static_cast <size_t> (i) +
+                    static_cast <size_t> (j) * n] += 1.0;
+        }
+    }
+
+    return true;
+}
+
+//' trip_tables
+//'
+//' @return Names of all tables which may hold trips matching the filters:
+//'         the trips table (or "trips_compact"), or, for partitioned
+//'         databases, the tables of all partitions of the filtered city with
+//'         ranges of times which overlap filtered dates, times, and weekdays.
+//'
+//' @noRd
+std::vector <std::string> tripmat::trip_tables (sqlite3 * dbcon,
+        const TripFilters &filters)
+{
+    const bool compact = db_utils::is_compact (dbcon);
+    if (compact || !parts::is_partitioned (dbcon))
+        return {compact ? "trips_compact" : "trips"};
+
+    TripFilters time_filters;
+    for (auto f: filters)
+        if (f.first == "start_date" || f.first == "end_date" ||
+                f.first == "start_time" || f.first == "end_time" ||
+                f.first == "weekday")
+            time_filters.insert (f);
+    colstore::RowFilter rf;
+    const bool prune = tripmat::column_filter (time_filters, rf);
+
+    auto f = filters.find ("city");
+    const std::string city = (f == filters.end () || f->second.empty ()) ?
+        "" : f->second [0];
+    std::vector <std::string> tables;
+    for (auto tp: parts::get_parts (dbcon, city))
+        if (tp.part.nrows > 0 && !(prune && rf.skip_part (tp.part)))
+            tables.push_back (tp.table);
+
+    return tables;
+}
+
+//' count_trips
+//'
+//' @param dbcon Active connection to sqlite3 database
+//' @param filters TripFilters
+//' @param stn_ids On return, sorted IDs of all stations
+//' @param counts On return, numbers of trips between all stations, in
+//'        column-major order with start stations in rows
+//'
+//' @noRd
+void tripmat::count_trips (sqlite3 * dbcon, const TripFilters &filters,
+        std::vector <std::string> &stn_ids, std::vector <double> &counts)
+{
+    const bool compact = db_utils::is_compact (dbcon);
+    auto city = filters.find ("city");
+    const bool has_city = city != filters.end () && !city->second.empty ();
+
+    // Stations of compact databases which have only been read from trips
+    // have no locations, and are excluded.
+    std::vector <std::string> stn_where;
+    if (compact)
+        stn_where.push_back ("longitude IS NOT NULL");
+    if (has_city)
+        stn_where.push_back ("city = ?");
+    std::string qry = "SELECT id, stn_id FROM stations";
+    for (size_t i = 0; i < stn_where.size (); i++)
+        qry += (i == 0 ? " WHERE " : " AND ") + stn_where [i];
+    qry += " ORDER BY stn_id, id";
+
+    sqlite3_stmt * stmt;
+    sqlite3_prepare_v2 (dbcon, qry.c_str (), -1, &stmt, nullptr);
+    if (has_city)
+        sqlite3_bind_text (stmt, 1, city->second [0].c_str (), -1,
+                SQLITE_TRANSIENT);
+
+    // Stations of compact databases are indexed by their integer keys, which
+    // are the "id" values of the stations table.
+    stn_ids.clear ();
+    std::unordered_map <std::string, int> stn_index;
+    std::vector <int> key_index;
+    while (sqlite3_step (stmt) == SQLITE_ROW)
+    {
+        const unsigned char * c = sqlite3_column_text (stmt, 1);
+        if (c == nullptr)
+            continue;
+        std::string stn_id (reinterpret_cast <const char *> (c));
+        if (stn_ids.empty () || stn_ids.back () != stn_id)
+        {
+            stn_index.emplace (stn_id, static_cast <int> (stn_ids.size ()));
+            stn_ids.push_back (stn_id);
+        }
+        const int id = sqlite3_column_int (stmt, 0);
+        if (compact && id >= 0)
+        {
+            if (static_cast <size_t> (id) >= key_index.size ())
+                key_index.resize (static_cast <size_t> (id) + 1, -1);
+            key_index [static_cast <size_t> (id)] =
+                static_cast <int> (stn_ids.size ()) - 1;
+        }
+    }
+    sqlite3_finalize (stmt);
+
+    const size_t n = stn_ids.size ();
+    counts.assign (n * n, 0.0);
+
+    const std::string stns = compact ? "start_station, end_station" :
+        "start_station_id, end_station_id";
+    std::vector <std::string> args;
+    const bool use_cube = db_utils::has_table (dbcon, "trip_counts") &&
+        tripmat::cube_filter_qry (filters, compact, qry, args);
+    if (!use_cube &&
+            tripmat::count_column_trips (dbcon, filters, stn_index, counts))
+        return;
+
+    // trips of partitioned databases are counted from each partition in turn
+    std::vector <std::string> tables;
+    if (use_cube)
+        tables.push_back ("trip_counts");
+    else
+    {
+        tripmat::filter_qry (filters, compact,
+                db_utils::has_calendar (dbcon), qry, args);
+        tables = tripmat::trip_tables (dbcon, filters);
+    }
+    const std::string where = qry;
+
+    std::string key;
+    auto text_index = [&] (int col) {
+        const unsigned char * c = sqlite3_column_text (stmt, col);
+        if (c == nullptr)
+            return -1;
+        key.assign (reinterpret_cast <const char *> (c),
+                static_cast <size_t> (sqlite3_column_bytes (stmt, col)));
+        auto it = stn_index.find (key);
+        return it == stn_index.end () ? -1 : it->second;
+    };
+    auto key_to_index = [&] (int col) {
+        if (sqlite3_column_type (stmt, col) == SQLITE_NULL)
+            return -1;
+        const sqlite3_int64 k = sqlite3_column_int64 (stmt, col);
+        if (k < 0 || static_cast <uint64_t> (k) >= key_index.size ())
+            return -1;
+        return key_index [static_cast <size_t> (k)];
+    };
+
+    for (auto tbl: tables)
+    {
+        qry = "SELECT " + stns + (use_cube ? ", numtrips" : "") + " FROM " +
+            tbl + where;
+        if (sqlite3_prepare_v2 (dbcon, qry.c_str (), -1, &stmt, nullptr) !=
+                SQLITE_OK)
+            throw std::runtime_error ("Unable to prepare query: " + qry);
+        for (size_t i = 0; i < args.size (); i++)
+            sqlite3_bind_text (stmt, static_cast <int> (i) + 1,
+                    args [i].c_str (), -1, SQLITE_TRANSIENT);
+
+        while (sqlite3_step (stmt) == SQLITE_ROW)
+        {
+            const int i = compact ? key_to_index (0) : text_index (0);
+            const int j = compact ? key_to_index (1) : text_index (1);
+            if (i >= 0 && j >= 0)
+                counts [static_cast <size_t> (i) +
+                    static_cast <size_t> (j) * n] +=
+                    use_cube ? sqlite3_column_double (stmt, 2) : 1.0;
+        }
+        sqlite3_finalize (stmt);
+    }
+}
+
+//' rcpp_tripmat
+//'
+//' Count numbers of trips between all pairs of stations.
+//'
+//' @param bikedb A string containing the path to the Sqlite3 database
+//' @param filters Named list of character vectors of filters, as constructed
+//'        in bike_tripmat
+//'
+//' @return Square matrix of numbers of trips, with rows for start stations and
+//'         columns for end stations, both named by station ID.
+//'
+//' @noRd
+// [[Rcpp::export]]
+Rcpp::NumericMatrix rcpp_tripmat (const char * bikedb, Rcpp::List filters)
+{
+    const TripFilters tf = tripmat::trip_filters (filters);
+
+    sqlite3 *dbcon;
+    int rc = sqlite3_open_v2 (bikedb, &dbcon, SQLITE_OPEN_READONLY, nullptr);
+    if (rc != SQLITE_OK)
+        throw std::runtime_error ("Can't establish sqlite3 connection");
+
+    std::vector <std::string> stn_ids;
+    std::vector <double> counts;
+    // All queries see the same snapshot of databases with write-ahead logs,
+    // even while data are being added.
+    try
+    {
+        if (sqlite3_exec (dbcon, "BEGIN", nullptr, nullptr, nullptr) !=
+                SQLITE_OK)
+            throw std::runtime_error ("Unable to begin read transaction");
+        tripmat::count_trips (dbcon, tf, stn_ids, counts);
+        if (sqlite3_exec (dbcon, "COMMIT", nullptr, nullptr, nullptr) !=
+                SQLITE_OK)
+            throw std::runtime_error ("Unable to end read transaction");
+    } catch (...)
+    {
+        sqlite3_close_v2 (dbcon);
+        throw;
+    }
+
+    rc = sqlite3_close_v2 (dbcon);
+    if (rc != SQLITE_OK)
+        throw std::runtime_error ("Unable to close sqlite database");
+
+    const int n = static_cast <int> (stn_ids.size ());
+    Rcpp::NumericMatrix res (n, n);
+    std::copy (counts.begin (), counts.end (), res.begin ());
+    Rcpp::CharacterVector ids (stn_ids.begin (), stn_ids.end ());
+    res.attr ("dimnames") = Rcpp::List::create (ids, ids);
+
+    return res;
+}
@@ -0,0 +1,54 @@
+#pragma once
+/***************************************************************************
+ *  Project:    bikedata
+ *  File:       sqlite3db-tripmat.h
+ *  Language:   C++
+ *
+ *  Author:     Mark Padgham
+ *  E-Mail:     mark.padgham@email.com
+ *
+ *  Description:    Aggregation of trips from the SQLite3 database into
+ *                  matrices of numbers of trips between all pairs of
+ *                  stations.
+ *
+ *  Compiler Options:   -std=c++17
+ ***************************************************************************/
+
+#include "common.h"
+#include "utils.h"
+#include "vendor/sqlite3/sqlite3.h"
+#include "sqlite3db-utils.h"
+#include "column-store.h"
+#include "sqlite3db-parts.h"
+
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <Rcpp.h>
+
+// Filters on trips, named by the filters of bike_tripmat: city, start_date,
+// end_date, start_time, end_time, weekday, member, birth_year, gender; and
+// start_station for bike_daily_trips.
+typedef std::map <std::string, std::vector <std::string> > TripFilters;
+
+namespace tripmat {
+
+TripFilters trip_filters (Rcpp::List filters);
+void filter_qry (const TripFilters &filters, bool compact, bool calendar,
+        std::string &qry, std::vector <std::string> &args);
+bool cube_filter_qry (const TripFilters &filters, bool compact,
+        std::string &qry, std::vector <std::string> &args);
+bool column_filter (const TripFilters &filters, colstore::RowFilter &rf);
+bool count_column_trips (sqlite3 * dbcon, const TripFilters &filters,
+        const std::unordered_map <std::string, int> &stn_index,
+        std::vector <double> &counts);
+std::vector <std::string> trip_tables (sqlite3 * dbcon,
+        const TripFilters &filters);
+void count_trips (sqlite3 * dbcon, const TripFilters &filters,
+        std::vector <std::string> &stn_ids, std::vector <double> &counts);
+
+} // end namespace tripmat
+
+Rcpp::NumericMatrix rcpp_tripmat (const char * bikedb, Rcpp::List filters);
@@ -1,6 +1,6 @@
 /***************************************************************************
  *  Project:    bikedata
- *  File:       splite3db-utils.cpp
+ *  File:       sqlite3db-utils.cpp
  *  Language:   C++
  *
  *  Author:     Mark Padgham 
@@ -8,11 +8,15 @@
  *
  *  Description:    Utility functions for interaction with sqlite3 database.
  *
- *  Compiler Options:   -std=c++11
+ *  Compiler Options:   -std=c++17
  ***************************************************************************/
 
 #include "sqlite3db-utils.h"
 
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+
 //' get_max_trip_id
 //'
 //' @param dbcon Active connection to sqlite3 database
@@ -55,23 +59,268 @@ int db_utils::get_max_stn_id (sqlite3 * dbcon)
     return max_stn_id;
 }
 
-//' get_stn_table_size
+//' has_table
 //'
 //' @param dbcon Active connection to sqlite3 database
+//' @param table Name of table
 //'
-//' @return Number of stations in table
+//' @return True if database has the nominated table
 //'
 //' @noRd
-int db_utils::get_stn_table_size (sqlite3 * dbcon)
+bool db_utils::has_table (sqlite3 * dbcon, const std::string &table)
 {
     sqlite3_stmt * stmt;
-    char qry_id [BUFFER_SIZE] = "\0";
-    snprintf(qry_id, BUFFER_SIZE, "SELECT COUNT(*) FROM stations");
-    int rc = sqlite3_prepare_v2(dbcon, qry_id, BUFFER_SIZE, &stmt, nullptr);
+    const char * qry = "SELECT COUNT(*) FROM sqlite_master WHERE "
+        "type = 'table' AND name = ?";
+    int rc = sqlite3_prepare_v2 (dbcon, qry, -1, &stmt, nullptr);
+    sqlite3_bind_text (stmt, 1, table.c_str (), -1, SQLITE_TRANSIENT);
     rc = sqlite3_step (stmt);
-    int num_stns = sqlite3_column_int (stmt, 0);
+    bool res = (rc == SQLITE_ROW && sqlite3_column_int (stmt, 0) > 0);
     sqlite3_finalize (stmt);
-    (void) rc; // supress unused variable warning;
 
-    return num_stns;
+    return res;
+}
+
+//' is_compact
+//'
+//' @param dbcon Active connection to sqlite3 database
+//'
+//' @return True if database has the compact schema, in which trips are stored
+//' in the "trips_compact" table, and "trips" is a view
+//'
+//' @noRd
+bool db_utils::is_compact (sqlite3 * dbcon)
+{
+    return db_utils::has_table (dbcon, "trips_compact");
+}
+
+//' has_calendar
+//'
+//' @param dbcon Active connection to sqlite3 database
+//'
+//' @return True if the trips table (or "trips_compact" for compact databases)
+//' has the calendar columns listed in sqlite3db-utils.h. Databases created
+//' before these were introduced do not.
+//'
+//' @noRd
+bool db_utils::has_calendar (sqlite3 * dbcon)
+{
+    const std::string table = db_utils::is_compact (dbcon) ?
+        "trips_compact" : "trips";
+    const std::string qry = "SELECT COUNT(*) FROM pragma_table_info ('" +
+        table + "') WHERE name = 'start_day'";
+    sqlite3_stmt * stmt;
+    sqlite3_prepare_v2 (dbcon, qry.c_str (), -1, &stmt, nullptr);
+    bool res = (sqlite3_step (stmt) == SQLITE_ROW &&
+            sqlite3_column_int (stmt, 0) > 0);
+    sqlite3_finalize (stmt);
+
+    return res;
+}
+
+//' is_wal
+//'
+//' @param dbcon Active connection to sqlite3 database
+//'
+//' @return True if database uses a write-ahead log, which is recorded in the
+//' database file itself, so applies to all connections
+//'
+//' @noRd
+bool db_utils::is_wal (sqlite3 * dbcon)
+{
+    sqlite3_stmt * stmt;
+    sqlite3_prepare_v2 (dbcon, "PRAGMA journal_mode", -1, &stmt, nullptr);
+    bool res = false;
+    if (sqlite3_step (stmt) == SQLITE_ROW)
+    {
+        const unsigned char * c = sqlite3_column_text (stmt, 0);
+        res = c != nullptr &&
+            std::string (reinterpret_cast <const char *> (c)) == "wal";
+    }
+    sqlite3_finalize (stmt);
+
+    return res;
+}
+
+//' bind_calendar
+//'
+//' Bind the calendar columns of one trip, in the order of calendar::Field, to
+//' the parameters starting at col.
+//'
+//' @param start,stop Times of starting and stopping in seconds since
+//'        1970-01-01, used only if has_start or has_stop.
+//'
+//' @noRd
+void db_utils::bind_calendar (sqlite3_stmt * stmt, int col, bool has_start,
+        int64_t start, bool has_stop, int64_t stop)
+{
+    auto bind_time = [stmt] (int c, bool has_time, int64_t t) {
+        if (!has_time)
+        {
+            for (int i = 0; i < 3; i++)
+                sqlite3_bind_null (stmt, c + i);
+            return;
+        }
+        const int64_t day = utils::epoch_day (t);
+        const int secs = static_cast <int> (t - day * 86400);
+        sqlite3_bind_int64 (stmt, c, day);
+        sqlite3_bind_int (stmt, c + 1, secs / 3600);
+        sqlite3_bind_int (stmt, c + 2, secs);
+    };
+    bind_time (col + calendar::start_day, has_start, start);
+    bind_time (col + calendar::stop_day, has_stop, stop);
+
+    if (!has_start)
+        sqlite3_bind_null (stmt, col + calendar::weekday);
+    else
+        sqlite3_bind_int (stmt, col + calendar::weekday,
+                utils::weekday (utils::epoch_day (start)));
+}
+
+//' set_pragmas
+//'
+//' @param dbcon Active connection to sqlite3 database
+//' @param pragmas Vector of (name, value) pairs of pragmas to be set
+//'
+//' @return The previous values of the same pragmas, which may be passed back to
+//' this function to restore them.
+//'
+//' @noRd
+db_utils::Pragmas db_utils::set_pragmas (sqlite3 * dbcon,
+        const db_utils::Pragmas &pragmas)
+{
+    Pragmas old_pragmas;
+    for (auto p: pragmas)
+    {
+        sqlite3_stmt * stmt;
+        std::string qry = "PRAGMA " + p.first;
+        sqlite3_prepare_v2 (dbcon, qry.c_str (), -1, &stmt, nullptr);
+        if (sqlite3_step (stmt) == SQLITE_ROW)
+        {
+            const unsigned char * val = sqlite3_column_text (stmt, 0);
+            if (val != nullptr)
+                old_pragmas.emplace_back (p.first,
+                        reinterpret_cast <const char *> (val));
+        }
+        sqlite3_finalize (stmt);
+
+        qry += " = " + p.second + ";";
+        sqlite3_exec (dbcon, qry.c_str (), nullptr, nullptr, nullptr);
+    }
+
+    return old_pragmas;
+}
+
+//' get_indexes
+//'
+//' @param dbcon Active connection to sqlite3 database
+//' @param table Name of table
+//'
+//' @return Names and SQL definitions of all indexes of table, excluding those
+//' which SQLite creates automatically.
+//'
+//' @noRd
+db_utils::Indexes db_utils::get_indexes (sqlite3 * dbcon,
+        const std::string &table)
+{
+    Indexes indexes;
+    sqlite3_stmt * stmt;
+    sqlite3_prepare_v2 (dbcon, "SELECT name, sql FROM sqlite_master WHERE "
+            "type = 'index' AND tbl_name = ? AND sql IS NOT NULL",
+            -1, &stmt, nullptr);
+    sqlite3_bind_text (stmt, 1, table.c_str (), -1, SQLITE_TRANSIENT);
+    while (sqlite3_step (stmt) == SQLITE_ROW)
+        indexes.emplace_back (
+                reinterpret_cast <const char *> (sqlite3_column_text (stmt, 0)),
+                reinterpret_cast <const char *> (sqlite3_column_text (stmt, 1)));
+    sqlite3_finalize (stmt);
+
+    return indexes;
+}
+
+//' create_index
+//'
+//' @param dbcon Active connection to sqlite3 database
+//' @param idxqry "CREATE INDEX" query
+//'
+//' @return Time in seconds taken to create the index
+//'
+//' @noRd
+double db_utils::create_index (sqlite3 * dbcon, const std::string &idxqry)
+{
+    auto t0 = std::chrono::steady_clock::now ();
+
+    char *zErrMsg = nullptr;
+    int rc = sqlite3_exec (dbcon, idxqry.c_str (), nullptr, nullptr, &zErrMsg);
+    sqlite3_free (zErrMsg);
+    if (rc != SQLITE_OK)
+        throw std::runtime_error ("Unable to execute index query: " + idxqry);
+
+    std::chrono::duration <double> dt = std::chrono::steady_clock::now () - t0;
+    return dt.count ();
+}
+
+//' upgrade_datafiles
+//'
+//' Add the columns recording numbers of trips, sizes, and content hashes of
+//' data files to the datafiles table of databases created before these were
+//' introduced, along with the index used to look up files by name.
+//'
+//' @param dbcon Active connection to sqlite3 database
+//'
+//' @noRd
+void db_utils::upgrade_datafiles (sqlite3 * dbcon)
+{
+    std::vector <std::string> cols;
+    sqlite3_stmt * stmt;
+    sqlite3_prepare_v2 (dbcon, "PRAGMA table_info (datafiles)", -1, &stmt,
+            nullptr);
+    while (sqlite3_step (stmt) == SQLITE_ROW)
+        cols.push_back (reinterpret_cast <const char *> (
+                    sqlite3_column_text (stmt, 1)));
+    sqlite3_finalize (stmt);
+
+    const std::vector <std::pair <std::string, std::string> > new_cols = {
+        {"nrows", "integer"}, {"size", "integer"}, {"hash", "text"}};
+    for (auto c: new_cols)
+    {
+        if (std::find (cols.begin (), cols.end (), c.first) != cols.end ())
+            continue;
+        std::string qry = "ALTER TABLE datafiles ADD COLUMN " + c.first +
+            " " + c.second;
+        if (sqlite3_exec (dbcon, qry.c_str (), nullptr, nullptr, nullptr) !=
+                SQLITE_OK)
+            throw std::runtime_error ("Unable to add " + c.first +
+                    " to datafiles table");
+    }
+
+    sqlite3_exec (dbcon, "CREATE INDEX IF NOT EXISTS datafiles_city_name "
+            "ON datafiles (city, name)", nullptr, nullptr, nullptr);
+}
+
+//' bind_number
+//'
+//' Bind a text field as an integer or, failing that, as a floating-point
+//' number, with empty or non-numeric fields bound as NULL. Numbers are thus
+//' bound as SQLite would interpret them as literal values.
+//'
+//' @noRd
+void db_utils::bind_number (sqlite3_stmt * stmt, int col, std::string_view s)
+{
+    int64_t val;
+    const char * end = s.data () + s.size ();
+    auto res = std::from_chars (s.data (), end, val);
+    if (s.size () > 0 && res.ec == std::errc () && res.ptr == end)
+    {
+        sqlite3_bind_int64 (stmt, col, val);
+        return;
+    }
+
+    std::string str (s);
+    char * str_end;
+    double dval = strtod (str.c_str (), &str_end);
+    if (str.size () > 0 && *str_end == '\0')
+        sqlite3_bind_double (stmt, col, dval);
+    else
+        sqlite3_bind_null (stmt, col);
 }
@@ -1,7 +1,7 @@
 #pragma once
 /***************************************************************************
  *  Project:    bikedata
- *  File:       splite3db-utils.h
+ *  File:       sqlite3db-utils.h
  *  Language:   C++
  *
  *  Author:     Mark Padgham 
@@ -9,19 +9,67 @@
  *
  *  Description:    Utility functions for interaction with sqlite3 database.
  *
- *  Compiler Options:   -std=c++11
+ *  Compiler Options:   -std=c++17
  ***************************************************************************/
 
 #include "common.h"
 #include "utils.h"
 #include "vendor/sqlite3/sqlite3.h"
 
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
 #define BUFFER_SIZE 512
+// Approximate size in bytes of the chunks into which large data files are split
+// for multi-threaded reading
+#ifndef CHUNK_SIZE
+#define CHUNK_SIZE (16 * 1024 * 1024)
+#endif
+// Size in bytes of the window searched for the end of the line at each chunk
+// boundary, which is doubled for any longer lines
+#ifndef BOUNDARY_WINDOW
+#define BOUNDARY_WINDOW (64 * 1024)
+#endif
+
+// Integer calendar columns of the trips tables of newer databases, derived
+// from the start and stop times of each trip as it is inserted: days since
+// 1970-01-01, hours, and seconds since midnight of starting and stopping, and
+// weekday of starting (0 for Sunday). These are NULL where times are.
+namespace calendar {
+enum Field {
+    start_day, start_hour, start_secs, stop_day, stop_hour, stop_secs, weekday
+};
+} // end namespace calendar
+const unsigned int num_calendar_fields = 7;
+
+// Value of the key columns of the "trip_counts" table for trips with NULL
+// values, which would otherwise never conflict in the UNIQUE constraint of that
+// table. Integer columns (including all of those of compact databases) hold
+// cube_null, which no valid value is less than, and text columns empty strings.
+const int cube_null = -1;
 
 namespace db_utils {
 
 int get_max_trip_id (sqlite3 * dbcon);
 int get_max_stn_id (sqlite3 * dbcon);
-int get_stn_table_size (sqlite3 * dbcon);
+bool has_table (sqlite3 * dbcon, const std::string &table);
+bool is_compact (sqlite3 * dbcon);
+bool has_calendar (sqlite3 * dbcon);
+bool is_wal (sqlite3 * dbcon);
+void bind_calendar (sqlite3_stmt * stmt, int col, bool has_start,
+        int64_t start, bool has_stop, int64_t stop);
+void bind_number (sqlite3_stmt * stmt, int col, std::string_view s);
+
+typedef std::vector <std::pair <std::string, std::string> > Pragmas;
+Pragmas set_pragmas (sqlite3 * dbcon, const Pragmas &pragmas);
+
+// (name, SQL) of indexes
+typedef std::vector <std::pair <std::string, std::string> > Indexes;
+Indexes get_indexes (sqlite3 * dbcon, const std::string &table);
+double create_index (sqlite3 * dbcon, const std::string &idxqry);
+
+void upgrade_datafiles (sqlite3 * dbcon);
 
 } // end namespace db_utils
@@ -0,0 +1,157 @@
+#pragma once
+/***************************************************************************
+ *  Project:    bikedata
+ *  File:       string-map.h
+ *  Language:   C++
+ *
+ *  Author:     Mark Padgham
+ *  E-Mail:     mark.padgham@email.com
+ *
+ *  Description:    Open-addressing hash map from strings, used for lookups
+ *                  of stations by ID or name made for every trip.
+ *
+ *  Compiler Options:   -std=c++17
+ ***************************************************************************/
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// Hash map from strings to values of type V, with linear probing of a table
+// of slots which hold the full hash of each key, so keys are only compared
+// where hashes match. Keys are interned in a single character arena, so
+// lookups by std::string_view need neither copy nor allocate. Entries are
+// held in order of insertion, and can not be removed. Pointers to values, and
+// views of keys, are only valid until the next insertion.
+template <class V>
+class StringMap
+{
+    public:
+        size_t size () const { return entries.size (); }
+        bool empty () const { return entries.empty (); }
+
+        void clear ()
+        {
+            entries.clear ();
+            slots.clear ();
+            keys.clear ();
+        }
+
+        void reserve (size_t n)
+        {
+            entries.reserve (n);
+            if (2 * n > slots.size ())
+                rehash (2 * n);
+        }
+
+        std::string_view key (size_t i) const
+        {
+            return std::string_view (keys.data () + entries [i].offset,
+                    entries [i].length);
+        }
+        const V &value (size_t i) const { return entries [i].value; }
+        V &value (size_t i) { return entries [i].value; }
+
+        const V * find (std::string_view k) const
+        {
+            const size_t i = lookup (k, hash (k));
+            return (i == npos) ? nullptr : &entries [i].value;
+        }
+        V * find (std::string_view k)
+        {
+            const size_t i = lookup (k, hash (k));
+            return (i == npos) ? nullptr : &entries [i].value;
+        }
+        bool contains (std::string_view k) const
+        {
+            return lookup (k, hash (k)) != npos;
+        }
+
+        // Insert "v" under key "k" unless that key is already present.
+        // Returns the value stored for the key, and whether it was inserted.
+        std::pair <V *, bool> emplace (std::string_view k, V v)
+        {
+            const uint64_t h = hash (k);
+            const size_t i = lookup (k, h);
+            if (i != npos)
+                return {&entries [i].value, false};
+
+            if (2 * (entries.size () + 1) > slots.size ())
+                rehash (2 * (entries.size () + 1));
+            Entry e;
+            e.offset = keys.size ();
+            e.length = k.size ();
+            e.hash = h;
+            e.value = std::move (v);
+            keys.append (k.data (), k.size ());
+            place (h, entries.size ());
+            entries.push_back (std::move (e));
+            return {&entries.back ().value, true};
+        }
+
+        V &operator [] (std::string_view k)
+        {
+            return *emplace (k, V ()).first;
+        }
+
+    private:
+        static constexpr size_t npos = static_cast <size_t> (-1);
+
+        struct Entry {
+            size_t offset, length; // of key in "keys"
+            uint64_t hash;
+            V value;
+        };
+        struct Slot {
+            uint64_t hash;
+            size_t entry; // npos for empty slots
+        };
+
+        std::vector <Entry> entries;
+        std::vector <Slot> slots; // size is always a power of 2
+        std::string keys;
+
+        static uint64_t hash (std::string_view k)
+        {
+            return static_cast <uint64_t> (
+                    std::hash <std::string_view> () (k));
+        }
+
+        size_t lookup (std::string_view k, uint64_t h) const
+        {
+            if (slots.empty ())
+                return npos;
+            const size_t mask = slots.size () - 1;
+            for (size_t s = static_cast <size_t> (h) & mask; ;
+                    s = (s + 1) & mask)
+            {
+                const Slot &slot = slots [s];
+                if (slot.entry == npos)
+                    return npos;
+                if (slot.hash == h && key (slot.entry) == k)
+                    return slot.entry;
+            }
+        }
+
+        void place (uint64_t h, size_t entry)
+        {
+            const size_t mask = slots.size () - 1;
+            size_t s = static_cast <size_t> (h) & mask;
+            while (slots [s].entry != npos)
+                s = (s + 1) & mask;
+            slots [s] = {h, entry};
+        }
+
+        void rehash (size_t n)
+        {
+            size_t len = 16;
+            while (len < n)
+                len *= 2;
+            slots.assign (len, {0, npos});
+            for (size_t i = 0; i < entries.size (); i++)
+                place (entries [i].hash, i);
+        }
+};
@@ -7,30 +7,82 @@
 //' Accessed from StackOverflow (using M Oehm):
 //' http://stackoverflow.com/questions/29847915/implementing-strtok-whose-delimiter-has-more-than-one-character
 //'
+//' Position within the string is held in the caller-supplied 'next' pointer
+//' rather than in static state (like strtok_r), so lines may be tokenised
+//' concurrently in different threads.
+//'
 //' @noRd
-char *utils::strtokm(char *str, const char *delim)
+char *utils::strtokm(char *str, const char *delim, char **next)
 {
-    static char *tok;
-    static char *next;
+    char *tok;
     char *m;
 
     if (delim == nullptr) return nullptr;
 
-    tok = (str) ? str : next;
+    tok = (str) ? str : *next;
     if (tok == nullptr) return nullptr;
 
     m = strstr(tok, delim);
 
     if (m) {
-        next = m + strlen(delim);
+        *next = m + strlen(delim);
         *m = '\0';
     } else {
-        next = nullptr;
+        *next = nullptr;
     }
 
     return tok;
 }
 
+//' strtokv
+//'
+//' Equivalent of strtokm for std::string_view objects, which neither modifies
+//' nor copies the line. "rest" holds the remainder of the line, and is set to a
+//' null view once the final token has been returned.
+//'
+//' @return false if there are no further tokens
+//'
+//' @noRd
+bool utils::strtokv (std::string_view &rest, std::string_view delim,
+        std::string_view &token)
+{
+    if (rest.data () == nullptr)
+        return false;
+
+    size_t m = rest.find (delim);
+    if (m != std::string_view::npos)
+    {
+        token = rest.substr (0, m);
+        rest.remove_prefix (m + delim.size ());
+    } else
+    {
+        token = rest;
+        rest = std::string_view ();
+    }
+
+    return true;
+}
+
+//' replace_all
+//'
+//' Equivalent of boost::replace_all which writes into an existing string, to
+//' re-use its allocated storage.
+//'
+//' @noRd
+void utils::replace_all (std::string_view in, std::string_view from,
+        std::string_view to, std::string &out)
+{
+    out.clear ();
+    size_t ipos;
+    while ((ipos = in.find (from)) != std::string_view::npos)
+    {
+        out.append (in.data (), ipos);
+        out.append (to.data (), to.size ());
+        in.remove_prefix (ipos + from.size ());
+    }
+    out.append (in.data (), in.size ());
+}
+
 //' str_token
 //'
 //' A delimiter function for comma-separated std::string
@@ -70,222 +122,312 @@ bool utils::strfound (const std::string str, const std::string target)
     return found;
 }
 
-//' convert_datetime_dmy
+//' file_seek
 //'
-//' For London, with possible formats of:
-//' d/m/YYYY HH:MM
-//' d/m/YYYY HH:MM:ss
+//' Portable 64-bit equivalents of fseek and ftell, because long is only 32 bits
+//' on Windows and many data files are several GB in size.
 //'
 //' @noRd
-std::string utils::convert_datetime_dmy (std::string str)
+int utils::file_seek (FILE * f, int64_t offset)
 {
-    std::string ret;
-    if (str.find (" ") == std::string::npos)
-    {
-        ret = "NA";
-    } else
-    {
-        size_t ipos = str.find (" ");
-        std::string dmy = str.substr (0, ipos);
-        str = str.substr (ipos + 1, str.length () - ipos - 1);
-
-        dmy = utils::convert_date_dmy (dmy);
-        if (!utils::time_is_standard (str))
-            str = utils::convert_time (str);
+#ifdef _WIN32
+    return _fseeki64 (f, offset, SEEK_SET);
+#else
+    return fseeko (f, static_cast <off_t> (offset), SEEK_SET);
+#endif
+}
 
-        ret = dmy + " " + str;
-    }
-    return ret;
+int64_t utils::file_tell (FILE * f)
+{
+#ifdef _WIN32
+    return static_cast <int64_t> (_ftelli64 (f));
+#else
+    return static_cast <int64_t> (ftello (f));
+#endif
 }
 
-//' convert_datetime
+//' parse_datetime
 //'
-//' Possible formats are:
+//' Parse a date-time string directly to integer seconds since
+//' 1970-01-01 00:00:00 in a single pass. Possible formats are:
 //' YYYY-mm-dd HH:MM:SS
-//' m/d/YYYY HH:MM:SS
-//' m/d/YYYY H:M
-//' YYYY-mm-dd HH:MM
-//' m/d/YYYY HH:MM
-//' m/d/YYYY HH:MM:ss
-//' m/d/YYYY H:MM
-//' YYYY-MM-DD HH:MM:SS.
-//' M/D/YYYY H:MM
-//' YYYY-MM-DD HH:M
+//' YYYY-mm-dd HH:MM:SS.fff (fractional seconds are discarded)
+//' YYYY-mm-dd HH:M
+//' m/d/YYYY H:M (with or without leading zeros and seconds)
+//' d/m/YYYY H:M (London, for which "fmt.day_first" must be true)
+//' Two-digit years are presumed to be 20YY. "fmt" records whether the previous
+//' value was in the standard fixed layout, in which case the next value is
+//' first read from fixed positions. Layouts are thus detected once per file,
+//' yet are re-detected whenever they change.
+//'
+//' @return false if the string is not a valid date-time
 //'
 //' @noRd
-std::string utils::convert_datetime (std::string str)
+bool utils::parse_datetime (std::string_view s, DateTimeFormat &fmt,
+        int64_t &epoch)
 {
-    std::string ret;
-    if (str.find (" ") == std::string::npos)
+    if (fmt.fixed && utils::parse_datetime_fixed (s, epoch))
+        return true;
+
+    const size_t n = s.size ();
+    size_t i = 0;
+    // returns number of digits read
+    auto read_int = [&s, &i, n] (int &v) {
+        const size_t i0 = i;
+        v = 0;
+        while (i < n && s [i] >= '0' && s [i] <= '9')
+            v = 10 * v + (s [i++] - '0');
+        return i - i0;
+    };
+
+    // date has three integer components separated by "-" or "/"
+    int dt [6] = {0, 0, 0, 0, 0, 0};
+    size_t ndigits [3];
+    char sep = '\0';
+    for (size_t k = 0; k < 3; k++)
     {
-        ret = "NA";
-    } else
+        ndigits [k] = read_int (dt [k]);
+        if (ndigits [k] == 0)
+            return false;
+        if (k < 2)
+        {
+            if (i == n || (s [i] != '-' && s [i] != '/'))
+                return false;
+            sep = s [i++];
+        }
+    }
+    if (i == n || s [i++] != ' ')
+        return false;
+
+    // time is H:M, with optional seconds
+    if (read_int (dt [3]) == 0 || i == n || s [i++] != ':' ||
+            read_int (dt [4]) == 0)
+        return false;
+    if (i < n && s [i] == ':')
     {
-        size_t ipos = str.find (" ");
-        std::string ymd = str.substr (0, ipos);
-        str = str.substr (ipos + 1, str.length () - ipos - 1);
-
-        if (!utils::date_is_standard (ymd))
-            ymd = utils::convert_date (ymd);
-        if (!utils::time_is_standard (str))
-            str = utils::convert_time (str);
+        i++;
+        if (read_int (dt [5]) == 0)
+            return false;
+    }
+    if (i < n && s [i] == '.')
+    {
+        i++;
+        while (i < n && s [i] >= '0' && s [i] <= '9')
+            i++;
+    }
+    while (i < n && isspace (static_cast <unsigned char> (s [i])))
+        i++;
+    if (i < n)
+        return false;
 
-        ret = ymd + " " + str;
+    int y, m, d;
+    if (ndigits [0] == 4 || (sep == '-' && ndigits [2] != 4))
+    {
+        y = dt [0];
+        m = dt [1];
+        d = dt [2];
+    } else if (fmt.day_first)
+    {
+        d = dt [0];
+        m = dt [1];
+        y = dt [2];
+    } else
+    {
+        m = dt [0];
+        d = dt [1];
+        y = dt [2];
     }
-    return ret;
+    if (y < 100)
+        y += 2000;
+    if (m < 1 || m > 12 || d < 1 || d > 31 || dt [3] > 24 || dt [4] > 59 ||
+            dt [5] > 60)
+        return false;
+
+    epoch = utils::days_from_civil (y, m, d) * 86400 +
+        dt [3] * 3600 + dt [4] * 60 + dt [5];
+    fmt.fixed = (n == 19 || (n > 19 && s [19] == '.')) &&
+        utils::parse_datetime_fixed (s, epoch);
+
+    return true;
 }
 
-bool utils::date_is_standard (const std::string ymd)
+//' parse_datetime_fixed
+//'
+//' Parse a date-time string in the standard "YYYY-mm-dd HH:MM:SS" layout,
+//' optionally followed by fractional seconds, from fixed positions.
+//'
+//' @noRd
+bool utils::parse_datetime_fixed (std::string_view s, int64_t &epoch)
 {
-    // stardard is yyyy-mm-dd
-    bool check = false;
-    // std::count counts char not string, so '-', not "-"
-    if (ymd.size () == 10 && std::count (ymd.begin(), ymd.end(), '-') == 2)
-        check = true;
-    return check;
+    if (s.size () < 19 || (s.size () > 19 && s [19] != '.') ||
+            s [4] != '-' || s [7] != '-' || s [10] != ' ' ||
+            s [13] != ':' || s [16] != ':')
+        return false;
+
+    int v [6];
+    const size_t pos [6] = {0, 5, 8, 11, 14, 17};
+    for (size_t k = 0; k < 6; k++)
+    {
+        const size_t len = (k == 0) ? 4 : 2;
+        v [k] = 0;
+        for (size_t j = pos [k]; j < pos [k] + len; j++)
+        {
+            if (s [j] < '0' || s [j] > '9')
+                return false;
+            v [k] = 10 * v [k] + (s [j] - '0');
+        }
+    }
+    if (v [1] < 1 || v [1] > 12 || v [2] < 1 || v [2] > 31 || v [3] > 24 ||
+            v [4] > 59 || v [5] > 60)
+        return false;
+
+    epoch = utils::days_from_civil (v [0], v [1], v [2]) * 86400 +
+        v [3] * 3600 + v [4] * 60 + v [5];
+    return true;
 }
 
-bool utils::time_is_standard (const std::string hms)
+//' format_datetime
+//'
+//' Write integer seconds since 1970-01-01 as "YYYY-mm-dd HH:MM:SS"
+//'
+//' @noRd
+void utils::format_datetime (int64_t epoch, std::string &out)
 {
-    // stardard is HH:MM:SS
-    bool check = false;
-    if (hms.size () == 8 && std::count (hms.begin(), hms.end(), ':') == 2)
-        check = true;
-    return check;
+    const int64_t days = utils::epoch_day (epoch),
+          secs = epoch - days * 86400;
+    int y;
+    unsigned int m, d;
+    utils::civil_from_days (days, y, m, d);
+
+    char buf [20];
+    const int v [6] = {y, static_cast <int> (m), static_cast <int> (d),
+        static_cast <int> (secs / 3600), static_cast <int> ((secs / 60) % 60),
+        static_cast <int> (secs % 60)};
+    snprintf (buf, sizeof (buf), "%04d-%02d-%02d %02d:%02d:%02d",
+            v [0], v [1], v [2], v [3], v [4], v [5]);
+    out.assign (buf, 19);
 }
 
-std::string utils::convert_date (std::string ymd)
+// Integer conversions between civil dates and days since 1970-01-01, from
+// http://howardhinnant.github.io/date_algorithms.html
+int64_t utils::days_from_civil (int y, int m, int d)
 {
-    std::string delim = "-";
-    if (ymd.find ("/") != std::string::npos)
-        delim = "/";
-
-    size_t ipos = ymd.find (delim.c_str ());
-    std::string y = ymd.substr (0, ipos);
-    ymd = ymd.substr (ipos + 1, ymd.length () - ipos - 1);
-    ipos = ymd.find (delim.c_str ());
-    std::string m = ymd.substr (0, ipos);
-    std::string d = ymd.substr (ipos + 1, ymd.length () - ipos - 1);
-
-    if (d.size () == 4) // change (y,m,d) = m/d/yyyy -> yyyy/m/d
-    {
-        std::string s = y;
-        y = d;
-        d = m;
-        m = s;
-    }
-    if (y.size () == 2)
-        y = "20" + y;
-    utils::zero_pad (m);
-    utils::zero_pad (d);
+    y -= m <= 2;
+    const int64_t era = (y >= 0 ? y : y - 399) / 400;
+    const int64_t yoe = y - era * 400;
+    const int64_t doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const int64_t doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
 
-    return y + "-" + m + "-" + d;
+void utils::civil_from_days (int64_t z, int &y, unsigned int &m,
+        unsigned int &d)
+{
+    z += 719468;
+    const int64_t era = (z >= 0 ? z : z - 146096) / 146097;
+    const int64_t doe = z - era * 146097;
+    const int64_t yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const int64_t doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const int64_t mp = (5 * doy + 2) / 153;
+    d = static_cast <unsigned int> (doy - (153 * mp + 2) / 5 + 1);
+    m = static_cast <unsigned int> (mp < 10 ? mp + 3 : mp - 9);
+    y = static_cast <int> (yoe + era * 400 + (m <= 2));
 }
 
-std::string utils::convert_date_dmy (std::string dmy)
+// Day since 1970-01-01 of seconds since 1970-01-01, floored for times before
+// then.
+int64_t utils::epoch_day (int64_t t)
 {
-    std::string delim = "-";
-    if (dmy.find ("/") != std::string::npos)
-        delim = "/";
-
-    size_t ipos = dmy.find (delim.c_str ());
-    std::string d = dmy.substr (0, ipos);
-    dmy = dmy.substr (ipos + 1, dmy.length () - ipos - 1);
-    ipos = dmy.find (delim.c_str ());
-    std::string m = dmy.substr (0, ipos);
-    std::string y = dmy.substr (ipos + 1, dmy.length () - ipos - 1);
-
-    if (d.size () == 4) // change d/m/yyyy -> yyyy/d/m
-    {
-        std::string s = y;
-        y = d;
-        d = m;
-        m = s;
-    }
-    if (y.size () == 2)
-        y = "20" + y;
-    utils::zero_pad (m);
-    utils::zero_pad (d);
+    int64_t day = t / 86400;
+    if (t % 86400 < 0)
+        day--;
+    return day;
+}
 
-    return y + "-" + m + "-" + d;
+// Weekday (0 for Sunday) of a day since 1970-01-01, which was a Thursday.
+int utils::weekday (int64_t day)
+{
+    return static_cast <int> (((day % 7) + 11) % 7);
 }
 
-std::string utils::convert_time (std::string hms)
+/***************************************************************************
+ * Content hashes of data files. Each line is hashed 8 bytes at a time, and
+ * the hash of a file is then the polynomial sum_i (h_i * B ^ (n - 1 - i)),
+ * modulo the Mersenne prime P = 2^61 - 1, over the hashes, h_i, of its n
+ * lines. The hash of one range of lines followed by another is then the hash
+ * of the first multiplied by B ^ (number of lines in the second) plus the hash
+ * of the second, so chunks of a file may be hashed separately in any thread,
+ * and combined in order. Hashes only depend on the bytes of the file, and so
+ * are the same on all platforms.
+ ***************************************************************************/
+
+const uint64_t HASH_P = (static_cast <uint64_t> (1) << 61) - 1;
+const uint64_t HASH_B = 0x1f3d5b79a2c4e687 % HASH_P;
+
+static uint64_t hash_mod (uint64_t x)
 {
-    // Some systems have decimal seconds which are discarded here:
-    if (hms.length () > 8 && hms.find (".") != std::string::npos)
-        hms = hms.substr (0, hms.find ("."));
-
-    const std::string delim = ":";
-    size_t ipos = hms.find (delim.c_str ());
-    std::string h = hms.substr (0, ipos), m, s;
-    hms = hms.substr (ipos + 1, hms.length () - ipos - 1);
-    if (hms.find (delim.c_str ()) != std::string::npos) // has seconds
-    {
-        ipos = hms.find (delim.c_str ());
-        m = hms.substr (0, ipos);
-        s = hms.substr (ipos + 1, hms.length () - ipos - 1);
-    } else
-    {
-        m = hms;
-        s = "00";
-    }
-    utils::zero_pad (h);
-    utils::zero_pad (m);
-    utils::zero_pad (s);
-    return h + delim + m + delim + s;
+    x = (x & HASH_P) + (x >> 61);
+    return x >= HASH_P ? x - HASH_P : x;
 }
 
-void utils::zero_pad (std::string &t)
+// (a * b) mod P for a, b < P, without 128-bit integers
+static uint64_t hash_mul (uint64_t a, uint64_t b)
 {
-    if (t.size () == 1)
-        t = "0" + t;
+    const uint64_t m31 = (static_cast <uint64_t> (1) << 31) - 1;
+    const uint64_t m30 = (static_cast <uint64_t> (1) << 30) - 1;
+    const uint64_t au = a >> 31, ad = a & m31;
+    const uint64_t bu = b >> 31, bd = b & m31;
+    const uint64_t mid = ad * bu + au * bd;
+    return hash_mod ((au * bu << 1) + (mid >> 30) + ((mid & m30) << 31) +
+            ad * bd);
 }
 
+static uint64_t hash_pow (uint64_t b, uint64_t e)
+{
+    uint64_t res = 1;
+    while (e > 0)
+    {
+        if (e & 1)
+            res = hash_mul (res, b);
+        b = hash_mul (b, b);
+        e >>= 1;
+    }
+    return res;
+}
 
-//' Difference between two time strings formatted as
-//' YYYY-MM-DD hh:mm:ss
-//' @param t1 start date-time string
-//' @param t2 end date-time string
-//' @noRd
-long int utils::timediff (std::string t1, std::string t2)
+void ContentHash::add_line (std::string_view line)
 {
-    if (t1.length () < 19)
+    const uint64_t prime = 0x100000001b3;
+    uint64_t h = 0xcbf29ce484222325 ^ line.size ();
+    size_t i = 0;
+    for (; i + 8 <= line.size (); i += 8)
     {
-        Rcpp::Rcout << "---[" << t1 << ", " << t2 << "]---" << std::endl;
-        Rcpp::stop ("nope");
+        // little-endian regardless of platform
+        uint64_t w = 0;
+        for (size_t j = 0; j < 8; j++)
+            w |= static_cast <uint64_t> (
+                    static_cast <unsigned char> (line [i + j])) << (8 * j);
+        h = (h ^ w) * prime;
+        h ^= h >> 29;
     }
-    int Y1 = atoi (t1.substr (0, 4).c_str ()),
-        M1 = atoi (t1.substr (5, 2).c_str ()),
-        D1 = atoi (t1.substr (8, 2).c_str ()),
-        h1 = atoi (t1.substr (11, 2).c_str ()),
-        m1 = atoi (t1.substr (14, 2).c_str ()),
-        s1 = atoi (t1.substr (17, 2).c_str ()),
-        Y2 = atoi (t2.substr (0, 4).c_str ()),
-        M2 = atoi (t2.substr (5, 2).c_str ()),
-        D2 = atoi (t2.substr (8, 2).c_str ()),
-        h2 = atoi (t2.substr (11, 2).c_str ()),
-        m2 = atoi (t2.substr (14, 2).c_str ()),
-        s2 = atoi (t2.substr (17, 2).c_str ());
-
-    long int y1 = utils::daynum (Y1, M1, D1), y2 = utils::daynum (Y2, M2, D2);
-    long int d1 = y1 * 3600 * 24 + h1 * 3600 + m1 * 60 + s1,
-        d2 = y2 * 3600 * 24 + h2 * 3600 + m2 * 60 + s2;
-
-    return d2 - d1;
+    for (; i < line.size (); i++)
+        h = (h ^ static_cast <unsigned char> (line [i])) * prime;
+    h ^= h >> 32;
+
+    value = hash_mod (hash_mul (value, HASH_B) + hash_mod (h));
+    nlines++;
+}
+
+void ContentHash::append (const ContentHash &h)
+{
+    value = hash_mod (hash_mul (value, hash_pow (HASH_B, h.nlines)) + h.value);
+    nlines += h.nlines;
 }
 
-// Julian day number calculation from
-// http://www.cs.utsa.edu/~cs1063/projects/Spring2011/Project1/jdn-explanation.html
-long int utils::daynum (int y, int m, int d)
+std::string ContentHash::hex () const
 {
-    double md = static_cast <double> (m);
-    double dd = static_cast <double> (d);
-    double yd = static_cast <double> (y);
-    int a = static_cast <int> (floor ((14.0 - md) / 12.0));
-    y = y + 4800 - a;
-    m = m + 12 * a - 3;
-    double res = dd + floor ((153.0 * md + 2.0) / 5.0) + 365.0 * yd +
-        floor (yd / 4.0) - floor (yd / 100.0) + floor (yd / 400.0) - 32045.0;
-    return static_cast <long int> (res);
+    char buf [17];
+    snprintf (buf, sizeof (buf), "%016llx",
+            static_cast <unsigned long long> (value));
+    return std::string (buf);
 }
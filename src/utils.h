@@ -3,23 +3,31 @@
 // [[Rcpp::depends(BH)]]
 #include <Rcpp.h>
 
+#include "common.h"
+
+#include <string>
+#include <string_view>
+
 namespace utils {
 
-char *strtokm(char *str, const char *delim);
+char *strtokm(char *str, const char *delim, char **next);
+bool strtokv (std::string_view &rest, std::string_view delim,
+        std::string_view &token);
+void replace_all (std::string_view in, std::string_view from,
+        std::string_view to, std::string &out);
 std::string str_token (std::string * line, const char * delim);
 void rm_dos_end (char *str);
 bool strfound (const std::string str, const std::string target);
 
-std::string convert_datetime (std::string str);
-std::string convert_datetime_dmy (std::string str);
-bool date_is_standard (const std::string ymd);
-bool time_is_standard (const std::string hms);
-std::string convert_date (std::string ymd);
-std::string convert_date_dmy (std::string ymd);
-std::string convert_time (std::string hms);
-void zero_pad (std::string &t);
-
-long int timediff (std::string t1, std::string t2);
-long int daynum (int y, int m, int d);
+bool parse_datetime (std::string_view s, DateTimeFormat &fmt, int64_t &epoch);
+bool parse_datetime_fixed (std::string_view s, int64_t &epoch);
+void format_datetime (int64_t epoch, std::string &out);
+int64_t days_from_civil (int y, int m, int d);
+void civil_from_days (int64_t z, int &y, unsigned int &m, unsigned int &d);
+int64_t epoch_day (int64_t t);
+int weekday (int64_t day);
+
+int file_seek (FILE * f, int64_t offset);
+int64_t file_tell (FILE * f);
 
 } // end namespace utils